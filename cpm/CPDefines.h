@@ -17,9 +17,11 @@ typedef NS_ENUM(NSUInteger, CPMErrorCode) {
     CPMErrorUnacceptableStatusCode = 0,
     CPMErrorDatabase               = 1,
     CPMErrorInvalidFormat          = 2,
-    CPMErrorDecompression          = 3
+    CPMErrorDecompression          = 3,
+    CPMErrorUnresolvable           = 4
 };
 
 #define CPMErrorStatusCodeKey @"statusCode"
+#define CPMErrorPackageKey @"package"
 
 #endif
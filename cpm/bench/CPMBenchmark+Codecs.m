@@ -0,0 +1,108 @@
+//
+//  CPMBenchmark+Codecs.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMBenchmark+Private.h"
+#import "CPMIndexStream.h"
+#import "compression.h"
+#import "decompress.h"
+
+@implementation CPMBenchmark (Codecs)
+
+// The index cut at stanza boundaries into about that many pieces
+- (NSArray *)splitPackages:(NSData *)packages intoPieces:(NSUInteger)pieces {
+    NSMutableArray *split = [NSMutableArray array];
+    NSData *separator = [NSData dataWithBytes:"\n\n" length:2];
+    NSUInteger start = 0;
+    for (NSUInteger i = 1; i <= pieces && start < packages.length; i++) {
+        NSUInteger end = packages.length;
+        if (i < pieces) {
+            NSUInteger target = MAX(packages.length * i / pieces, start);
+            NSRange found = [packages rangeOfData:separator options:0 range:NSMakeRange(target, packages.length - target)];
+            end = found.location == NSNotFound ? packages.length : NSMaxRange(found);
+        }
+
+        [split addObject:[packages subdataWithRange:NSMakeRange(start, end - start)]];
+        start = end;
+    }
+
+    return split;
+}
+
+- (BOOL)runCodecsBenchmark {
+    CPMBenchmarkRepository *repository = [self repositoryAtIndex:0];
+    NSData *packages = repository.packagesData;
+    NSInteger iterations = MAX([self.defaults integerForKey:@"iterations"], 1);
+    NSUInteger members = MAX([NSProcessInfo processInfo].activeProcessorCount, 2);
+    NSArray *pieces = [self splitPackages:packages intoPieces:members];
+
+    // one member, as most repositories publish them, and then one per core
+    // the way pigz, pbzip2 and xz -T make them for a parallel decoder
+    NSArray *extensions = @[ @"gz", @"bz2", @"xz", @"lzma", @"lz" ];
+    NSSet *splittable = [NSSet setWithObjects:@"gz", @"bz2", @"xz", nil];
+
+    printf("%.1f MB uncompressed, %lu cores\n", packages.length / 1048576.0, (unsigned long)[NSProcessInfo processInfo].activeProcessorCount);
+    BOOL succeeded = YES;
+    for (NSString *extension in extensions) {
+        for (NSUInteger split = 0; split < ([splittable containsObject:extension] ? 2 : 1); split++) {
+            NSString *label = split ? [NSString stringWithFormat:@"%@ x%lu", extension, (unsigned long)pieces.count] : extension;
+            NSError *error = nil;
+            NSMutableData *compressed = [NSMutableData data];
+            for (NSData *piece in split ? pieces : @[ packages ]) {
+                NSData *member = [repository compressData:piece extension:extension error:&error];
+                if (!member) {
+                    compressed = nil;
+                    break;
+                }
+                [compressed appendData:member];
+            }
+
+            // not every machine has lzip
+            if (!compressed) {
+                printf("%-8s skipped: %s\n", label.UTF8String, (error.localizedFailureReason ?: error.localizedDescription).UTF8String);
+                break;
+            }
+
+            CPMCompression expected = CPMCompressionForExtension(extension.UTF8String);
+            succeeded &= CPMBenchmarkExpect(CPMCompressionSniff(compressed.bytes, compressed.length) == expected, [NSString stringWithFormat:@"%@ is recognized from its first bytes", label]);
+
+            NSTimeInterval best = DBL_MAX;
+            NSData *output = nil;
+            for (NSInteger i = 0; i < iterations; i++) {
+                @autoreleasepool {
+                    NSTimeInterval start = [NSProcessInfo processInfo].systemUptime;
+                    output = decompressData(compressed);
+                    best = MIN(best, [NSProcessInfo processInfo].systemUptime - start);
+                }
+            }
+
+            printf("%-8s %8.2f MB %6.1f%% %8.3fs %8.1f MB/s\n", label.UTF8String, compressed.length / 1048576.0, 100.0 * compressed.length / packages.length,
+                   best, packages.length / 1048576.0 / MAX(best, 1e-6));
+            succeeded &= CPMBenchmarkExpect([output isEqualToData:packages], [NSString stringWithFormat:@"%@ decodes to the index", label]);
+
+            // the way an ingest finds an index that finished downloading before it got to it
+            CPMIndexStream *stream = [[CPMIndexStream alloc] init];
+            NSMutableData *streamed = [NSMutableData data];
+            stream.decompressedBlock = ^(const char *bytes, size_t length) {
+                [streamed appendBytes:bytes length:length];
+            };
+            [stream appendData:compressed];
+            [stream finish];
+            NSTimeInterval start = [NSProcessInfo processInfo].systemUptime;
+            BOOL read = [stream enumerateStanzasUsingBlock:^BOOL(const char *bytes, size_t length) {
+                return YES;
+            } error:&error];
+            NSTimeInterval elapsed = [NSProcessInfo processInfo].systemUptime - start;
+            printf("%-8s %19s %8.3fs %8.1f MB/s, streamed\n", label.UTF8String, "", elapsed, packages.length / 1048576.0 / MAX(elapsed, 1e-6));
+            succeeded &= CPMBenchmarkExpect(read && [streamed isEqualToData:packages], [NSString stringWithFormat:@"%@ streams to the index once finished", label]);
+        }
+    }
+
+    return succeeded;
+}
+
+@end
@@ -0,0 +1,174 @@
+//
+//  CPMBenchmark+Download.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMBenchmark+Private.h"
+#import "CPMBenchmarkServer.h"
+#import "CPMPackageDownloader.h"
+#import <CommonCrypto/CommonDigest.h>
+
+// how many archives are published, and how big each is
+#define CPMBenchmarkDownloadArchives 8
+#define CPMBenchmarkDownloadArchiveSize (512 * 1024)
+
+@implementation CPMBenchmark (Download)
+
+// Downloads every package and waits, running the main run loop
+- (NSDictionary *)downloadPackages:(NSArray *)packages withDownloader:(CPMPackageDownloader *)downloader error:(NSError **)error {
+    __block BOOL finished = NO;
+    __block NSDictionary *result = nil;
+    __block NSError *failure = nil;
+    [downloader downloadPackages:packages progress:nil completion:^(NSDictionary *paths, NSError *error) {
+        result = paths;
+        failure = error;
+        finished = YES;
+    }];
+
+    // completions arrive on the main queue
+    while (!finished) {
+        [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+    }
+
+    if (error)
+        *error = failure;
+    return result;
+}
+
+// Puts the given bytes where the downloader looks for an interrupted download
+// of the package
+- (void)writePartial:(NSData *)data forPackage:(NSDictionary *)package ofDownloader:(CPMPackageDownloader *)downloader {
+    NSString *path = [[downloader.cachePath stringByAppendingPathComponent:@"partial"] stringByAppendingPathComponent:[NSString stringWithFormat:@"sha256-%@.deb", package[@"sha256"]]];
+    [data writeToFile:path atomically:NO];
+}
+
+- (NSUInteger)countRequests:(NSArray *)requests withStatus:(int)status {
+    NSString *prefix = [NSString stringWithFormat:@"%d ", status];
+    return [requests indexesOfObjectsPassingTest:^BOOL(NSString *request, NSUInteger idx, BOOL *stop) {
+        return [request hasPrefix:prefix];
+    }].count;
+}
+
+- (BOOL)runDownloadTest {
+    NSString *path = [[self.workPath stringByAppendingPathComponent:@"downloads"] stringByAppendingPathComponent:@"debs"];
+    NSError *error = nil;
+    if (![[NSFileManager defaultManager] createDirectoryAtPath:path withIntermediateDirectories:YES attributes:nil error:&error]) {
+        fprintf(stderr, "cpm bench: %s\n", (error.localizedFailureReason ?: error.localizedDescription).UTF8String);
+        return NO;
+    }
+
+    // archives of pseudo-random bytes, so a wrong offset can't go unnoticed
+    uint64_t state = [self.defaults integerForKey:@"seed"] * 0x9E3779B97F4A7C15ULL ?: 1;
+    NSMutableArray *packages = [NSMutableArray array];
+    NSMutableArray *archives = [NSMutableArray array];
+    for (NSUInteger i = 0; i < CPMBenchmarkDownloadArchives; i++) {
+        NSMutableData *archive = [NSMutableData dataWithLength:CPMBenchmarkDownloadArchiveSize];
+        uint64_t *words = archive.mutableBytes;
+        for (NSUInteger w = 0; w < archive.length / sizeof(uint64_t); w++) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            words[w] = state;
+        }
+
+        unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+        CC_SHA256(archive.bytes, (CC_LONG)archive.length, digest);
+        NSMutableString *sha256 = [NSMutableString string];
+        for (NSUInteger b = 0; b < sizeof(digest); b++) {
+            [sha256 appendFormat:@"%02x", digest[b]];
+        }
+
+        NSString *file = [NSString stringWithFormat:@"com.bench.archive%lu_1.0_all.deb", (unsigned long)i];
+        if (![archive writeToFile:[path stringByAppendingPathComponent:file] options:0 error:&error]) {
+            fprintf(stderr, "cpm bench: %s\n", (error.localizedFailureReason ?: error.localizedDescription).UTF8String);
+            return NO;
+        }
+
+        [archives addObject:archive];
+        [packages addObject:@{ @"package": [NSString stringWithFormat:@"com.bench.archive%lu", (unsigned long)i],
+                               @"filename": [@"debs" stringByAppendingPathComponent:file],
+                               @"size": @(archive.length),
+                               @"sha256": sha256 }];
+    }
+
+    if (![self startServers:&error]) {
+        fprintf(stderr, "cpm bench: %s\n", (error.localizedFailureReason ?: error.localizedDescription).UTF8String);
+        return NO;
+    }
+
+    CPMBenchmarkServer *server = self.servers.firstObject;
+    for (NSUInteger i = 0; i < packages.count; i++) {
+        NSMutableDictionary *package = [packages[i] mutableCopy];
+        package[@"repo"] = server.baseURL;
+        packages[i] = package;
+    }
+
+    BOOL succeeded = YES;
+    @autoreleasepool {
+        NSUInteger count = packages.count;
+        CPMPackageDownloader *downloader = [[CPMPackageDownloader alloc] initWithCachePath:[self.workPath stringByAppendingPathComponent:@"archives"]];
+
+        // every connection drops halfway, and the retry picks up from there
+        server.interruptsAfterBytes = CPMBenchmarkDownloadArchiveSize / 2;
+        NSTimeInterval start = [NSProcessInfo processInfo].systemUptime;
+        NSDictionary *paths = [self downloadPackages:packages withDownloader:downloader error:&error];
+        NSArray *requests = server.requests;
+        printf("downloaded %lu archives of %u KB over dropped connections in %.3fs\n", (unsigned long)count, CPMBenchmarkDownloadArchiveSize / 1024, [NSProcessInfo processInfo].systemUptime - start);
+
+        succeeded &= CPMBenchmarkExpect(paths.count == count, [NSString stringWithFormat:@"downloads cut off halfway complete (%@)", error.localizedFailureReason ?: error.localizedDescription]);
+        succeeded &= CPMBenchmarkExpect([self countRequests:requests withStatus:200] == count && [self countRequests:requests withStatus:206] == count,
+                                        [NSString stringWithFormat:@"each with one Range request for the rest (%@)", [requests componentsJoinedByString:@", "]]);
+        __block BOOL intact = paths.count == count;
+        [packages enumerateObjectsUsingBlock:^(NSDictionary *package, NSUInteger idx, BOOL *stop) {
+            intact &= [[NSData dataWithContentsOfFile:paths[package[@"package"]]] isEqualToData:archives[idx]];
+        }];
+        succeeded &= CPMBenchmarkExpect(intact, @"and the cached archives are the published ones");
+        server.interruptsAfterBytes = 0;
+
+        [server resetRequests];
+        paths = [self downloadPackages:packages withDownloader:downloader error:&error];
+        succeeded &= CPMBenchmarkExpect(paths.count == count && server.requests.count == 0, @"cached archives are not downloaded again");
+
+        // what a run that was killed mid-download leaves behind
+        downloader = [[CPMPackageDownloader alloc] initWithCachePath:[self.workPath stringByAppendingPathComponent:@"archives-resumed"]];
+        [packages enumerateObjectsUsingBlock:^(NSDictionary *package, NSUInteger idx, BOOL *stop) {
+            [self writePartial:[archives[idx] subdataWithRange:NSMakeRange(0, CPMBenchmarkDownloadArchiveSize / 3)] forPackage:package ofDownloader:downloader];
+        }];
+
+        [server resetRequests];
+        paths = [self downloadPackages:packages withDownloader:downloader error:&error];
+        requests = server.requests;
+        succeeded &= CPMBenchmarkExpect(paths.count == count && [self countRequests:requests withStatus:206] == count && requests.count == count,
+                                        [NSString stringWithFormat:@"the next run resumes partial downloads with one Range request each (%@)", [requests componentsJoinedByString:@", "]]);
+
+        // a partial file longer than the archive can't be resumed from
+        downloader = [[CPMPackageDownloader alloc] initWithCachePath:[self.workPath stringByAppendingPathComponent:@"archives-overlong"]];
+        NSDictionary *package = packages.firstObject;
+        NSMutableData *overlong = [archives.firstObject mutableCopy];
+        [overlong appendData:[@"trailing garbage" dataUsingEncoding:NSUTF8StringEncoding]];
+        [self writePartial:overlong forPackage:package ofDownloader:downloader];
+
+        [server resetRequests];
+        paths = [self downloadPackages:@[ package ] withDownloader:downloader error:&error];
+        requests = server.requests;
+        succeeded &= CPMBenchmarkExpect(paths.count == 1 && [requests isEqualToArray:@[ [@"416 /" stringByAppendingString:package[@"filename"]], [@"200 /" stringByAppendingString:package[@"filename"]] ]],
+                                        [NSString stringWithFormat:@"an unsatisfiable Range starts over (%@)", [requests componentsJoinedByString:@", "]]);
+
+        // nor can one that isn't the start of it
+        downloader = [[CPMPackageDownloader alloc] initWithCachePath:[self.workPath stringByAppendingPathComponent:@"archives-corrupt"]];
+        [self writePartial:[archives.lastObject subdataWithRange:NSMakeRange(0, CPMBenchmarkDownloadArchiveSize / 3)] forPackage:package ofDownloader:downloader];
+
+        paths = [self downloadPackages:@[ package ] withDownloader:downloader error:&error];
+        succeeded &= CPMBenchmarkExpect(!paths && [error.userInfo[CPMErrorPackageKey] isEqualToString:package[@"package"]], @"a resumed download that doesn't match its checksum fails");
+        succeeded &= CPMBenchmarkExpect(![downloader cachedPathForPackage:package] &&
+                                        ![[NSFileManager defaultManager] fileExistsAtPath:[[downloader.cachePath stringByAppendingPathComponent:@"partial"] stringByAppendingPathComponent:[NSString stringWithFormat:@"sha256-%@.deb", package[@"sha256"]]]],
+                                        @"and leaves nothing behind to resume from");
+    }
+
+    return succeeded;
+}
+
+@end
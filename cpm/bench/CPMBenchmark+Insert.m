@@ -0,0 +1,121 @@
+//
+//  CPMBenchmark+Insert.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMBenchmark+Private.h"
+#import "CPMPackagesWriter.h"
+#import "dictionarize.h"
+#import <FMDatabaseAdditions.h>
+#import <FMDatabaseQueue.h>
+
+typedef NS_ENUM(NSUInteger, CPMBenchmarkInsert) {
+    // a new statement per row, built from a dictionary, as ingests used to do
+    CPMBenchmarkInsertPerRow,
+    // CPMPackagesWriter into an empty table
+    CPMBenchmarkInsertWriter,
+    // CPMPackagesWriter again, with every row already there
+    CPMBenchmarkInsertWriterUnchanged
+};
+
+@implementation CPMBenchmark (Insert)
+
+// Loads every stanza into the packages table the given way. Returns the time
+// it took, or a negative one on a database error.
+- (NSTimeInterval)loadPackages:(NSData *)packages intoDatabase:(FMDatabase *)db way:(CPMBenchmarkInsert)way {
+    if (way != CPMBenchmarkInsertWriterUnchanged)
+        [db executeUpdate:@"delete from packages"];
+
+    NSTimeInterval start = [NSProcessInfo processInfo].systemUptime;
+    __block BOOL succeeded = YES;
+
+    if (way == CPMBenchmarkInsertPerRow) {
+        [db beginTransaction];
+        CPMBenchmarkEnumerateStanzas(packages, ^(const char *bytes, size_t length) {
+            @autoreleasepool {
+                NSString *stanza = [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding];
+                NSDictionary *dict = dictionarize(stanza, db, @"packages");
+                NSString *query = [NSString stringWithFormat:@"insert or replace into packages (%@) values (:%@)",
+                                   [dict.allKeys componentsJoinedByString:@", "], [dict.allKeys componentsJoinedByString:@", :"]];
+                succeeded &= [db executeUpdate:query withParameterDictionary:dict];
+            }
+        });
+        succeeded &= [db commit];
+    } else {
+        CPMPackagesWriter *writer = [[CPMPackagesWriter alloc] initWithDatabase:db];
+        succeeded = [writer begin];
+        CPMBenchmarkEnumerateStanzas(packages, ^(const char *bytes, size_t length) {
+            CPMStanza stanza;
+            CPMStanzaParse(bytes, length, &stanza);
+            if (succeeded)
+                succeeded = [writer writeStanza:&stanza component:"" architecture:""];
+        });
+
+        if (succeeded && [writer removeRowsNotWrittenInComponent:"" architecture:""] && [writer commit]) {
+            if (way == CPMBenchmarkInsertWriterUnchanged && writer.rowsWritten) {
+                fprintf(stderr, "cpm bench: %lu unchanged rows were written again\n", (unsigned long)writer.rowsWritten);
+                succeeded = NO;
+            }
+        } else {
+            fprintf(stderr, "cpm bench: %s\n", (writer.error.localizedFailureReason ?: writer.error.localizedDescription).UTF8String);
+            [writer rollback];
+            succeeded = NO;
+        }
+    }
+
+    NSTimeInterval elapsed = [NSProcessInfo processInfo].systemUptime - start;
+    return succeeded ? elapsed : -1;
+}
+
+- (BOOL)runInsertBenchmark {
+    NSData *packages = [self repositoryAtIndex:0].packagesData;
+    NSInteger iterations = MAX([self.defaults integerForKey:@"iterations"], 1);
+    NSUInteger expected = [self.defaults integerForKey:@"packages"];
+    NSArray *labels = @[ @"per-row SQL", @"writer", @"writer, same" ];
+
+    __block BOOL succeeded = YES;
+    @autoreleasepool {
+        // the real schema, search index triggers and all
+        CPMRepository *repository = [self scratchRepositoryNamed:@"insert"];
+        if (!repository) {
+            fprintf(stderr, "cpm bench: could not create a database under %s\n", LOCALSTORAGE_PATH.UTF8String);
+            return NO;
+        }
+
+        __block NSTimeInterval baseline = 0;
+        [repository.databaseQueue inDatabase:^(FMDatabase *db) {
+            for (CPMBenchmarkInsert way = CPMBenchmarkInsertPerRow; way <= CPMBenchmarkInsertWriterUnchanged && succeeded; way++) {
+                NSTimeInterval best = DBL_MAX;
+                for (NSInteger i = 0; i < iterations && succeeded; i++) {
+                    // unchanged rows need a full table to start from
+                    if (way == CPMBenchmarkInsertWriterUnchanged && i == 0)
+                        [self loadPackages:packages intoDatabase:db way:CPMBenchmarkInsertWriter];
+
+                    NSTimeInterval elapsed = [self loadPackages:packages intoDatabase:db way:way];
+                    succeeded = elapsed >= 0;
+                    best = MIN(best, elapsed);
+                }
+
+                NSUInteger rows = (NSUInteger)[db intForQuery:@"select count(*) from packages"];
+                if (succeeded && rows != expected) {
+                    fprintf(stderr, "cpm bench: %s left %lu rows instead of %lu\n", [labels[way] UTF8String], (unsigned long)rows, (unsigned long)expected);
+                    succeeded = NO;
+                }
+                if (!succeeded)
+                    break;
+
+                if (!baseline)
+                    baseline = best;
+                printf("%-14s %8.3fs %10.0f rows/s %6.1fx\n", [labels[way] UTF8String], best, expected / MAX(best, 1e-6), baseline / MAX(best, 1e-6));
+            }
+        }];
+    }
+
+    [self removeScratchRepositoryNamed:@"insert"];
+    return succeeded;
+}
+
+@end
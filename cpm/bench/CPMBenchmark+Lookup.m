@@ -0,0 +1,122 @@
+//
+//  CPMBenchmark+Lookup.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMBenchmark+Private.h"
+#import "CPMPackageIndex.h"
+
+@implementation CPMBenchmark (Lookup)
+
+// Runs the block for every identifier and prints the rate. Returns how many
+// were found.
+- (NSUInteger)measureLookups:(NSString *)label identifiers:(NSArray *)identifiers baseline:(double *)baseline usingBlock:(BOOL (^)(NSString *identifier))block {
+    NSUInteger found = 0;
+    NSTimeInterval start = [NSProcessInfo processInfo].systemUptime;
+    @autoreleasepool {
+        for (NSString *identifier in identifiers) {
+            if (block(identifier))
+                found++;
+        }
+    }
+
+    double rate = identifiers.count / MAX([NSProcessInfo processInfo].systemUptime - start, 1e-6);
+    if (!*baseline)
+        *baseline = rate;
+
+    printf("%-16s %12.0f lookups/s %8.1fx\n", label.UTF8String, rate, rate / *baseline);
+    return found;
+}
+
+- (BOOL)runLookupBenchmark {
+    NSError *error = nil;
+    if (![self generateRepositories:&error] || ![self startServers:&error]) {
+        fprintf(stderr, "cpm bench: %s\n", (error.localizedFailureReason ?: error.localizedDescription).UTF8String);
+        return NO;
+    }
+
+    [self removeLocalStorage];
+    BOOL succeeded = YES;
+
+    @autoreleasepool {
+        CPMDpkgRepositoryAggregate *aggregate = [[CPMDpkgRepositoryAggregate alloc] initWithRepositoryURLs:[self.servers valueForKey:@"baseURL"]];
+        if ([self reloadAggregate:aggregate]) {
+            [self removeLocalStorage];
+            return NO;
+        }
+
+        NSTimeInterval start = [NSProcessInfo processInfo].systemUptime;
+        [aggregate.packageIndex reloadStaleRepositories];
+        printf("indexed %lu packages in %.3fs\n", (unsigned long)aggregate.packageIndex.count, [NSProcessInfo processInfo].systemUptime - start);
+
+        // about one in ten isn't in any repository
+        NSUInteger packages = MAX([self.defaults integerForKey:@"packages"], 1);
+        NSUInteger count = MAX([self.defaults integerForKey:@"lookups"], 1);
+        uint64_t state = [self.defaults integerForKey:@"seed"] * 0x9E3779B97F4A7C15ULL ?: 1;
+        NSMutableArray *identifiers = [NSMutableArray arrayWithCapacity:count];
+        for (NSUInteger i = 0; i < count; i++) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            [identifiers addObject:[NSString stringWithFormat:@"com.bench.package%05lu", (unsigned long)(state % (packages + packages / 10 + 1))]];
+        }
+
+        // a query per repository is slow enough that a sample of the lookups tells
+        NSArray *repositories = aggregate.repositories.allObjects;
+        NSArray *sample = [identifiers subarrayWithRange:NSMakeRange(0, MIN(count, 5000))];
+
+        double baseline = 0;
+        NSUInteger queried = [self measureLookups:@"query per repo" identifiers:sample baseline:&baseline usingBlock:^BOOL(NSString *identifier) {
+            __block NSDictionary *package = nil;
+            for (CPMRepository *repository in repositories) {
+                [repository.readerPool inDatabase:^(FMDatabase *db) {
+                    FMResultSet *results = [db executeQuery:@"select * from packages where package = ? limit 2", identifier];
+                    if ([results next]) {
+                        NSMutableDictionary *row = [NSMutableDictionary dictionary];
+                        for (NSString *column in results.columnNameToIndexMap) {
+                            id value = [results objectForColumnName:column];
+                            if (value && ![value isKindOfClass:[NSNull class]])
+                                row[column] = value;
+                        }
+                        package = row;
+                    }
+                    [results close];
+                }];
+
+                if (package)
+                    break;
+            }
+
+            return package != nil;
+        }];
+
+        NSUInteger indexed = [self measureLookups:@"index, sample" identifiers:sample baseline:&baseline usingBlock:^BOOL(NSString *identifier) {
+            return [aggregate.packageIndex enumerateCandidatesForIdentifier:identifier.UTF8String usingBlock:^(const CPMPackageCandidate *candidate, BOOL *stop) {
+                *stop = YES;
+            }] > 0;
+        }];
+
+        [self measureLookups:@"index" identifiers:identifiers baseline:&baseline usingBlock:^BOOL(NSString *identifier) {
+            return [aggregate.packageIndex enumerateCandidatesForIdentifier:identifier.UTF8String usingBlock:^(const CPMPackageCandidate *candidate, BOOL *stop) {
+                *stop = YES;
+            }] > 0;
+        }];
+        [self measureLookups:@"index, boxed" identifiers:identifiers baseline:&baseline usingBlock:^BOOL(NSString *identifier) {
+            return [aggregate.packageIndex candidatesForIdentifier:identifier].count > 0;
+        }];
+        [self measureLookups:@"aggregate" identifiers:identifiers baseline:&baseline usingBlock:^BOOL(NSString *identifier) {
+            return [aggregate packageWithIdentifier:identifier] != nil;
+        }];
+
+        succeeded = CPMBenchmarkExpect(queried == indexed, [NSString stringWithFormat:@"the index finds the same %lu of %lu sampled packages as the queries",
+                                                             (unsigned long)queried, (unsigned long)sample.count]);
+    }
+
+    [self removeLocalStorage];
+    return succeeded;
+}
+
+@end
@@ -0,0 +1,74 @@
+//
+//  CPMBenchmark+PDiff.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMBenchmark+Private.h"
+#import "CPMBenchmarkServer.h"
+
+@implementation CPMBenchmark (PDiff)
+
+- (BOOL)runPDiffTest {
+    NSString *path = [self.workPath stringByAppendingPathComponent:@"pdiff"];
+    NSUInteger packages = [self.defaults integerForKey:@"packages"];
+    NSUInteger changed = MIN(MAX([self.defaults integerForKey:@"changed"], 1), packages);
+
+    // gz needs nothing but gzip, which diffs need anyway
+    CPMBenchmarkRepository *published = [self repositoryAtIndex:0];
+    published.compressions = @[ @"gz" ];
+    published.publishesDiffs = YES;
+
+    NSError *error = nil;
+    if (![published writeToPath:path error:&error] || ![self startServers:&error]) {
+        fprintf(stderr, "cpm bench: %s\n", (error.localizedFailureReason ?: error.localizedDescription).UTF8String);
+        return NO;
+    }
+
+    CPMBenchmarkServer *server = self.servers.firstObject;
+    BOOL succeeded = YES;
+    [self removeLocalStorage];
+
+    @autoreleasepool {
+        CPMRepository *repository = [CPMRepository repositoryWithURL:server.baseURL];
+
+        CPMPackageChanges *changes = [self reloadRepository:repository error:&error];
+        succeeded &= CPMBenchmarkExpect(changes && changes.added.count == packages, [NSString stringWithFormat:@"a cold refresh adds all %lu packages", (unsigned long)packages]);
+
+        [server resetRequests];
+        changes = [self reloadRepository:repository error:&error];
+        NSArray *requests = server.requests;
+        succeeded &= CPMBenchmarkExpect(changes && changes.count == 0, @"refreshing an unchanged repository changes nothing");
+        succeeded &= CPMBenchmarkExpect(requests.count == 1, [NSString stringWithFormat:@"and takes one request (%@)", [requests componentsJoinedByString:@", "]]);
+
+        // the repository moves on, and publishes a patch from the index we have
+        published.revision = changed;
+        if (![published writeToPath:path error:&error]) {
+            fprintf(stderr, "cpm bench: %s\n", (error.localizedFailureReason ?: error.localizedDescription).UTF8String);
+            return NO;
+        }
+
+        [server resetRequests];
+        changes = [self reloadRepository:repository error:&error];
+        requests = server.requests;
+        NSString *patch = [NSString stringWithFormat:@"200 /%@revision%lu.gz", published.layout == CPMBenchmarkLayoutDists ? @"dists/stable/main/binary-iphoneos-arm/Packages.diff/" : @"Packages.diff/", (unsigned long)changed];
+        BOOL downloaded = [requests indexOfObjectPassingTest:^BOOL(NSString *request, NSUInteger idx, BOOL *stop) {
+            return [request hasPrefix:@"200 "] && [request rangeOfString:@"/Packages."].location != NSNotFound && [request rangeOfString:@".diff/"].location == NSNotFound;
+        }] != NSNotFound;
+
+        succeeded &= CPMBenchmarkExpect(changes && changes.upgraded.count == changed && changes.count == changed, [NSString stringWithFormat:@"a refresh after %lu new versions upgrades exactly those", (unsigned long)changed]);
+        succeeded &= CPMBenchmarkExpect([requests containsObject:patch], [NSString stringWithFormat:@"it fetches the patch (%@)", [requests componentsJoinedByString:@", "]]);
+        succeeded &= CPMBenchmarkExpect(!downloaded, @"and not the whole index");
+        succeeded &= CPMBenchmarkExpect([repository.refreshMetrics.counters[@"pdiff_failures"] doubleValue] == 0, @"the patch applies");
+
+        NSString *version = [repository packageWithIdentifier:@"com.bench.package00000"][@"version"];
+        succeeded &= CPMBenchmarkExpect([version hasSuffix:[NSString stringWithFormat:@"+r%lu", (unsigned long)changed]], @"the patched version is what the repository reads back");
+    }
+
+    [self removeLocalStorage];
+    return succeeded;
+}
+
+@end
@@ -0,0 +1,123 @@
+//
+//  CPMBenchmark+Parse.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMBenchmark+Private.h"
+#import "dictionarize.h"
+#import "stanza.h"
+#import <FMDatabase.h>
+
+// dictionarize() as it was before it was built on the stanza parser, so there
+// is something to compare against
+static NSDictionary *legacyDictionarize(NSString *data, NSArray *validKeys) {
+    NSArray *components = [data componentsSeparatedByString:@"\n"];
+    NSMutableDictionary *values = [NSMutableDictionary dictionary];
+
+    NSString *lastKey = nil;
+    for (NSString *segment in components) {
+        NSRange keyRange = [segment rangeOfString:@":"];
+        if (keyRange.location == NSNotFound) {
+            if (!lastKey)
+                continue;
+
+            NSString *lastValue = values[lastKey];
+            if (!lastValue.length) {
+                values[lastKey] = segment;
+            } else {
+                values[lastKey] = [lastValue stringByAppendingFormat:@"\n%@", segment];
+            }
+
+            continue;
+        }
+
+        NSString *key = [segment substringToIndex:keyRange.location].lowercaseString;
+        key = [key stringByReplacingOccurrencesOfString:@"-" withString:@"_"];
+        if (![validKeys containsObject:key])
+            continue;
+
+        NSString *value = [segment substringFromIndex:keyRange.location + keyRange.length];
+        values[key] = [value stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+        lastKey = key;
+    }
+
+    return values;
+}
+
+@implementation CPMBenchmark (Parse)
+
+// Best of -iterations runs of the block over every stanza; returns how many
+// stanzas had a Package field on the last run, so the three can be checked
+// against each other
+- (NSUInteger)measureParser:(NSString *)label data:(NSData *)data baseline:(NSTimeInterval *)baseline usingBlock:(BOOL (^)(const char *bytes, size_t length))block {
+    NSInteger iterations = MAX([self.defaults integerForKey:@"iterations"], 1);
+    NSTimeInterval best = DBL_MAX;
+    __block NSUInteger stanzas = 0, named = 0;
+
+    for (NSInteger i = 0; i < iterations; i++) {
+        stanzas = named = 0;
+        NSTimeInterval start = [NSProcessInfo processInfo].systemUptime;
+        @autoreleasepool {
+            CPMBenchmarkEnumerateStanzas(data, ^(const char *bytes, size_t length) {
+                stanzas++;
+                if (block(bytes, length))
+                    named++;
+            });
+        }
+        best = MIN(best, [NSProcessInfo processInfo].systemUptime - start);
+    }
+
+    if (!*baseline)
+        *baseline = best;
+
+    printf("%-14s %8.3fs %10.0f stanzas/s %8.1f MB/s %6.1fx\n",
+           label.UTF8String, best, stanzas / MAX(best, 1e-6), data.length / (1024.0 * 1024.0) / MAX(best, 1e-6), *baseline / MAX(best, 1e-6));
+    return named;
+}
+
+- (BOOL)runParseBenchmark {
+    NSData *packages = [self repositoryAtIndex:0].packagesData;
+    printf("parsing %lu packages, %.1f MB\n", (unsigned long)[self.defaults integerForKey:@"packages"], packages.length / (1024.0 * 1024.0));
+
+    // a packages table with the columns of the real one, which is all dictionarize() looks at
+    NSMutableArray *columns = [NSMutableArray array];
+    for (int field = 0; field <= CPMStanzaFieldReplaces; field++) {
+        [columns addObject:@(CPMStanzaFieldColumn(field))];
+    }
+
+    FMDatabase *db = [FMDatabase databaseWithPath:nil];
+    if (![db open] || ![db executeUpdate:[NSString stringWithFormat:@"create table packages (%@)", [columns componentsJoinedByString:@", "]]]) {
+        fprintf(stderr, "cpm bench: %s\n", db.lastErrorMessage.UTF8String);
+        return NO;
+    }
+
+    NSTimeInterval baseline = 0;
+    NSUInteger legacy = [self measureParser:@"legacy" data:packages baseline:&baseline usingBlock:^BOOL(const char *bytes, size_t length) {
+        NSString *stanza = [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding];
+        return legacyDictionarize(stanza, columns)[@"package"] != nil;
+    }];
+    NSUInteger dictionaries = [self measureParser:@"dictionarize" data:packages baseline:&baseline usingBlock:^BOOL(const char *bytes, size_t length) {
+        NSString *stanza = [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding];
+        return dictionarize(stanza, db, @"packages")[@"package"] != nil;
+    }];
+    NSUInteger views = [self measureParser:@"CPMStanzaParse" data:packages baseline:&baseline usingBlock:^BOOL(const char *bytes, size_t length) {
+        CPMStanza stanza;
+        CPMStanzaParse(bytes, length, &stanza);
+        return stanza.values[CPMStanzaFieldPackage].length > 0;
+    }];
+
+    [db close];
+
+    if (legacy != dictionaries || legacy != views) {
+        fprintf(stderr, "cpm bench: the parsers disagree on how many stanzas name a package (%lu, %lu, %lu)\n",
+                (unsigned long)legacy, (unsigned long)dictionaries, (unsigned long)views);
+        return NO;
+    }
+
+    return YES;
+}
+
+@end
@@ -0,0 +1,81 @@
+//
+//  CPMBenchmark+Private.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMBenchmark.h"
+#import "CPDefines.h"
+#import "CPMBenchmarkRepository.h"
+#import "CPMRepository.h"
+#import "CPMDpkgRepositoryAggregate.h"
+
+// The process' peak resident size so far
+double CPMBenchmarkPeakResidentMegabytes(void);
+
+// Calls the block with every paragraph of a Packages file, without the blank
+// lines between them
+void CPMBenchmarkEnumerateStanzas(NSData *data, void (^block)(const char *bytes, size_t length));
+
+// Prints the outcome of one check of a test mode and returns it
+BOOL CPMBenchmarkExpect(BOOL condition, NSString *description);
+
+@interface CPMBenchmark ()
+@property (strong) NSUserDefaults *defaults;
+// scratch space, removed once the run is over
+@property (copy) NSString *workPath;
+// stopped once the run is over
+@property (strong) NSMutableArray *servers;
+
+// The repository the settings describe; index tells several apart
+- (CPMBenchmarkRepository *)repositoryAtIndex:(NSInteger)index;
+- (BOOL)generateRepositories:(NSError **)error;
+- (BOOL)startServers:(NSError **)error;
+- (void)removeLocalStorage;
+// Reload and wait, running the main run loop. The aggregate one reports
+// failures on stderr and returns how many repositories failed.
+- (CPMPackageChanges *)reloadRepository:(CPMRepository *)repository error:(NSError **)error;
+- (NSUInteger)reloadAggregate:(CPMDpkgRepositoryAggregate *)aggregate;
+
+// A repository with a database of its own that is never reloaded, for modes
+// that fill it themselves, and the removal of what it left behind once it is
+// gone
+- (CPMRepository *)scratchRepositoryNamed:(NSString *)name;
+- (void)removeScratchRepositoryNamed:(NSString *)name;
+@end
+
+// Every mode returns NO if anything it ran or checked failed, having said what.
+
+@interface CPMBenchmark (Parse)
+- (BOOL)runParseBenchmark;
+@end
+
+@interface CPMBenchmark (Insert)
+- (BOOL)runInsertBenchmark;
+@end
+
+@interface CPMBenchmark (PDiff)
+- (BOOL)runPDiffTest;
+@end
+
+@interface CPMBenchmark (Lookup)
+- (BOOL)runLookupBenchmark;
+@end
+
+@interface CPMBenchmark (Solver)
+- (BOOL)runSolverBenchmark;
+@end
+
+@interface CPMBenchmark (Download)
+- (BOOL)runDownloadTest;
+@end
+
+@interface CPMBenchmark (Stress)
+- (BOOL)runStressTest;
+@end
+
+@interface CPMBenchmark (Codecs)
+- (BOOL)runCodecsBenchmark;
+@end
@@ -0,0 +1,263 @@
+//
+//  CPMBenchmark+Solver.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMBenchmark+Private.h"
+#import "CPMPackagesWriter.h"
+#import "CPMPackageIndex.h"
+#import "CPMResolver.h"
+
+// One synthetic dependency graph: its stanzas, by the component they are
+// published in, and what installing its roots has to come to
+@interface CPMBenchmarkGraph : NSObject
+@property (copy) NSString *name;
+@property (strong) NSMutableDictionary *components;
+@property (copy) NSArray *roots;
+@property (assign) NSUInteger expectedInstalls;
+// if set, every install has to be of this version
+@property (copy) NSString *expectedVersion;
+@property (assign) NSUInteger packageCount;
+- (void)addPackage:(NSString *)package version:(NSString *)version fields:(NSString *)fields;
+- (void)addPackage:(NSString *)package version:(NSString *)version fields:(NSString *)fields component:(NSString *)component;
+@end
+
+@implementation CPMBenchmarkGraph
+
+- (instancetype)initWithName:(NSString *)name {
+    if ((self = [self init])) {
+        self.name = name;
+        self.components = [NSMutableDictionary dictionary];
+    }
+
+    return self;
+}
+
+- (void)addPackage:(NSString *)package version:(NSString *)version fields:(NSString *)fields {
+    [self addPackage:package version:version fields:fields component:@"main"];
+}
+
+- (void)addPackage:(NSString *)package version:(NSString *)version fields:(NSString *)fields component:(NSString *)component {
+    NSMutableString *stanzas = self.components[component];
+    if (!stanzas)
+        stanzas = self.components[component] = [NSMutableString string];
+
+    [stanzas appendFormat:@"Package: %@\nVersion: %@\nArchitecture: all\nFilename: debs/%@_%@_all.deb\n%@\n", package, version, package, version, fields ?: @""];
+    self.packageCount++;
+}
+
+@end
+
+@implementation CPMBenchmark (Solver)
+
+// Every package depends on the one before it
+- (CPMBenchmarkGraph *)chainGraphOfSize:(NSUInteger)size {
+    CPMBenchmarkGraph *graph = [[CPMBenchmarkGraph alloc] initWithName:@"chain"];
+    for (NSUInteger i = 0; i < size; i++) {
+        NSString *depends = i ? [NSString stringWithFormat:@"Depends: chain-%lu (>= 1.0)\n", (unsigned long)i - 1] : nil;
+        [graph addPackage:[NSString stringWithFormat:@"chain-%lu", (unsigned long)i] version:[NSString stringWithFormat:@"1.%lu", (unsigned long)i] fields:depends];
+    }
+
+    graph.roots = @[ [NSString stringWithFormat:@"chain-%lu", (unsigned long)size - 1] ];
+    graph.expectedInstalls = size;
+    return graph;
+}
+
+// One package depends on all the others
+- (CPMBenchmarkGraph *)fanGraphOfSize:(NSUInteger)size {
+    CPMBenchmarkGraph *graph = [[CPMBenchmarkGraph alloc] initWithName:@"fan"];
+    NSMutableArray *leaves = [NSMutableArray array];
+    for (NSUInteger i = 1; i < size; i++) {
+        NSString *leaf = [NSString stringWithFormat:@"fan-leaf-%lu", (unsigned long)i];
+        [graph addPackage:leaf version:@"1.0" fields:nil];
+        [leaves addObject:leaf];
+    }
+
+    [graph addPackage:@"fan-root" version:@"1.0" fields:[NSString stringWithFormat:@"Depends: %@\n", [leaves componentsJoinedByString:@", "]]];
+    graph.roots = @[ @"fan-root" ];
+    graph.expectedInstalls = size;
+    return graph;
+}
+
+// Layers of packages that each depend on three of the next layer, like
+// tweaks on libraries on frameworks; everything in the first layer is asked for
+- (CPMBenchmarkGraph *)layeredGraphOfSize:(NSUInteger)size seed:(uint64_t)seed {
+    CPMBenchmarkGraph *graph = [[CPMBenchmarkGraph alloc] initWithName:@"layered"];
+    NSUInteger width = MAX((NSUInteger)sqrt(size), 1);
+    NSUInteger layers = MAX(size / width, 1);
+    uint64_t state = seed * 0x9E3779B97F4A7C15ULL ?: 1;
+
+    // reachable from the first layer, to know what the transaction has to hold
+    NSMutableIndexSet *reachable = [NSMutableIndexSet indexSetWithIndexesInRange:NSMakeRange(0, width)];
+    NSMutableArray *roots = [NSMutableArray array];
+    for (NSUInteger layer = 0; layer < layers; layer++) {
+        for (NSUInteger p = 0; p < width; p++) {
+            NSUInteger node = layer * width + p;
+            NSMutableArray *depends = [NSMutableArray array];
+            for (int d = 0; d < 3 && layer + 1 < layers; d++) {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                NSUInteger dependency = (layer + 1) * width + state % width;
+                [depends addObject:[NSString stringWithFormat:@"layered-%lu (>= 1.0)", (unsigned long)dependency]];
+                if ([reachable containsIndex:node])
+                    [reachable addIndex:dependency];
+            }
+
+            NSString *fields = depends.count ? [NSString stringWithFormat:@"Depends: %@\n", [depends componentsJoinedByString:@", "]] : nil;
+            [graph addPackage:[NSString stringWithFormat:@"layered-%lu", (unsigned long)node] version:@"1.0" fields:fields];
+            if (!layer)
+                [roots addObject:[NSString stringWithFormat:@"layered-%lu", (unsigned long)node]];
+        }
+    }
+
+    graph.roots = roots;
+    graph.expectedInstalls = reachable.count;
+    return graph;
+}
+
+// Dependencies on virtual packages two real ones provide, and on
+// alternatives whose first choice doesn't exist
+- (CPMBenchmarkGraph *)virtualGraphOfSize:(NSUInteger)size {
+    CPMBenchmarkGraph *graph = [[CPMBenchmarkGraph alloc] initWithName:@"virtual"];
+    NSUInteger consumers = MAX(size / 4, 1);
+    NSMutableArray *names = [NSMutableArray array];
+    for (NSUInteger i = 0; i < consumers; i++) {
+        NSString *consumer = [NSString stringWithFormat:@"virtual-consumer-%lu", (unsigned long)i];
+        [graph addPackage:consumer version:@"1.0" fields:[NSString stringWithFormat:@"Depends: virtual-api-%lu, virtual-absent-%lu | virtual-alternative-%lu\n", (unsigned long)i, (unsigned long)i, (unsigned long)i]];
+        [graph addPackage:[NSString stringWithFormat:@"virtual-provider-a-%lu", (unsigned long)i] version:@"1.0" fields:[NSString stringWithFormat:@"Provides: virtual-api-%lu\n", (unsigned long)i]];
+        [graph addPackage:[NSString stringWithFormat:@"virtual-provider-b-%lu", (unsigned long)i] version:@"1.0" fields:[NSString stringWithFormat:@"Provides: virtual-api-%lu\n", (unsigned long)i]];
+        [graph addPackage:[NSString stringWithFormat:@"virtual-alternative-%lu", (unsigned long)i] version:@"1.0" fields:nil];
+        [names addObject:consumer];
+    }
+
+    [graph addPackage:@"virtual-root" version:@"1.0" fields:[NSString stringWithFormat:@"Depends: %@\n", [names componentsJoinedByString:@", "]]];
+    graph.roots = @[ @"virtual-root" ];
+    // the root, and per consumer itself, one provider and the alternative
+    graph.expectedInstalls = 1 + consumers * 3;
+    return graph;
+}
+
+// Four versions of every package, published in as many components, of which
+// the dependencies only allow the newest below 2.0
+- (CPMBenchmarkGraph *)versionedGraphOfSize:(NSUInteger)size {
+    CPMBenchmarkGraph *graph = [[CPMBenchmarkGraph alloc] initWithName:@"versions"];
+    NSUInteger packages = MAX(size / 4, 1);
+    NSArray *versions = @[ @"1.0", @"1.1", @"2.0", @"2.1" ];
+    NSMutableArray *depends = [NSMutableArray array];
+    for (NSUInteger i = 0; i < packages; i++) {
+        NSString *package = [NSString stringWithFormat:@"versions-%lu", (unsigned long)i];
+        [versions enumerateObjectsUsingBlock:^(NSString *version, NSUInteger idx, BOOL *stop) {
+            [graph addPackage:package version:version fields:nil component:[NSString stringWithFormat:@"v%lu", (unsigned long)idx]];
+        }];
+        [depends addObject:[NSString stringWithFormat:@"%@ (<< 2.0)", package]];
+    }
+
+    [graph addPackage:@"versions-root" version:@"1.1" fields:[NSString stringWithFormat:@"Depends: %@\n", [depends componentsJoinedByString:@", "]]];
+    graph.roots = @[ @"versions-root" ];
+    graph.expectedInstalls = packages + 1;
+    graph.expectedVersion = @"1.1";
+    return graph;
+}
+
+- (BOOL)writeGraphs:(NSArray *)graphs toRepository:(CPMRepository *)repository {
+    __block BOOL succeeded = YES;
+    [repository.databaseQueue inDatabase:^(FMDatabase *db) {
+        CPMPackagesWriter *writer = [[CPMPackagesWriter alloc] initWithDatabase:db];
+        succeeded = [writer begin];
+
+        NSMutableSet *components = [NSMutableSet set];
+        for (CPMBenchmarkGraph *graph in graphs) {
+            for (NSString *component in graph.components) {
+                [components addObject:component];
+                NSData *stanzas = [graph.components[component] dataUsingEncoding:NSUTF8StringEncoding];
+                CPMBenchmarkEnumerateStanzas(stanzas, ^(const char *bytes, size_t length) {
+                    CPMStanza stanza;
+                    CPMStanzaParse(bytes, length, &stanza);
+                    if (succeeded)
+                        succeeded = [writer writeStanza:&stanza component:component.UTF8String architecture:""];
+                });
+            }
+        }
+
+        for (NSString *component in components) {
+            if (succeeded)
+                succeeded = [writer removeRowsNotWrittenInComponent:component.UTF8String architecture:""];
+        }
+
+        if (succeeded && [writer commit])
+            return;
+
+        fprintf(stderr, "cpm bench: %s\n", (writer.error.localizedFailureReason ?: writer.error.localizedDescription).UTF8String);
+        [writer rollback];
+        succeeded = NO;
+    }];
+
+    return succeeded;
+}
+
+- (BOOL)runSolverBenchmark {
+    NSUInteger size = MAX([self.defaults integerForKey:@"packages"] / 5, 2);
+    NSInteger iterations = MAX([self.defaults integerForKey:@"iterations"], 1);
+    NSArray *graphs = @[ [self chainGraphOfSize:size],
+                         [self fanGraphOfSize:size],
+                         [self layeredGraphOfSize:size seed:[self.defaults integerForKey:@"seed"]],
+                         [self virtualGraphOfSize:size],
+                         [self versionedGraphOfSize:size] ];
+
+    BOOL succeeded = YES;
+    @autoreleasepool {
+        CPMRepository *repository = [self scratchRepositoryNamed:@"solver"];
+        if (!repository || ![self writeGraphs:graphs toRepository:repository]) {
+            fprintf(stderr, "cpm bench: could not write the graphs to a database under %s\n", LOCALSTORAGE_PATH.UTF8String);
+            [self removeScratchRepositoryNamed:@"solver"];
+            return NO;
+        }
+
+        CPMPackageIndex *index = [[CPMPackageIndex alloc] init];
+        [index addRepository:repository];
+        NSTimeInterval start = [NSProcessInfo processInfo].systemUptime;
+        [index reloadStaleRepositories];
+        printf("indexed %lu packages in %.3fs\n", (unsigned long)index.count, [NSProcessInfo processInfo].systemUptime - start);
+
+        for (CPMBenchmarkGraph *graph in graphs) {
+            NSTimeInterval best = DBL_MAX;
+            CPMTransaction *transaction = nil;
+            NSError *error = nil;
+            for (NSInteger i = 0; i < iterations; i++) {
+                @autoreleasepool {
+                    // nothing is installed, so dpkg's database plays no part
+                    CPMResolver *resolver = [[CPMResolver alloc] initWithPackageIndex:index];
+                    resolver.installedPackages = @[];
+                    start = [NSProcessInfo processInfo].systemUptime;
+                    transaction = [resolver transactionForInstallingIdentifiers:graph.roots error:&error];
+                    best = MIN(best, [NSProcessInfo processInfo].systemUptime - start);
+                }
+            }
+
+            printf("%-9s %7lu packages %7lu roots %10.2f ms %7lu installs\n", graph.name.UTF8String, (unsigned long)graph.packageCount,
+                   (unsigned long)graph.roots.count, best * 1000, (unsigned long)transaction.installs.count);
+
+            if (!transaction) {
+                succeeded &= CPMBenchmarkExpect(NO, [NSString stringWithFormat:@"%@ resolves (%@)", graph.name, error.localizedFailureReason ?: error.localizedDescription]);
+                continue;
+            }
+
+            succeeded &= CPMBenchmarkExpect(transaction.installs.count == graph.expectedInstalls,
+                                            [NSString stringWithFormat:@"%@ installs %lu packages", graph.name, (unsigned long)graph.expectedInstalls]);
+            if (graph.expectedVersion) {
+                NSSet *versions = [NSSet setWithArray:[transaction.installs valueForKey:@"version"]];
+                succeeded &= CPMBenchmarkExpect([versions isEqualToSet:[NSSet setWithObject:graph.expectedVersion]],
+                                                [NSString stringWithFormat:@"%@ only installs %@", graph.name, graph.expectedVersion]);
+            }
+        }
+    }
+
+    [self removeScratchRepositoryNamed:@"solver"];
+    return succeeded;
+}
+
+@end
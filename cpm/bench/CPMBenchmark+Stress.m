@@ -0,0 +1,182 @@
+//
+//  CPMBenchmark+Stress.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMBenchmark+Private.h"
+#import "CPMBenchmarkServer.h"
+#import <stdatomic.h>
+
+typedef NS_ENUM(NSUInteger, CPMBenchmarkQuery) {
+    // full-text search through the reader pool
+    CPMBenchmarkQuerySearch,
+    // a lookup by identifier through the reader pool
+    CPMBenchmarkQueryPool,
+    // the same lookup through the writer queue, the way every read used to go
+    CPMBenchmarkQueryWriter,
+    CPMBenchmarkQueryCount
+};
+
+static NSString *const CPMBenchmarkQueryLabels[CPMBenchmarkQueryCount] = { @"search, pool", @"lookup, pool", @"lookup, writer" };
+
+@implementation CPMBenchmark (Stress)
+
+// Runs the three kinds of query in turn on every thread, count times each or
+// until stop is set, and adds each one's latency to latencies[kind]. Returns
+// the number of pool lookups that found nothing.
+- (NSUInteger)queryRepository:(CPMRepository *)repository threads:(NSUInteger)threads count:(NSUInteger)count stop:(atomic_bool *)stop latencies:(NSArray *)latencies waitUsingBlock:(void (^)(void))wait {
+    NSUInteger packages = MAX([self.defaults integerForKey:@"packages"], 1);
+    uint64_t seed = [self.defaults integerForKey:@"seed"];
+    __block NSUInteger misses = 0;
+    dispatch_group_t group = dispatch_group_create();
+
+    for (NSUInteger t = 0; t < threads; t++) {
+        dispatch_group_async(group, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            NSMutableData *own[CPMBenchmarkQueryCount];
+            for (NSUInteger kind = 0; kind < CPMBenchmarkQueryCount; kind++) {
+                own[kind] = [NSMutableData data];
+            }
+
+            NSUInteger ownMisses = 0;
+            uint64_t state = (seed + t) * 0x9E3779B97F4A7C15ULL ?: 1;
+            for (NSUInteger i = 0; stop ? !atomic_load(stop) : i < count; i++) {
+                @autoreleasepool {
+                    state ^= state << 13;
+                    state ^= state >> 7;
+                    state ^= state << 17;
+                    NSUInteger package = state % packages;
+                    NSString *identifier = [NSString stringWithFormat:@"com.bench.package%05lu", (unsigned long)package];
+                    NSString *query = [NSString stringWithFormat:@"select version from packages where package = ? and %@ limit 1", repository.architectureCondition];
+
+                    for (NSUInteger kind = 0; kind < CPMBenchmarkQueryCount; kind++) {
+                        NSTimeInterval start = [NSProcessInfo processInfo].systemUptime;
+                        __block BOOL found = NO;
+                        if (kind == CPMBenchmarkQuerySearch) {
+                            [repository searchForPackage:[NSString stringWithFormat:@"package %lu", (unsigned long)package % 1000] limit:20];
+                        } else {
+                            void (^lookup)(FMDatabase *) = ^(FMDatabase *db) {
+                                FMResultSet *results = [db executeQuery:query, identifier];
+                                found = [results next];
+                                [results close];
+                            };
+                            if (kind == CPMBenchmarkQueryPool)
+                                [repository.readerPool inDatabase:lookup];
+                            else
+                                [repository.databaseQueue inDatabase:lookup];
+                        }
+
+                        double latency = [NSProcessInfo processInfo].systemUptime - start;
+                        [own[kind] appendBytes:&latency length:sizeof(latency)];
+                        if (kind == CPMBenchmarkQueryPool && !found)
+                            ownMisses++;
+                    }
+                }
+            }
+
+            @synchronized (latencies) {
+                misses += ownMisses;
+                for (NSUInteger kind = 0; kind < CPMBenchmarkQueryCount; kind++) {
+                    [latencies[kind] appendData:own[kind]];
+                }
+            }
+        });
+    }
+
+    if (wait)
+        wait();
+    if (stop)
+        atomic_store(stop, true);
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+
+    return misses;
+}
+
+- (void)printLatencies:(NSArray *)latencies label:(NSString *)label {
+    for (NSUInteger kind = 0; kind < CPMBenchmarkQueryCount; kind++) {
+        NSMutableData *data = latencies[kind];
+        double *values = data.mutableBytes;
+        NSUInteger count = data.length / sizeof(double);
+        if (!count)
+            continue;
+
+        qsort_b(values, count, sizeof(double), ^int(const void *a, const void *b) {
+            double x = *(const double *)a, y = *(const double *)b;
+            return x < y ? -1 : x > y;
+        });
+
+        double (^percentile)(double) = ^double(double p) {
+            return values[MIN(count - 1, (NSUInteger)(p * count))] * 1000;
+        };
+        printf("%-7s %-15s %8lu queries  p50 %8.3f ms  p90 %8.3f ms  p99 %8.3f ms  max %8.3f ms\n", label.UTF8String, CPMBenchmarkQueryLabels[kind].UTF8String,
+               (unsigned long)count, percentile(0.5), percentile(0.9), percentile(0.99), values[count - 1] * 1000);
+    }
+}
+
+- (BOOL)runStressTest {
+    NSError *error = nil;
+    if (![self generateRepositories:&error] || ![self startServers:&error]) {
+        fprintf(stderr, "cpm bench: %s\n", (error.localizedFailureReason ?: error.localizedDescription).UTF8String);
+        return NO;
+    }
+
+    NSUInteger packages = [self.defaults integerForKey:@"packages"];
+    NSUInteger threads = MAX([self.defaults integerForKey:@"threads"], 1);
+    CPMBenchmarkServer *server = self.servers.firstObject;
+    BOOL succeeded = YES;
+    [self removeLocalStorage];
+
+    @autoreleasepool {
+        CPMRepository *repository = [CPMRepository repositoryWithURL:server.baseURL];
+        CPMPackageChanges *changes = [self reloadRepository:repository error:&error];
+        if (!CPMBenchmarkExpect(changes.added.count == packages, [NSString stringWithFormat:@"a cold refresh adds all %lu packages (%@)", (unsigned long)packages, error.localizedFailureReason ?: error.localizedDescription])) {
+            [self removeLocalStorage];
+            return NO;
+        }
+
+        NSMutableArray *idle = [NSMutableArray array];
+        NSMutableArray *ingest = [NSMutableArray array];
+        for (NSUInteger kind = 0; kind < CPMBenchmarkQueryCount; kind++) {
+            [idle addObject:[NSMutableData data]];
+            [ingest addObject:[NSMutableData data]];
+        }
+
+        NSUInteger misses = [self queryRepository:repository threads:threads count:200 stop:NULL latencies:idle waitUsingBlock:nil];
+        succeeded &= CPMBenchmarkExpect(misses == 0, @"every package is found while nothing is written");
+
+        // every package gets a new version, so the ingest rewrites every row
+        CPMBenchmarkRepository *published = [self repositoryAtIndex:0];
+        published.revision = packages;
+        if (![published writeToPath:[self.workPath stringByAppendingPathComponent:@"repo0"] error:&error]) {
+            fprintf(stderr, "cpm bench: %s\n", (error.localizedFailureReason ?: error.localizedDescription).UTF8String);
+            [self removeLocalStorage];
+            return NO;
+        }
+
+        __block CPMPackageChanges *upgrade = nil;
+        __block NSTimeInterval refresh = 0;
+        __block NSError *failure = nil;
+        atomic_bool stop = false;
+        misses = [self queryRepository:repository threads:threads count:0 stop:&stop latencies:ingest waitUsingBlock:^{
+            NSTimeInterval start = [NSProcessInfo processInfo].systemUptime;
+            NSError *error = nil;
+            upgrade = [self reloadRepository:repository error:&error];
+            failure = error;
+            refresh = [NSProcessInfo processInfo].systemUptime - start;
+        }];
+
+        printf("refreshed %lu upgraded packages in %.3fs under %lu querying threads\n", (unsigned long)upgrade.upgraded.count, refresh, (unsigned long)threads);
+        [self printLatencies:idle label:@"idle"];
+        [self printLatencies:ingest label:@"ingest"];
+
+        succeeded &= CPMBenchmarkExpect(upgrade.upgraded.count == packages, [NSString stringWithFormat:@"the refresh upgrades all %lu packages (%@)", (unsigned long)packages, failure.localizedFailureReason ?: failure.localizedDescription]);
+        succeeded &= CPMBenchmarkExpect(misses == 0, @"and readers always see a whole committed index meanwhile");
+    }
+
+    [self removeLocalStorage];
+    return succeeded;
+}
+
+@end
@@ -0,0 +1,74 @@
+//
+//  CPMBenchmark.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+// Offline benchmarks of the refresh pipeline and its parts, on synthetic
+// repositories, picked with -mode:
+//
+//   refresh  (the default) serves each repository from its own local server
+//            and reloads them through CPMDpkgRepositoryAggregate, once cold
+//            and then warm. Every run reports wall time, rows per second and
+//            the process' peak resident size so far.
+//   parse    times dictionarize() as it was, as it is now and the stanza
+//            parser on its own over one Packages index.
+//   insert   loads one Packages index into a repository database with a
+//            statement per row, as ingests used to, then with
+//            CPMPackagesWriter into an empty table and into one that has
+//            every row already.
+//   pdiff    checks incremental refreshes against a local server: a second
+//            refresh of an unchanged repository takes one request, and one
+//            after -changed packages got new versions patches the index
+//            through a PDiff instead of downloading it again. Needs diff and
+//            gzip in the PATH.
+//   lookup   refreshes -repos repositories, then looks up -lookups random
+//            identifiers, some missing, through CPMPackageIndex and through
+//            a query per repository as the aggregate used to.
+//   solve    resolves installs over synthetic dependency graphs of about a
+//            fifth of -packages each: a chain, a fan, layers of shared
+//            libraries, virtual packages with alternatives, and several
+//            versions under an upper bound. Checks what each transaction
+//            holds.
+//   download checks resumable .deb downloads against a local server: ones
+//            whose connection drops halfway finish with a Range request for
+//            the rest, partial files a killed run left are resumed, and ones
+//            that can't be are started over or fail their checksum without
+//            leaving anything behind.
+//   stress   refreshes one repository, then queries it from -threads threads,
+//            first on their own and then while a refresh rewrites every
+//            row, and reports latency percentiles of full-text searches and
+//            lookups through the reader pool and of lookups through the
+//            writer queue.
+//   codecs   compresses one Packages index with every codec the refresh
+//            decodes, as one member and as one per core where the format
+//            allows several, and times decompressData() on each and an
+//            index stream that already has the whole body. Needs the
+//            compressors in the PATH; ones that are missing are skipped.
+//
+// Settings are read from the defaults, so the command line can set them:
+//
+//   cpm bench -packages 50000 -repos 4 -layout dists -compression xz,gz
+//             -fieldSize 400 -latency 80 -bandwidth 2048 -warmRuns 3
+//             -seed 7 -trace /tmp/refresh.json
+//   cpm bench -mode parse -packages 50000 -iterations 5
+//   cpm bench -mode pdiff -packages 5000 -changed 20
+//   cpm bench -mode stress -packages 50000 -threads 16
+//
+// latency is in milliseconds, bandwidth in KB/s per connection (0 for
+// unlimited), layout is flat, dists or mixed, and "none" publishes the
+// uncompressed index. With -trace, each run also writes a Chrome trace next
+// to the path, named after the run. Timed parts of the other modes run
+// -iterations times and report the best.
+@interface CPMBenchmark : NSObject
+
+- (instancetype)initWithDefaults:(NSUserDefaults *)defaults;
+
+// Runs everything and returns the exit status: 0, or 1 if anything failed.
+- (int)run;
+
+@end
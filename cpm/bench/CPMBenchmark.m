@@ -0,0 +1,279 @@
+//
+//  CPMBenchmark.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMBenchmark+Private.h"
+#import "CPMBenchmarkServer.h"
+#import "CPMDpkgRepositoryAggregate.h"
+#import "CPDefines.h"
+#import <sys/resource.h>
+
+double CPMBenchmarkPeakResidentMegabytes(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    // bytes on Darwin, kilobytes everywhere else
+    return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+    return usage.ru_maxrss / 1024.0;
+#endif
+}
+
+void CPMBenchmarkEnumerateStanzas(NSData *data, void (^block)(const char *bytes, size_t length)) {
+    const char *bytes = data.bytes;
+    const char *end = bytes + data.length;
+    while (bytes < end) {
+        while (bytes < end && *bytes == '\n')
+            bytes++;
+        if (bytes == end)
+            break;
+
+        const char *stop = memmem(bytes, end - bytes, "\n\n", 2);
+        size_t length = stop ? (size_t)(stop - bytes) + 1 : (size_t)(end - bytes);
+        block(bytes, length);
+        bytes += length;
+    }
+}
+
+BOOL CPMBenchmarkExpect(BOOL condition, NSString *description) {
+    printf("%s %s\n", condition ? "ok  " : "FAIL", description.UTF8String);
+    return condition;
+}
+
+@interface CPMBenchmark (Refresh)
+- (BOOL)runRefreshBenchmark;
+- (BOOL)reloadWithLabel:(NSString *)label;
+@end
+
+@implementation CPMBenchmark
+
+- (instancetype)initWithDefaults:(NSUserDefaults *)defaults {
+    if ((self = [self init])) {
+        [defaults registerDefaults:@{ @"mode": @"refresh",
+                                      @"packages": @20000,
+                                      @"repos": @1,
+                                      @"layout": @"flat",
+                                      @"compression": @"xz",
+                                      @"fieldSize": @200,
+                                      @"latency": @0,
+                                      @"bandwidth": @0,
+                                      @"warmRuns": @2,
+                                      @"seed": @1,
+                                      @"iterations": @3,
+                                      @"changed": @10,
+                                      @"lookups": @100000,
+                                      @"threads": @8 }];
+        self.defaults = defaults;
+        self.workPath = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"cpm-bench-%d", getpid()]];
+        self.servers = [NSMutableArray array];
+    }
+
+    return self;
+}
+
+- (int)run {
+    NSDictionary *modes = @{ @"refresh": ^BOOL { return [self runRefreshBenchmark]; },
+                             @"parse": ^BOOL { return [self runParseBenchmark]; },
+                             @"insert": ^BOOL { return [self runInsertBenchmark]; },
+                             @"pdiff": ^BOOL { return [self runPDiffTest]; },
+                             @"lookup": ^BOOL { return [self runLookupBenchmark]; },
+                             @"solve": ^BOOL { return [self runSolverBenchmark]; },
+                             @"download": ^BOOL { return [self runDownloadTest]; },
+                             @"stress": ^BOOL { return [self runStressTest]; },
+                             @"codecs": ^BOOL { return [self runCodecsBenchmark]; } };
+
+    NSString *mode = [self.defaults stringForKey:@"mode"];
+    BOOL (^runMode)(void) = modes[mode];
+    if (!runMode) {
+        fprintf(stderr, "cpm bench: no mode %s, try one of %s\n", mode.UTF8String, [[modes.allKeys sortedArrayUsingSelector:@selector(compare:)] componentsJoinedByString:@", "].UTF8String);
+        return 1;
+    }
+
+    BOOL succeeded = runMode();
+
+    [self.servers makeObjectsPerformSelector:@selector(stop)];
+    [[NSFileManager defaultManager] removeItemAtPath:self.workPath error:nil];
+
+    return succeeded ? 0 : 1;
+}
+
+- (CPMBenchmarkRepository *)repositoryAtIndex:(NSInteger)index {
+    NSMutableArray *compressions = [NSMutableArray array];
+    for (NSString *compression in [[self.defaults stringForKey:@"compression"] componentsSeparatedByString:@","]) {
+        [compressions addObject:[compression isEqualToString:@"none"] ? @"" : compression];
+    }
+
+    NSString *layout = [self.defaults stringForKey:@"layout"];
+    CPMBenchmarkRepository *repository = [[CPMBenchmarkRepository alloc] init];
+    repository.packageCount = MAX([self.defaults integerForKey:@"packages"], 0);
+    repository.fieldSize = MAX([self.defaults integerForKey:@"fieldSize"], 1);
+    repository.compressions = compressions;
+    repository.seed = [self.defaults integerForKey:@"seed"] + index;
+    if ([layout isEqualToString:@"dists"] || ([layout isEqualToString:@"mixed"] && index % 2))
+        repository.layout = CPMBenchmarkLayoutDists;
+
+    return repository;
+}
+
+- (BOOL)generateRepositories:(NSError **)error {
+    NSInteger count = MAX([self.defaults integerForKey:@"repos"], 1);
+    NSTimeInterval start = [NSProcessInfo processInfo].systemUptime;
+
+    for (NSInteger i = 0; i < count; i++) {
+        NSString *path = [self.workPath stringByAppendingPathComponent:[NSString stringWithFormat:@"repo%ld", (long)i]];
+        if (![[self repositoryAtIndex:i] writeToPath:path error:error])
+            return NO;
+    }
+
+    printf("generated %ld repositories of %ld packages in %.2fs\n", (long)count, (long)[self.defaults integerForKey:@"packages"], [NSProcessInfo processInfo].systemUptime - start);
+    return YES;
+}
+
+- (BOOL)startServers:(NSError **)error {
+    NSArray *repositories = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:self.workPath error:error];
+    if (!repositories)
+        return NO;
+
+    // a server each, so the scheduler treats them as separate mirrors
+    for (NSString *name in [repositories sortedArrayUsingSelector:@selector(compare:)]) {
+        CPMBenchmarkServer *server = [[CPMBenchmarkServer alloc] initWithRootPath:[self.workPath stringByAppendingPathComponent:name]];
+        server.latency = [self.defaults doubleForKey:@"latency"] / 1000;
+        server.bytesPerSecond = MAX([self.defaults integerForKey:@"bandwidth"], 0) * 1024;
+        if (![server start:error])
+            return NO;
+
+        [self.servers addObject:server];
+    }
+
+    return YES;
+}
+
+- (void)removeLocalStorage {
+    // everything a repository keeps is named after its url, which has the server's port in it
+    NSFileManager *manager = [NSFileManager defaultManager];
+    NSArray *files = [manager contentsOfDirectoryAtPath:LOCALSTORAGE_PATH error:nil];
+    for (CPMBenchmarkServer *server in self.servers) {
+        NSString *prefix = [NSString stringWithFormat:@"%@@%@_", server.baseURL.host, server.baseURL.port];
+        for (NSString *file in files) {
+            if ([file hasPrefix:prefix])
+                [manager removeItemAtPath:[LOCALSTORAGE_PATH stringByAppendingPathComponent:file] error:nil];
+        }
+    }
+}
+
+- (CPMPackageChanges *)reloadRepository:(CPMRepository *)repository error:(NSError **)error {
+    __block BOOL finished = NO;
+    __block CPMPackageChanges *result = nil;
+    __block NSError *failure = nil;
+    [repository reloadData:^(CPMPackageChanges *changes, NSError *error) {
+        result = changes;
+        failure = error;
+        finished = YES;
+    }];
+
+    // completions arrive on the main queue
+    while (!finished) {
+        [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+    }
+
+    if (error)
+        *error = failure;
+    return result;
+}
+
+- (NSUInteger)reloadAggregate:(CPMDpkgRepositoryAggregate *)aggregate {
+    __block BOOL finished = NO;
+    __block NSUInteger failures = 0;
+    [aggregate reloadDataWithCompletion:^(CPMRepository *repo, CPMPackageChanges *changes, NSError *error, BOOL allFinished) {
+        if (error) {
+            failures++;
+            fprintf(stderr, "%s: %s\n", repo.url.absoluteString.UTF8String, (error.localizedFailureReason ?: error.localizedDescription).UTF8String);
+        }
+        finished = allFinished;
+    }];
+
+    // completions arrive on the main queue
+    while (!finished) {
+        [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+    }
+
+    return failures;
+}
+
+- (NSString *)scratchPrefixForName:(NSString *)name {
+    return [NSString stringWithFormat:@"scratch.invalid_%@-%d", name, getpid()];
+}
+
+- (CPMRepository *)scratchRepositoryNamed:(NSString *)name {
+    NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"http://scratch.invalid/%@-%d", name, getpid()]];
+    return [CPMRepository repositoryWithURL:url];
+}
+
+- (void)removeScratchRepositoryNamed:(NSString *)name {
+    NSFileManager *manager = [NSFileManager defaultManager];
+    NSString *prefix = [self scratchPrefixForName:name];
+    for (NSString *file in [manager contentsOfDirectoryAtPath:LOCALSTORAGE_PATH error:nil]) {
+        if ([file hasPrefix:prefix])
+            [manager removeItemAtPath:[LOCALSTORAGE_PATH stringByAppendingPathComponent:file] error:nil];
+    }
+}
+
+@end
+
+@implementation CPMBenchmark (Refresh)
+
+- (BOOL)runRefreshBenchmark {
+    NSError *error = nil;
+    if (![self generateRepositories:&error] || ![self startServers:&error]) {
+        fprintf(stderr, "cpm bench: %s\n", (error.localizedFailureReason ?: error.localizedDescription).UTF8String);
+        return NO;
+    }
+
+    // a cold run starts without databases, snapshots or validators
+    [self removeLocalStorage];
+    BOOL succeeded = [self reloadWithLabel:@"cold"];
+
+    for (NSInteger run = 1; run <= [self.defaults integerForKey:@"warmRuns"]; run++) {
+        succeeded &= [self reloadWithLabel:[NSString stringWithFormat:@"warm%ld", (long)run]];
+    }
+
+    [self removeLocalStorage];
+    return succeeded;
+}
+
+- (BOOL)reloadWithLabel:(NSString *)label {
+    NSTimeInterval start = [NSProcessInfo processInfo].systemUptime;
+
+    // a new aggregate every run, like a fresh launch of the app
+    NSArray *urls = [self.servers valueForKey:@"baseURL"];
+    CPMDpkgRepositoryAggregate *aggregate = [[CPMDpkgRepositoryAggregate alloc] initWithRepositoryURLs:urls];
+    NSUInteger failures = [self reloadAggregate:aggregate];
+
+    NSTimeInterval elapsed = [NSProcessInfo processInfo].systemUptime - start;
+    double rows = 0, bytes = 0;
+    for (CPMRefreshMetrics *refresh in aggregate.refreshMetrics) {
+        NSDictionary *counters = refresh.counters;
+        rows += [counters[@"rows_written"] doubleValue];
+        bytes += [counters[@"bytes_downloaded"] doubleValue];
+    }
+
+    printf("%-6s %8.3fs %10.0f rows %10.0f rows/s %10.1f MB downloaded   peak RSS %.1f MB%s\n",
+           label.UTF8String, elapsed, rows, rows / MAX(elapsed, 0.001), bytes / (1024 * 1024), CPMBenchmarkPeakResidentMegabytes(),
+           failures ? " (failed)" : "");
+
+    NSString *trace = [self.defaults stringForKey:@"trace"];
+    if (trace.length) {
+        NSString *path = [[trace.stringByDeletingPathExtension stringByAppendingFormat:@"-%@", label] stringByAppendingPathExtension:trace.pathExtension.length ? trace.pathExtension : @"json"];
+        NSError *error = nil;
+        if (![aggregate writeRefreshTraceToURL:[NSURL fileURLWithPath:path] error:&error])
+            fprintf(stderr, "could not write %s: %s\n", path.UTF8String, error.localizedDescription.UTF8String);
+    }
+
+    return failures == 0;
+}
+
+@end
@@ -0,0 +1,48 @@
+//
+//  CPMBenchmarkRepository.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+typedef NS_ENUM(NSUInteger, CPMBenchmarkLayout) {
+    // Release and Packages at the root
+    CPMBenchmarkLayoutFlat,
+    // dists/stable/Release, with the packages under main/binary-iphoneos-arm
+    CPMBenchmarkLayoutDists
+};
+
+// A synthetic repository. The same settings and seed always give the same
+// files, so runs on different machines or commits can be compared.
+@interface CPMBenchmarkRepository : NSObject
+@property (assign) CPMBenchmarkLayout layout;
+@property (assign) NSUInteger packageCount;
+// Length of every description, which is most of a stanza
+@property (assign) NSUInteger fieldSize;
+// Extensions of the Packages variants listed in the Release file: "xz", "lzma",
+// "bz2", "lz", "gz", or "" for the uncompressed one. Everything but gz and bz2
+// needs the xz or lzip tool in the PATH.
+@property (copy) NSArray *compressions;
+@property (assign) uint64_t seed;
+// Gives the first `revision` packages a newer version, so a repository can be
+// written again as a later state of itself
+@property (assign) NSUInteger revision;
+// Also publishes Packages.diff/Index. A repository written over an earlier
+// one with a different index gets a PDiff from that index to its own; the
+// diff tool has to be in the PATH for that.
+@property (assign) BOOL publishesDiffs;
+
+// The uncompressed Packages index the repository publishes
+- (NSData *)packagesData;
+
+// Compresses data with the same tool and settings as the index variant with
+// that extension
+- (NSData *)compressData:(NSData *)data extension:(NSString *)extension error:(NSError **)error;
+
+// Writes the repository into path, which becomes its root.
+- (BOOL)writeToPath:(NSString *)path error:(NSError **)error;
+
+@end
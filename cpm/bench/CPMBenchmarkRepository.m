@@ -0,0 +1,274 @@
+//
+//  CPMBenchmarkRepository.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMBenchmarkRepository.h"
+#import "CPDefines.h"
+#import "decompress.h"
+#import <CommonCrypto/CommonDigest.h>
+
+// xorshift64*, so the contents don't depend on the platform's random()
+static uint64_t nextRandom(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+static NSString *hexString(const unsigned char *bytes, size_t length) {
+    NSMutableString *hex = [NSMutableString stringWithCapacity:length * 2];
+    for (size_t i = 0; i < length; i++) {
+        [hex appendFormat:@"%02x", bytes[i]];
+    }
+
+    return hex;
+}
+
+static NSString *md5Hex(NSData *data) {
+    unsigned char digest[CC_MD5_DIGEST_LENGTH];
+    CC_MD5(data.bytes, (CC_LONG)data.length, digest);
+    return hexString(digest, sizeof(digest));
+}
+
+static NSString *sha256Hex(NSData *data) {
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256(data.bytes, (CC_LONG)data.length, digest);
+    return hexString(digest, sizeof(digest));
+}
+
+// the compressor and its arguments for each extension; they all write to stdout
+static NSArray *compressorForExtension(NSString *extension) {
+    NSDictionary *compressors = @{ @"gz": @[ @"gzip", @"-9", @"-n", @"-c" ],
+                                   @"bz2": @[ @"bzip2", @"-9", @"-c" ],
+                                   @"xz": @[ @"xz", @"-6", @"-c" ],
+                                   @"lzma": @[ @"xz", @"--format=lzma", @"-6", @"-c" ],
+                                   @"lz": @[ @"lzip", @"-6", @"-c" ] };
+    return compressors[extension];
+}
+
+@implementation CPMBenchmarkRepository
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        self.layout = CPMBenchmarkLayoutFlat;
+        self.packageCount = 20000;
+        self.fieldSize = 200;
+        self.compressions = @[ @"xz" ];
+        self.seed = 1;
+    }
+
+    return self;
+}
+
+- (NSData *)packagesData {
+    uint64_t state = self.seed * 0x9E3779B97F4A7C15ULL ?: 1;
+    static const char *words[] = { "tweak", "theme", "package", "springboard", "settings", "library", "utility", "support",
+                                   "widget", "keyboard", "status", "bar", "control", "center", "lock", "screen" };
+    const size_t wordCount = sizeof(words) / sizeof(words[0]);
+
+    NSMutableData *packages = [NSMutableData dataWithCapacity:self.packageCount * (self.fieldSize + 512)];
+    NSMutableString *description = [NSMutableString stringWithCapacity:self.fieldSize + 16];
+    for (NSUInteger i = 0; i < self.packageCount; i++) {
+        uint64_t r = nextRandom(&state);
+
+        [description setString:@""];
+        while (description.length < self.fieldSize) {
+            [description appendFormat:@"%s ", words[nextRandom(&state) % wordCount]];
+        }
+        if (description.length > self.fieldSize)
+            [description deleteCharactersInRange:NSMakeRange(self.fieldSize, description.length - self.fieldSize)];
+
+        NSString *identifier = [NSString stringWithFormat:@"com.bench.package%05lu", (unsigned long)i];
+        NSString *version = [NSString stringWithFormat:@"%u.%u-%u", (unsigned)(r % 5), (unsigned)(r >> 8) % 40, (unsigned)(r >> 16) % 9 + 1];
+        if (i < self.revision)
+            version = [version stringByAppendingFormat:@"+r%lu", (unsigned long)self.revision];
+        unsigned char fake[CC_SHA256_DIGEST_LENGTH];
+        for (size_t j = 0; j < sizeof(fake); j++) {
+            fake[j] = (unsigned char)nextRandom(&state);
+        }
+
+        NSMutableString *stanza = [NSMutableString stringWithCapacity:self.fieldSize + 512];
+        [stanza appendFormat:@"Package: %@\n", identifier];
+        [stanza appendFormat:@"Version: %@\n", version];
+        [stanza appendString:@"Architecture: iphoneos-arm\n"];
+        [stanza appendFormat:@"Name: Package %lu\n", (unsigned long)i];
+        [stanza appendFormat:@"Section: Section %u\n", (unsigned)((r >> 24) % 24)];
+        [stanza appendString:@"Maintainer: Benchmark <bench@example.com>\n"];
+        [stanza appendFormat:@"Installed-Size: %u\n", (unsigned)((r >> 32) % 4096) + 1];
+        // a short chain of dependencies, like the tweaks that need a common library
+        if (i > 0 && i % 3)
+            [stanza appendFormat:@"Depends: com.bench.package%05lu (>= 0.0), mobilesubstrate\n", (unsigned long)(i - 1)];
+        [stanza appendFormat:@"Filename: debs/%@_%@_iphoneos-arm.deb\n", identifier, version];
+        [stanza appendFormat:@"Size: %u\n", (unsigned)((r >> 40) % 1048576) + 1024];
+        [stanza appendFormat:@"MD5sum: %@\n", hexString(fake, CC_MD5_DIGEST_LENGTH)];
+        [stanza appendFormat:@"SHA256: %@\n", hexString(fake, sizeof(fake))];
+        [stanza appendFormat:@"Description: %@\n\n", description];
+
+        [packages appendData:[stanza dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+
+    return packages;
+}
+
+// Runs the tool with its output going to the file; the exit statuses in
+// `succeeded` count as success
+- (BOOL)runTool:(NSArray *)arguments output:(NSString *)output succeeded:(NSIndexSet *)succeeded error:(NSError **)error {
+    NSTask *task = [[NSTask alloc] init];
+    task.launchPath = @"/usr/bin/env";
+    task.arguments = arguments;
+    task.standardOutput = [NSFileHandle fileHandleForWritingAtPath:output];
+
+    @try {
+        [task launch];
+        [task waitUntilExit];
+    } @catch (NSException *exception) {
+        // couldn't even start env
+    }
+
+    if (task.isRunning || ![succeeded containsIndex:task.terminationStatus]) {
+        if (error) {
+            *error = [NSError errorWithDomain:CPMERRORDOMAIN
+                                         code:CPMErrorInvalidFormat
+                                     userInfo:@{ NSLocalizedFailureReasonErrorKey: [NSString stringWithFormat:@"%@ failed; is it installed?", arguments[0]] }];
+        }
+        return NO;
+    }
+
+    return YES;
+}
+
+- (BOOL)compressFileAtPath:(NSString *)path extension:(NSString *)extension error:(NSError **)error {
+    NSArray *compressor = compressorForExtension(extension);
+    NSString *output = [path stringByAppendingPathExtension:extension];
+    if (!compressor || ![[NSFileManager defaultManager] createFileAtPath:output contents:nil attributes:nil]) {
+        if (error) {
+            *error = [NSError errorWithDomain:CPMERRORDOMAIN
+                                         code:CPMErrorInvalidFormat
+                                     userInfo:@{ NSLocalizedFailureReasonErrorKey: [NSString stringWithFormat:@"Cannot write a .%@ index", extension] }];
+        }
+        return NO;
+    }
+
+    return [self runTool:[compressor arrayByAddingObject:path] output:output succeeded:[NSIndexSet indexSetWithIndex:0] error:error];
+}
+
+- (NSData *)compressData:(NSData *)data extension:(NSString *)extension error:(NSError **)error {
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[@"cpm-bench-" stringByAppendingString:[NSUUID UUID].UUIDString]];
+    NSData *compressed = nil;
+    if ([data writeToFile:path options:0 error:error] && [self compressFileAtPath:path extension:extension error:error])
+        compressed = [NSData dataWithContentsOfFile:[path stringByAppendingPathExtension:extension] options:0 error:error];
+
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    [[NSFileManager defaultManager] removeItemAtPath:[path stringByAppendingPathExtension:extension] error:nil];
+    return compressed;
+}
+
+// The uncompressed index a previous write left at packagesPath, if any
+- (NSData *)publishedPackagesAtPath:(NSString *)packagesPath {
+    for (NSString *extension in @[ @"", @"gz", @"bz2", @"xz", @"lzma", @"lz" ]) {
+        NSData *data = [NSData dataWithContentsOfFile:extension.length ? [packagesPath stringByAppendingPathExtension:extension] : packagesPath];
+        if (data)
+            return extension.length ? decompressData(data) : data;
+    }
+
+    return nil;
+}
+
+// Packages.diff/Index next to packagesPath, with a single patch from the
+// previous index to the new one if there was a previous one
+- (BOOL)writeDiffsFrom:(NSData *)previous to:(NSData *)packages atPath:(NSString *)packagesPath error:(NSError **)error {
+    NSFileManager *manager = [NSFileManager defaultManager];
+    NSString *diffs = [packagesPath.stringByDeletingLastPathComponent stringByAppendingPathComponent:@"Packages.diff"];
+    [manager removeItemAtPath:diffs error:nil];
+    if (![manager createDirectoryAtPath:diffs withIntermediateDirectories:YES attributes:nil error:error])
+        return NO;
+
+    NSMutableString *index = [NSMutableString stringWithFormat:@"SHA256-Current: %@ %lu\n", sha256Hex(packages), (unsigned long)packages.length];
+    if (previous && ![previous isEqualToData:packages]) {
+        NSString *name = [NSString stringWithFormat:@"revision%lu", (unsigned long)self.revision];
+        NSString *old = [diffs stringByAppendingPathComponent:@"previous"];
+        NSString *current = [diffs stringByAppendingPathComponent:@"current"];
+        NSString *patchPath = [diffs stringByAppendingPathComponent:name];
+        if (![previous writeToFile:old options:0 error:error] || ![packages writeToFile:current options:0 error:error] ||
+            ![manager createFileAtPath:patchPath contents:nil attributes:nil])
+            return NO;
+
+        // diff exits with 1 when the files differ, which they do
+        BOOL diffed = [self runTool:@[ @"diff", @"--ed", old, current ] output:patchPath succeeded:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, 2)] error:error];
+        [manager removeItemAtPath:old error:nil];
+        [manager removeItemAtPath:current error:nil];
+        if (!diffed || ![self compressFileAtPath:patchPath extension:@"gz" error:error])
+            return NO;
+
+        NSData *patch = [NSData dataWithContentsOfFile:patchPath];
+        [manager removeItemAtPath:patchPath error:nil];
+        [index appendFormat:@"SHA256-History:\n %@ %lu %@\n", sha256Hex(previous), (unsigned long)previous.length, name];
+        [index appendFormat:@"SHA256-Patches:\n %@ %lu %@\n", sha256Hex(patch), (unsigned long)patch.length, name];
+    }
+
+    return [index writeToFile:[diffs stringByAppendingPathComponent:@"Index"] atomically:YES encoding:NSUTF8StringEncoding error:error];
+}
+
+- (BOOL)writeToPath:(NSString *)path error:(NSError **)error {
+    NSFileManager *manager = [NSFileManager defaultManager];
+    NSString *releaseDirectory = self.layout == CPMBenchmarkLayoutDists ? [path stringByAppendingPathComponent:@"dists/stable"] : path;
+    // the Packages path as the Release file lists it
+    NSString *indexPath = self.layout == CPMBenchmarkLayoutDists ? @"main/binary-iphoneos-arm/Packages" : @"Packages";
+    NSString *packagesPath = [releaseDirectory stringByAppendingPathComponent:indexPath];
+
+    if (![manager createDirectoryAtPath:packagesPath.stringByDeletingLastPathComponent withIntermediateDirectories:YES attributes:nil error:error])
+        return NO;
+
+    NSData *packages = self.packagesData;
+    if (self.publishesDiffs && ![self writeDiffsFrom:[self publishedPackagesAtPath:packagesPath] to:packages atPath:packagesPath error:error])
+        return NO;
+
+    if (![packages writeToFile:packagesPath options:0 error:error])
+        return NO;
+
+    NSMutableString *md5 = [NSMutableString string];
+    NSMutableString *sha256 = [NSMutableString string];
+    for (NSString *extension in self.compressions) {
+        NSData *data = packages;
+        if (extension.length) {
+            if (![self compressFileAtPath:packagesPath extension:extension error:error])
+                return NO;
+            data = [NSData dataWithContentsOfFile:[packagesPath stringByAppendingPathExtension:extension]];
+        }
+
+        NSString *listed = extension.length ? [indexPath stringByAppendingPathExtension:extension] : indexPath;
+        [md5 appendFormat:@" %@ %lu %@\n", md5Hex(data), (unsigned long)data.length, listed];
+        [sha256 appendFormat:@" %@ %lu %@\n", sha256Hex(data), (unsigned long)data.length, listed];
+    }
+
+    if (self.publishesDiffs) {
+        NSString *listed = [indexPath.stringByDeletingLastPathComponent stringByAppendingPathComponent:@"Packages.diff/Index"];
+        NSData *data = [NSData dataWithContentsOfFile:[releaseDirectory stringByAppendingPathComponent:listed]];
+        [md5 appendFormat:@" %@ %lu %@\n", md5Hex(data), (unsigned long)data.length, listed];
+        [sha256 appendFormat:@" %@ %lu %@\n", sha256Hex(data), (unsigned long)data.length, listed];
+    }
+
+    // only what the Release file lists is served
+    if (![self.compressions containsObject:@""])
+        [manager removeItemAtPath:packagesPath error:nil];
+
+    NSMutableString *release = [NSMutableString string];
+    [release appendString:@"Origin: Benchmark\n"];
+    [release appendFormat:@"Label: Benchmark %llu\n", (unsigned long long)self.seed];
+    [release appendString:@"Suite: stable\n"];
+    [release appendString:@"Version: 1.0\n"];
+    [release appendString:@"Codename: bench\n"];
+    [release appendString:@"Architectures: iphoneos-arm\n"];
+    [release appendString:@"Components: main\n"];
+    [release appendFormat:@"Description: %lu synthetic packages\n", (unsigned long)self.packageCount];
+    [release appendFormat:@"MD5Sum:\n%@", md5];
+    [release appendFormat:@"SHA256:\n%@", sha256];
+
+    return [release writeToFile:[releaseDirectory stringByAppendingPathComponent:@"Release"] atomically:YES encoding:NSUTF8StringEncoding error:error];
+}
+
+@end
@@ -0,0 +1,39 @@
+//
+//  CPMBenchmarkServer.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+// Serves a directory over HTTP on the loopback interface, standing in for a
+// mirror. GET and HEAD only, one request per connection. Answers
+// If-None-Match with 304 and an open-ended Range with 206 like a real mirror
+// does, so warm refreshes and resumed downloads take the same path they
+// would in the field.
+@interface CPMBenchmarkServer : NSObject
+@property (readonly, copy) NSString *rootPath;
+// http://127.0.0.1:<port>/ once started
+@property (readonly, strong) NSURL *baseURL;
+
+// Waited before every response, like a round trip to a distant mirror
+@property (assign) NSTimeInterval latency;
+// Per connection; 0 sends as fast as the loopback allows
+@property (assign) NSUInteger bytesPerSecond;
+// If set, a whole body is cut off after this many bytes, the way a dropped
+// connection leaves it. Ranges are always sent in full.
+@property (assign) NSUInteger interruptsAfterBytes;
+
+// "<status> <path>" of every request answered since the last reset, in order
+@property (readonly, copy) NSArray *requests;
+- (void)resetRequests;
+
+- (instancetype)initWithRootPath:(NSString *)path;
+
+// Listens on a free port. Returns NO with a POSIX error if it can't.
+- (BOOL)start:(NSError **)error;
+- (void)stop;
+
+@end
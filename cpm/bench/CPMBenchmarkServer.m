@@ -0,0 +1,242 @@
+//
+//  CPMBenchmarkServer.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMBenchmarkServer.h"
+#import <arpa/inet.h>
+#import <fcntl.h>
+#import <netinet/in.h>
+#import <sys/socket.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+// longest request head that is read
+#define CPMBenchmarkServerHeadLimit (16 * 1024)
+
+// a throttled body goes out in this many pieces a second
+#define CPMBenchmarkServerSlicesPerSecond 20
+
+static BOOL sendAll(int fd, const void *bytes, size_t length) {
+    while (length > 0) {
+        ssize_t sent = write(fd, bytes, length);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return NO;
+
+        bytes = (const char *)bytes + sent;
+        length -= sent;
+    }
+
+    return YES;
+}
+
+static NSString *headerValue(NSArray *lines, NSString *name) {
+    NSString *prefix = [name.lowercaseString stringByAppendingString:@":"];
+    for (NSString *line in lines) {
+        if ([line.lowercaseString hasPrefix:prefix])
+            return [[line substringFromIndex:prefix.length] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+    }
+
+    return nil;
+}
+
+@interface CPMBenchmarkServer ()
+@property (readwrite, copy) NSString *rootPath;
+@property (readwrite, strong) NSURL *baseURL;
+@property (strong) dispatch_source_t listener;
+@property (strong) NSMutableArray *requestLog;
+- (void)serveConnection:(int)fd;
+@end
+
+@implementation CPMBenchmarkServer
+
+- (instancetype)initWithRootPath:(NSString *)path {
+    if ((self = [self init])) {
+        self.rootPath = path.stringByStandardizingPath;
+        self.requestLog = [NSMutableArray array];
+    }
+
+    return self;
+}
+
+- (void)dealloc {
+    [self stop];
+}
+
+- (BOOL)start:(NSError **)error {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int yes = 1;
+    struct sockaddr_in address = { 0 };
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+
+    if (fd < 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) != 0 ||
+        bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(fd, 64) != 0 ||
+        getsockname(fd, (struct sockaddr *)&address, &length) != 0 ||
+        fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+        if (error)
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        if (fd >= 0)
+            close(fd);
+        return NO;
+    }
+
+    self.baseURL = [NSURL URLWithString:[NSString stringWithFormat:@"http://127.0.0.1:%u/", ntohs(address.sin_port)]];
+
+    __weak CPMBenchmarkServer *weakSelf = self;
+    dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    self.listener = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, fd, 0, queue);
+    dispatch_source_set_event_handler(self.listener, ^{
+        int client;
+        while ((client = accept(fd, NULL, NULL)) >= 0) {
+            // every connection gets a thread of its own, so one slow body doesn't hold up the rest
+            dispatch_async(queue, ^{
+                CPMBenchmarkServer *server = weakSelf;
+                if (server)
+                    [server serveConnection:client];
+                else
+                    close(client);
+            });
+        }
+    });
+    dispatch_source_set_cancel_handler(self.listener, ^{
+        close(fd);
+    });
+    dispatch_resume(self.listener);
+
+    return YES;
+}
+
+- (void)stop {
+    if (self.listener) {
+        dispatch_source_cancel(self.listener);
+        self.listener = nil;
+    }
+}
+
+- (NSArray *)requests {
+    @synchronized (self.requestLog) {
+        return [self.requestLog copy];
+    }
+}
+
+- (void)resetRequests {
+    @synchronized (self.requestLog) {
+        [self.requestLog removeAllObjects];
+    }
+}
+
+- (void)serveConnection:(int)fd {
+    int flags = fcntl(fd, F_GETFL);
+    fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+#endif
+
+    NSMutableData *head = [NSMutableData data];
+    char buffer[4096];
+    while (head.length < CPMBenchmarkServerHeadLimit) {
+        ssize_t received = read(fd, buffer, sizeof(buffer));
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            break;
+
+        [head appendBytes:buffer length:received];
+        if ([head rangeOfData:[NSData dataWithBytes:"\r\n\r\n" length:4] options:0 range:NSMakeRange(0, head.length)].location != NSNotFound)
+            break;
+    }
+
+    NSString *request = [[NSString alloc] initWithData:head encoding:NSISOLatin1StringEncoding];
+    NSArray *lines = [request componentsSeparatedByString:@"\r\n"];
+    NSArray *words = [lines.firstObject componentsSeparatedByString:@" "];
+
+    NSString *method = words.count == 3 ? words[0] : nil;
+    NSString *target = words.count == 3 ? [[words[1] componentsSeparatedByString:@"?"][0] stringByRemovingPercentEncoding] : nil;
+    NSString *path = [self.rootPath stringByAppendingPathComponent:target ?: @""].stringByStandardizingPath;
+
+    int status = 200;
+    struct stat info = { 0 };
+    if (!([method isEqualToString:@"GET"] || [method isEqualToString:@"HEAD"])) {
+        status = 405;
+    } else if (![path hasPrefix:[self.rootPath stringByAppendingString:@"/"]] ||
+               stat(path.fileSystemRepresentation, &info) != 0 || !S_ISREG(info.st_mode)) {
+        status = 404;
+    }
+
+    // files are replaced rather than rewritten, so the inode tells versions apart within a second
+    NSString *etag = status == 200 ? [NSString stringWithFormat:@"\"%llx-%llx-%llx\"", (unsigned long long)info.st_size, (unsigned long long)info.st_mtime, (unsigned long long)info.st_ino] : nil;
+    if (etag && [headerValue(lines, @"If-None-Match") isEqualToString:etag])
+        status = 304;
+
+    NSData *body = status == 200 ? [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:nil] : nil;
+    if (status == 200 && !body)
+        status = 404;
+
+    // only the "bytes=<first>-" form a resumed download sends
+    NSString *range = status == 200 ? headerValue(lines, @"Range") : nil;
+    NSUInteger first = 0;
+    NSUInteger length = body.length;
+    if ([range hasPrefix:@"bytes="] && [range hasSuffix:@"-"]) {
+        first = (NSUInteger)[range substringWithRange:NSMakeRange(6, range.length - 7)].longLongValue;
+        status = first < body.length ? 206 : 416;
+        length = first < body.length ? body.length - first : 0;
+    }
+
+    NSUInteger interruption = status == 200 ? self.interruptsAfterBytes : 0;
+
+    @synchronized (self.requestLog) {
+        [self.requestLog addObject:[NSString stringWithFormat:@"%d %@", status, target ?: @""]];
+    }
+
+    if (self.latency > 0)
+        usleep((useconds_t)(self.latency * 1000000));
+
+    NSString *reason = @{ @200: @"OK", @206: @"Partial Content", @304: @"Not Modified", @404: @"Not Found", @405: @"Method Not Allowed", @416: @"Range Not Satisfiable" }[@(status)];
+    NSMutableString *response = [NSMutableString stringWithFormat:@"HTTP/1.1 %d %@\r\n", status, reason];
+    [response appendFormat:@"Content-Length: %lu\r\n", (unsigned long)(status == 200 || status == 206 ? length : 0)];
+    if (status == 206)
+        [response appendFormat:@"Content-Range: bytes %lu-%lu/%lu\r\n", (unsigned long)first, (unsigned long)body.length - 1, (unsigned long)body.length];
+    else if (status == 416)
+        [response appendFormat:@"Content-Range: bytes */%lu\r\n", (unsigned long)body.length];
+    if (etag)
+        [response appendFormat:@"ETag: %@\r\n", etag];
+    [response appendString:@"Content-Type: application/octet-stream\r\nConnection: close\r\n\r\n"];
+
+    NSData *responseHead = [response dataUsingEncoding:NSISOLatin1StringEncoding];
+    BOOL sending = sendAll(fd, responseHead.bytes, responseHead.length);
+
+    if (sending && (status == 200 || status == 206) && [method isEqualToString:@"GET"]) {
+        NSUInteger end = interruption ? MIN(interruption, length) : length;
+        NSUInteger rate = self.bytesPerSecond;
+        NSUInteger slice = rate ? MAX(rate / CPMBenchmarkServerSlicesPerSecond, 1024) : MAX(end, 1);
+        NSTimeInterval start = [NSProcessInfo processInfo].systemUptime;
+
+        for (NSUInteger offset = 0; sending && offset < end; offset += slice) {
+            NSUInteger sent = MIN(slice, end - offset);
+            sending = sendAll(fd, (const char *)body.bytes + first + offset, sent);
+
+            // hold back until the average rate is down to the limit again
+            if (rate) {
+                NSTimeInterval due = start + (double)(offset + sent) / rate;
+                NSTimeInterval now = [NSProcessInfo processInfo].systemUptime;
+                if (due > now)
+                    usleep((useconds_t)((due - now) * 1000000));
+            }
+        }
+    }
+
+    shutdown(fd, SHUT_WR);
+    close(fd);
+}
+
+@end
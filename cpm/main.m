@@ -10,10 +10,16 @@
 #include <bzlib.h>
 #include <zlib.h>
 #import "CPMDpkgRepositoryAggregate.h"
+#import "CPMBenchmark.h"
 
 //https://wiki.debian.org/RepositoryFormat#Types_of_files
 int main(int argc, const char * argv[]) {
     @autoreleasepool {
+        // cpm bench [-packages n ...], see CPMBenchmark.h
+        if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+            return [[[CPMBenchmark alloc] initWithDefaults:[NSUserDefaults standardUserDefaults]] run];
+        }
+        
         NSArray *sources = @[
                              [NSURL URLWithString:@"http://repo.alexzielenski.com"],
                              [NSURL URLWithString:@"http://apt.thebigboss.org/repofiles/cydia"],
@@ -23,8 +29,8 @@ int main(int argc, const char * argv[]) {
         
         
         CPMDpkgRepositoryAggregate *aggregate = [[CPMDpkgRepositoryAggregate alloc] initWithRepositoryURLs:sources];
-        [aggregate reloadDataWithCompletion:^(CPMRepository *finished, NSError *error, BOOL allFinished) {
-            NSLog(@"Finished Loading: %@ with error: %@", finished.url, error);
+        [aggregate reloadDataWithCompletion:^(CPMRepository *finished, CPMPackageChanges *changes, NSError *error, BOOL allFinished) {
+            NSLog(@"Finished Loading: %@ with changes: %@ error: %@", finished.url, changes, error);
             if (allFinished) {
                 NSLog(@"done loading all repos");
                 
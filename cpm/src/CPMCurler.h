@@ -14,6 +14,28 @@
 @property (readonly, copy) NSError *error;
 @property (readonly, strong) NSData *data;
 
+// Extra header fields to send, e.g. If-None-Match for a conditional request
+// or Range to resume a download. 304 and 206 answers complete without an
+// error; check response.statusCode.
+@property (copy) NSDictionary *requestHeaders;
+@property (readonly, strong) NSHTTPURLResponse *response;
+
+// When NO, received bytes are only handed to the dataBlock and `data` stays empty.
+// Defaults to YES.
+@property (assign) BOOL accumulatesData;
+
+// Serial queue the connection delivers its callbacks on. When nil the curler
+// makes its own when it starts.
+@property (strong) NSOperationQueue *delegateQueue;
+
+// When the connection started, when the response headers arrived and when the
+// curler completed, on the NSProcessInfo systemUptime clock; 0 until reached.
+// NSURLConnection doesn't break the wait for a response down any further.
+@property (readonly, assign) NSTimeInterval startTime;
+@property (readonly, assign) NSTimeInterval responseTime;
+@property (readonly, assign) NSTimeInterval finishTime;
+@property (readonly, assign) NSInteger bytesReceived;
+
 - (id)initWithURL:(NSURL *)url dataBlock:(void (^)(NSInteger bytesDownloaded, NSInteger bytesExpected, NSData *data))dataBlock completionBlock:(void (^)(void))completion;
 
 @end
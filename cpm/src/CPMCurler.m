@@ -12,12 +12,19 @@
 @interface CPMCurler () <NSURLConnectionDelegate, NSURLConnectionDataDelegate> {
     BOOL _executing;
     BOOL _finished;
+    BOOL _completed;
 }
 @property (strong) NSURLConnection *connection;
 @property (readwrite, copy) NSError *error;
 @property (assign) NSInteger expectedLength;
 @property (assign) NSInteger currentLength;
 @property (readwrite, strong) NSData *data;
+@property (readwrite, strong) NSHTTPURLResponse *response;
+@property (readwrite, assign) NSTimeInterval startTime;
+@property (readwrite, assign) NSTimeInterval responseTime;
+@property (readwrite, assign) NSTimeInterval finishTime;
+- (NSURLRequest *)request;
+- (void)complete;
 @end
 
 @implementation CPMCurler
@@ -37,72 +44,124 @@
     if ((self = [super init])) {
         self.expectedLength = 0;
         self.currentLength = 0;
+        self.accumulatesData = YES;
     }
     
     return self;
 }
 
+- (NSURLRequest *)request {
+    // validators are handled by the caller through requestHeaders, so never let
+    // the URL cache answer for the server
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.url
+                                                           cachePolicy:NSURLRequestReloadIgnoringLocalCacheData
+                                                       timeoutInterval:5];
+    [self.requestHeaders enumerateKeysAndObjectsUsingBlock:^(NSString *field, NSString *value, BOOL *stop) {
+        [request setValue:value forHTTPHeaderField:field];
+    }];
+    
+    return request;
+}
+
 - (void)start {
-    dispatch_sync(dispatch_get_main_queue(), ^{
-        self.connection = [[NSURLConnection alloc] initWithRequest:[NSURLRequest requestWithURL:self.url
-                                                                                    cachePolicy:NSURLRequestReloadIgnoringLocalAndRemoteCacheData timeoutInterval:5]
-                                                          delegate:self];
-        [self.connection scheduleInRunLoop:[NSRunLoop currentRunLoop] forMode:NSRunLoopCommonModes];
-        [self.connection start];
-    });
+    if (self.isCancelled) {
+        [self complete];
+        return;
+    }
+    
+    self.executing = YES;
+    self.startTime = [NSProcessInfo processInfo].systemUptime;
+    
+    // callbacks never go through the main run loop; without a queue from the
+    // caller every curler gets its own serial one
+    if (!self.delegateQueue) {
+        self.delegateQueue = [[NSOperationQueue alloc] init];
+        self.delegateQueue.maxConcurrentOperationCount = 1;
+    }
+    
+    self.connection = [[NSURLConnection alloc] initWithRequest:self.request
+                                                      delegate:self
+                                              startImmediately:NO];
+    [self.connection setDelegateQueue:self.delegateQueue];
+    [self.connection start];
 }
 
 - (void)cancel {
-    dispatch_sync(dispatch_get_main_queue(), ^{
-        [self.connection cancel];
-    });
-    
+    [self.connection cancel];
     [super cancel];
+    
+    // a cancelled connection sends no more callbacks, so finish here
+    if (self.isExecuting) {
+        [self.delegateQueue addOperationWithBlock:^{
+            [self complete];
+        }];
+    }
+}
+
+// NSOperation may or may not run the completion block by itself once we're
+// finished, so take it out first and make sure it runs exactly once
+- (void)complete {
+    void (^completion)(void) = nil;
+    @synchronized (self) {
+        if (_completed)
+            return;
+        
+        _completed = YES;
+        completion = self.completionBlock;
+        self.completionBlock = nil;
+    }
+    
+    self.finishTime = [NSProcessInfo processInfo].systemUptime;
+    self.executing = NO;
+    self.finished = YES;
+    
+    if (completion)
+        completion();
 }
 
 #pragma mark - NSConnectionDelegate
 
 - (void)connection:(NSURLConnection *)connection didFailWithError:(NSError *)error {
     self.error = error;
-    self.executing = NO;
-    self.finished = YES;
-    
-    self.completionBlock();
+    [self complete];
 }
 
 - (void)connection:(NSURLConnection *)connection didReceiveResponse:(NSHTTPURLResponse *)response {
+    self.responseTime = [NSProcessInfo processInfo].systemUptime;
     self.expectedLength = response.expectedContentLength;
-    if (response.statusCode != 200) {
+    self.response = response;
+    
+    // 304 and 206 are only ever the answers to a conditional or Range request
+    // we were asked to make
+    if (response.statusCode != 200 && response.statusCode != 304 && response.statusCode != 206) {
         self.error = [NSError errorWithDomain:CPMERRORDOMAIN
                                          code:CPMErrorUnacceptableStatusCode
                                      userInfo:@{NSLocalizedFailureReasonErrorKey: @"Bad Status Code",
                                                 CPMErrorStatusCodeKey: @(response.statusCode)}];
         [self.connection cancel];
         self.connection = nil;
-        self.executing = NO;
-        self.finished = YES;
-
-        //!TODO: figure out why this isnt called automatically
-        self.completionBlock();
+        [self complete];
     }
 }
 
 - (void)connectionDidFinishLoading:(NSURLConnection *)connection {
-    self.executing = NO;
-    self.finished = YES;
-    
-    self.completionBlock();
+    [self complete];
 }
 
 - (void)connection:(NSURLConnection *)connection didReceiveData:(NSData *)data {
     self.currentLength += data.length;
-    [(NSMutableData *)self.data appendData:data];
+    if (self.accumulatesData)
+        [(NSMutableData *)self.data appendData:data];
     if (self.dataBlock)
         self.dataBlock(self.currentLength, self.expectedLength, data);
 }
 
 #pragma mark - NSOperation Properties
 
+- (NSInteger)bytesReceived {
+    return self.currentLength;
+}
+
 - (BOOL)isAsynchronous {
     return YES;
 }
@@ -116,15 +175,15 @@
 }
 
 - (void)setExecuting:(BOOL)executing {
-    [self willChangeValueForKey:@"executing"];
+    [self willChangeValueForKey:@"isExecuting"];
     _executing = executing;
-    [self didChangeValueForKey:@"executing"];
+    [self didChangeValueForKey:@"isExecuting"];
 }
 
 - (void)setFinished:(BOOL)finished {
-    [self willChangeValueForKey:@"finished"];
+    [self willChangeValueForKey:@"isFinished"];
     _finished = finished;
-    [self didChangeValueForKey:@"finished"];
+    [self didChangeValueForKey:@"isFinished"];
 }
 
 - (BOOL)isExecuting {
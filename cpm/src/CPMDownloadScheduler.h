@@ -0,0 +1,37 @@
+//
+//  CPMDownloadScheduler.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class CPMCurler;
+
+// Every download of a refresh goes through one scheduler so that refreshing
+// many repositories stays bounded: at most maxConcurrentDownloads curlers run
+// at once, and at most maxConnectionsPerHost of them talk to the same host,
+// which keeps each host on a few persistent connections instead of opening a
+// new one per file. CPU-bound work that never waits on anything else runs on
+// workerQueue, which is sized to the number of cores.
+@interface CPMDownloadScheduler : NSObject
++ (instancetype)sharedScheduler;
+
+// Defaults to 8
+@property (nonatomic, assign) NSUInteger maxConcurrentDownloads;
+// Defaults to 2
+@property (assign) NSUInteger maxConnectionsPerHost;
+
+@property (readonly, strong) NSOperationQueue *workerQueue;
+// Unbounded, for work that blocks on downloads, such as an ingest waiting on
+// the streams it consumes. On workerQueue, enough of those would hold every
+// worker while what they wait for sits queued behind them.
+@property (readonly, strong) NSOperationQueue *ingestQueue;
+
+// Queues the curler behind the others for its host. Its completionBlock has
+// to be set before it is added.
+- (void)addCurler:(CPMCurler *)curler;
+
+@end
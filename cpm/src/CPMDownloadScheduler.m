@@ -0,0 +1,111 @@
+//
+//  CPMDownloadScheduler.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMDownloadScheduler.h"
+#import "CPMCurler.h"
+
+static NSString *hostKey(NSURL *url) {
+    return [NSString stringWithFormat:@"%@://%@:%@", url.scheme.lowercaseString, url.host.lowercaseString, url.port ?: @""];
+}
+
+@interface CPMDownloadScheduler ()
+@property (strong) NSOperationQueue *downloadQueue;
+@property (readwrite, strong) NSOperationQueue *workerQueue;
+@property (readwrite, strong) NSOperationQueue *ingestQueue;
+@property (strong) NSMutableDictionary *pendingCurlers;
+@property (strong) NSCountedSet *activeHosts;
+- (void)startNextCurlerForHost:(NSString *)host finished:(BOOL)finished;
+@end
+
+@implementation CPMDownloadScheduler
+
++ (instancetype)sharedScheduler {
+    static CPMDownloadScheduler *scheduler = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        scheduler = [[self alloc] init];
+    });
+    
+    return scheduler;
+}
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        self.downloadQueue = [[NSOperationQueue alloc] init];
+        self.downloadQueue.name = @"cpm.downloads";
+        self.maxConcurrentDownloads = 8;
+        self.maxConnectionsPerHost = 2;
+        
+        self.workerQueue = [[NSOperationQueue alloc] init];
+        self.workerQueue.name = @"cpm.workers";
+        self.workerQueue.maxConcurrentOperationCount = MAX([NSProcessInfo processInfo].activeProcessorCount, 1);
+        
+        self.ingestQueue = [[NSOperationQueue alloc] init];
+        self.ingestQueue.name = @"cpm.ingests";
+        
+        self.pendingCurlers = [NSMutableDictionary dictionary];
+        self.activeHosts = [NSCountedSet set];
+    }
+    
+    return self;
+}
+
+- (NSUInteger)maxConcurrentDownloads {
+    return self.downloadQueue.maxConcurrentOperationCount;
+}
+
+- (void)setMaxConcurrentDownloads:(NSUInteger)maxConcurrentDownloads {
+    self.downloadQueue.maxConcurrentOperationCount = MAX(maxConcurrentDownloads, 1);
+}
+
+- (void)addCurler:(CPMCurler *)curler {
+    NSString *host = hostKey(curler.url);
+    
+    // free the host's slot before the caller's completion runs, since that
+    // is usually where the next download for the same host gets queued
+    void (^completion)(void) = curler.completionBlock;
+    curler.completionBlock = ^{
+        [self startNextCurlerForHost:host finished:YES];
+        if (completion)
+            completion();
+    };
+    
+    @synchronized (self) {
+        NSMutableArray *pending = self.pendingCurlers[host];
+        if (!pending) {
+            pending = [NSMutableArray array];
+            self.pendingCurlers[host] = pending;
+        }
+        [pending addObject:curler];
+    }
+    
+    [self startNextCurlerForHost:host finished:NO];
+}
+
+- (void)startNextCurlerForHost:(NSString *)host finished:(BOOL)finished {
+    CPMCurler *next = nil;
+    @synchronized (self) {
+        if (finished)
+            [self.activeHosts removeObject:host];
+        
+        NSMutableArray *pending = self.pendingCurlers[host];
+        if (pending.count && [self.activeHosts countForObject:host] < MAX(self.maxConnectionsPerHost, 1)) {
+            next = pending[0];
+            [pending removeObjectAtIndex:0];
+            [self.activeHosts addObject:host];
+        }
+        
+        if (!pending.count)
+            [self.pendingCurlers removeObjectForKey:host];
+    }
+    
+    if (next)
+        [self.downloadQueue addOperation:next];
+}
+
+@end
@@ -0,0 +1,45 @@
+//
+//  CPMDpkgPackage.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "CPMPackage.h"
+
+@interface CPMDpkgPackage : NSObject <CPMPackage>
+
+// Takes a dictionary from CPMDpkgStatus or from a repository. Status entries
+// also set the installed version and state.
+- (instancetype)initWithDictionary:(NSDictionary *)dictionary;
+
+@property (strong, nonatomic) NSString *identifier;
+@property (strong, nonatomic) NSString *name;
+@property (strong, nonatomic) NSString *version;
+@property (strong, nonatomic) NSString *installedVersion;
+@property CPMPackageState state;
+@property (strong, nonatomic) NSString *architecture;
+@property (strong, nonatomic) NSString *maintainerName;
+@property (strong, nonatomic) NSString *maintainerEmailAddress;
+@property (strong, nonatomic) NSString *section;
+@property (strong, nonatomic) NSString *shortDescription;
+
+@property (strong, nonatomic) NSArray *depends;
+@property (strong, nonatomic) NSArray *preDepends;
+@property (strong, nonatomic) NSArray *recommends;
+@property (strong, nonatomic) NSArray *suggests;
+@property (strong, nonatomic) NSArray *enhances;
+@property (strong, nonatomic) NSArray *breaks;
+@property (strong, nonatomic) NSArray *conflicts;
+@property (strong, nonatomic) NSArray *provides;
+@property (strong, nonatomic) NSArray *replaces;
+
+@property (strong, nonatomic) NSString *authorName;
+@property (strong, nonatomic) NSString *authorEmailAddress;
+
+@property (strong, nonatomic) NSURL *websiteURL;
+@property (strong, nonatomic) NSURL *depictionURL;
+
+@end
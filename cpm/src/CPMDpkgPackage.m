@@ -0,0 +1,117 @@
+//
+//  CPMDpkgPackage.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMDpkgPackage.h"
+#import "CPMDpkgPackageManager.h"
+#import "CPMDpkgStatus.h"
+
+// "Name <email>" -> name and email
+static void splitContact(NSString *contact, NSString **name, NSString **email) {
+    NSRange open = [contact rangeOfString:@"<"];
+    NSRange close = [contact rangeOfString:@">" options:NSBackwardsSearch];
+    if (open.location == NSNotFound || close.location == NSNotFound || close.location < open.location) {
+        *name = contact;
+        *email = nil;
+        return;
+    }
+
+    *name = [[contact substringToIndex:open.location] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+    *email = [contact substringWithRange:NSMakeRange(NSMaxRange(open), close.location - NSMaxRange(open))];
+}
+
+// "a (>= 1), b | c" -> @[ @"a (>= 1)", @"b | c" ]
+static NSArray *relationships(NSString *field) {
+    if (!field.length)
+        return @[];
+
+    NSMutableArray *relations = [NSMutableArray array];
+    for (NSString *relation in [field componentsSeparatedByString:@","]) {
+        NSString *trimmed = [relation stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+        if (trimmed.length)
+            [relations addObject:trimmed];
+    }
+
+    return relations;
+}
+
+@implementation CPMDpkgPackage
+
++ (Class)packageManagerClass {
+    return CPMDpkgPackageManager.class;
+}
+
+- (instancetype)initWithDictionary:(NSDictionary *)dictionary {
+    self = [self init];
+
+    if (self) {
+        _identifier = dictionary[@"package"];
+        _name = dictionary[@"name"] ?: _identifier;
+        _version = dictionary[@"version"];
+        _architecture = dictionary[@"architecture"];
+        _section = dictionary[@"section"];
+        _shortDescription = [dictionary[@"description"] componentsSeparatedByString:@"\n"].firstObject;
+
+        NSString *name = nil, *email = nil;
+        if (dictionary[@"maintainer"]) {
+            splitContact(dictionary[@"maintainer"], &name, &email);
+            _maintainerName = name;
+            _maintainerEmailAddress = email;
+        }
+
+        if (dictionary[@"author"]) {
+            splitContact(dictionary[@"author"], &name, &email);
+            _authorName = name;
+            _authorEmailAddress = email;
+        }
+
+        _depends = relationships(dictionary[@"depends"]);
+        _preDepends = relationships(dictionary[@"pre_depends"]);
+        _recommends = relationships(dictionary[@"recommends"]);
+        _suggests = relationships(dictionary[@"suggests"]);
+        _enhances = relationships(dictionary[@"enhances"]);
+        _breaks = relationships(dictionary[@"breaks"]);
+        _conflicts = relationships(dictionary[@"conflicts"]);
+        _provides = relationships(dictionary[@"provides"]);
+        _replaces = relationships(dictionary[@"replaces"]);
+
+        _websiteURL = dictionary[@"homepage"] ? [NSURL URLWithString:dictionary[@"homepage"]] : nil;
+        _depictionURL = dictionary[@"depiction"] ? [NSURL URLWithString:dictionary[@"depiction"]] : nil;
+
+        // only status entries say how far along dpkg is
+        NSNumber *status = dictionary[@"status"];
+        if (!status) {
+            _state = CPMPackageStateNone;
+        } else {
+            switch ((CPMDpkgPackageState)status.unsignedIntegerValue) {
+                case CPMDpkgPackageStateInstalled:
+                case CPMDpkgPackageStateTriggersAwaited:
+                case CPMDpkgPackageStateTriggersPending:
+                    _state = CPMPackageStateInstalled;
+                    break;
+                case CPMDpkgPackageStateHalfInstalled:
+                case CPMDpkgPackageStateUnpacked:
+                case CPMDpkgPackageStateHalfConfigured:
+                    _state = CPMPackageStateBroken;
+                    break;
+                case CPMDpkgPackageStateConfigFiles:
+                    _state = CPMPackageStateRemoved;
+                    break;
+                default:
+                    _state = CPMPackageStateNone;
+                    break;
+            }
+
+            if (_state != CPMPackageStateNone && _state != CPMPackageStateRemoved)
+                _installedVersion = _version;
+        }
+    }
+
+    return self;
+}
+
+@end
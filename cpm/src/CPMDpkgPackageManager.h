@@ -9,6 +9,29 @@
 #import <Foundation/Foundation.h>
 #import "CPMPackageManager.h"
 
+@class CPMDpkgStatus;
+@class CPMDpkgRepositoryAggregate;
+
+// Key of the refresh progress' userInfo (and its parent's) holding the
+// CPMRefreshMetrics of every repository, updated as each one finishes.
+static NSString *const CPMDpkgPackageManagerRefreshMetricsKey = @"CPMDpkgPackageManagerRefreshMetricsKey";
+
+// Same, holding the CPMPackageChanges of every repository that has finished
+// refreshing without an error, by url.
+static NSString *const CPMDpkgPackageManagerRefreshChangesKey = @"CPMDpkgPackageManagerRefreshChangesKey";
+
 @interface CPMDpkgPackageManager : NSObject <CPMPackageManager>
 
+// dpkg's database, read natively. Uses the default admin directory unless
+// initialized with another one.
+@property (readonly, strong) CPMDpkgStatus *status;
+
+// Repositories reloaded by a refresh, one unit of its progress each. A refresh
+// without them has nothing to do. The shared aggregate of APT's sources unless
+// initialized with another admin directory. packagesForIdentifiers: takes the
+// latest version of each package from its package index.
+@property (strong) CPMDpkgRepositoryAggregate *repositoryAggregate;
+
+- (instancetype)initWithAdminDirectory:(NSString *)path;
+
 @end
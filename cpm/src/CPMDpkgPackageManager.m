@@ -7,9 +7,38 @@
 //
 
 #import "CPMDpkgPackageManager.h"
+#import "CPMDpkgPackage.h"
+#import "CPMDpkgStatus.h"
+#import "CPMDpkgRepositoryAggregate.h"
+#import "version.h"
+
+@interface CPMDpkgPackageManager ()
+@property (readwrite, strong) CPMDpkgStatus *status;
+@end
 
 @implementation CPMDpkgPackageManager
 
+- (instancetype)init {
+	self = [super init];
+	
+	if (self) {
+		_status = [CPMDpkgStatus defaultStatus];
+		_repositoryAggregate = [CPMDpkgRepositoryAggregate sharedAggregate];
+	}
+	
+	return self;
+}
+
+- (instancetype)initWithAdminDirectory:(NSString *)path {
+	self = [super init];
+	
+	if (self) {
+		_status = [[CPMDpkgStatus alloc] initWithAdminDirectory:path];
+	}
+	
+	return self;
+}
+
 - (NSString *)name {
 	return @"dpkg";
 }
@@ -19,19 +48,76 @@
 }
 
 - (NSArray *)installedPackages {
-	return nil; // TODO: implement
+	// cached until dpkg writes its status file again
+	return self.status.installedIdentifiers;
 }
 
 - (void)refreshWithParentProgress:(NSProgress *)parentProgress completion:(CPMPackageManagerRefreshCompletion)completion {
 	NSProgress *progress = [[NSProgress alloc] initWithParent:parentProgress userInfo:nil];
-	progress.totalUnitCount = 100;
+	CPMDpkgRepositoryAggregate *aggregate = self.repositoryAggregate;
+	
+	if (!aggregate.repositories.count) {
+		progress.totalUnitCount = 1;
+		progress.completedUnitCount = 1;
+		completion(nil);
+		return;
+	}
+	
+	progress.totalUnitCount = aggregate.repositories.count;
 	
-	progress.completedUnitCount = 100;
-	completion(nil); // TODO: implement
+	// the aggregate calls back on the main queue, one repository at a time
+	__block NSError *firstError = nil;
+	NSMutableDictionary *allChanges = [NSMutableDictionary dictionary];
+	[aggregate reloadDataWithCompletion:^(CPMRepository *repo, CPMPackageChanges *changes, NSError *error, BOOL allFinished) {
+		if (error && !firstError) {
+			firstError = error;
+		}
+		
+		if (changes) {
+			allChanges[repo.url] = changes;
+		}
+		
+		NSArray *metrics = aggregate.refreshMetrics;
+		[progress setUserInfoObject:metrics forKey:CPMDpkgPackageManagerRefreshMetricsKey];
+		[parentProgress setUserInfoObject:metrics forKey:CPMDpkgPackageManagerRefreshMetricsKey];
+		[progress setUserInfoObject:[allChanges copy] forKey:CPMDpkgPackageManagerRefreshChangesKey];
+		[parentProgress setUserInfoObject:[allChanges copy] forKey:CPMDpkgPackageManagerRefreshChangesKey];
+		progress.completedUnitCount++;
+		
+		if (allFinished) {
+			completion(firstError);
+		}
+	}];
 }
 
 - (void)packagesForIdentifiers:(NSArray *)identifiers completion:(CPMPackageManagerPackagesForIdentifiersCompletion)completion {
-	completion(nil, nil); // TODO: implement
+	dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+		NSError *error = nil;
+		if (![self.status reloadIfNeeded:&error]) {
+			completion(nil, error);
+			return;
+		}
+		
+		NSMutableDictionary *packages = [NSMutableDictionary dictionary];
+		
+		for (NSString *identifier in identifiers) {
+			NSDictionary *latest = [self.repositoryAggregate packageWithIdentifier:identifier];
+			
+			[self.status enumerateInstalledPackage:identifier usingBlock:^(const CPMDpkgInstalledPackage *package) {
+				packages[identifier] = [[CPMDpkgPackage alloc] initWithDictionary:[self.status dictionaryForInstalledPackage:package]];
+			}];
+			
+			CPMDpkgPackage *package = packages[identifier];
+			if (!package) {
+				if (latest)
+					packages[identifier] = [[CPMDpkgPackage alloc] initWithDictionary:latest];
+			} else if (latest && CPMVersionCompareStrings([latest[@"version"] UTF8String], package.version.UTF8String) > 0) {
+				package.version = latest[@"version"];
+			}
+		}
+		
+		completion(packages, nil);
+	});
 }
 
 - (NSProgress *)package:(id <CPMPackage>)package performOperation:(CPMPackageManagerOperation)operation stateChangeCallback:(CPMPackageManagerStateChangeCallback)stateChangeCallback {
@@ -8,21 +8,42 @@
 
 #import <Foundation/Foundation.h>
 #import "CPMRepository.h"
+#import "CPMPackageIndex.h"
+#import "CPMResolver.h"
 
 @interface CPMDpkgRepositoryAggregate : NSObject
 + (instancetype)aggregateWithRepositoryURLs:(NSArray *)urls;
 - (instancetype)initWithRepositoryURLs:(NSArray *)urls;
 
+// The repositories APT is configured with in /etc/apt, created once
++ (instancetype)sharedAggregate;
+// Repository urls of the deb lines in sources.list and sources.list.d/*.list
+// under the directory, in order and without duplicates
++ (NSArray *)repositoryURLsInSourcesDirectory:(NSString *)path;
+
 - (CPMRepository *)repositoryWithURL:(NSURL *)url;
 
 // the completion handler is called multiple times with the repository that had just finished reloading
+// and what changed about its packages (nil if it failed)
 // the allFinished flag is set to true when all have been reloaded
-- (void)reloadDataWithCompletion:(void (^)(CPMRepository *finished, NSError *error, BOOL allFinished))completion;
+- (void)reloadDataWithCompletion:(void (^)(CPMRepository *finished, CPMPackageChanges *changes, NSError *error, BOOL allFinished))completion;
+
+// The refreshMetrics of every repository that has been reloaded, by url
+- (NSArray *)refreshMetrics;
+// A Chrome trace of the last reload with a thread per repository, to see which
+// mirror or which stage of a refresh is slow
+- (BOOL)writeRefreshTraceToURL:(NSURL *)url error:(NSError **)error;
 
 - (void)installPackage:(NSString *)identifier;
 - (void)downloadPackageWithIdentifier:(NSString *)identifier dependencies:(BOOL)deps completion:(void (^)(NSURL *path, NSError *error))completion;
+// The newest version any repository has
 - (NSDictionary *)packageWithIdentifier:(NSString *)identifier;
+// What to install, in order, to get the packages and their dependencies
+- (CPMTransaction *)transactionForInstallingIdentifiers:(NSArray *)identifiers error:(NSError **)error;
 - (NSArray *)searchForPackage:(NSString *)query;
+// The best `limit` matches across all repositories, best first: exact name
+// matches, then name prefixes, then the rest, each by relevance
+- (NSArray *)searchForPackage:(NSString *)query limit:(NSUInteger)limit;
 - (NSSet *)groupNames;
 - (NSArray *)packagesInGroup:(NSString *)group;
 
@@ -31,4 +52,6 @@
 
 @interface CPMDpkgRepositoryAggregate (Properties)
 @property (readonly, strong) NSSet *repositories;
+// every package of every repository, kept current across reloads
+@property (readonly, strong) CPMPackageIndex *packageIndex;
 @end
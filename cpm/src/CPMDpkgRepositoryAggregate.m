@@ -7,9 +7,15 @@
 //
 
 #import "CPMDpkgRepositoryAggregate.h"
+#import "CPMDownloadScheduler.h"
+#import "CPMDpkgStatus.h"
+#import "CPMPackageDownloader.h"
+#import "version.h"
 
 @interface CPMDpkgRepositoryAggregate ()
 @property (readwrite, strong) NSMutableSet *repositories;
+@property (strong) NSMutableDictionary *repositoriesByURL;
+@property (readwrite, strong) CPMPackageIndex *packageIndex;
 @end
 
 @implementation CPMDpkgRepositoryAggregate
@@ -18,13 +24,65 @@
     return [[self alloc] initWithRepositoryURLs:urls];
 }
 
++ (instancetype)sharedAggregate {
+    static CPMDpkgRepositoryAggregate *aggregate = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        aggregate = [[self alloc] initWithRepositoryURLs:[self repositoryURLsInSourcesDirectory:@"/etc/apt"]];
+    });
+    
+    return aggregate;
+}
+
++ (NSArray *)repositoryURLsInSourcesDirectory:(NSString *)path {
+    NSMutableArray *files = [NSMutableArray arrayWithObject:[path stringByAppendingPathComponent:@"sources.list"]];
+    NSString *parts = [path stringByAppendingPathComponent:@"sources.list.d"];
+    NSArray *names = [[[NSFileManager defaultManager] contentsOfDirectoryAtPath:parts error:nil] sortedArrayUsingSelector:@selector(compare:)];
+    for (NSString *name in names) {
+        if ([name.pathExtension isEqualToString:@"list"])
+            [files addObject:[parts stringByAppendingPathComponent:name]];
+    }
+    
+    NSMutableOrderedSet *urls = [NSMutableOrderedSet orderedSet];
+    NSCharacterSet *whitespace = [NSCharacterSet whitespaceCharacterSet];
+    for (NSString *file in files) {
+        NSString *contents = [NSString stringWithContentsOfFile:file encoding:NSUTF8StringEncoding error:nil];
+        for (NSString *line in [contents componentsSeparatedByCharactersInSet:[NSCharacterSet newlineCharacterSet]]) {
+            NSString *source = [line componentsSeparatedByString:@"#"].firstObject;
+            NSMutableArray *fields = [[source componentsSeparatedByCharactersInSet:whitespace] mutableCopy];
+            [fields removeObject:@""];
+            if (fields.count < 2 || ![fields[0] isEqualToString:@"deb"])
+                continue;
+            
+            // deb [arch=... ] uri suite [component...]
+            NSUInteger field = 1;
+            if ([fields[field] hasPrefix:@"["]) {
+                while (field < fields.count && ![fields[field] hasSuffix:@"]"])
+                    field++;
+                field++;
+            }
+            
+            NSURL *url = field < fields.count ? [NSURL URLWithString:fields[field]] : nil;
+            if (url.scheme)
+                [urls addObject:url];
+        }
+    }
+    
+    return urls.array;
+}
+
 - (instancetype)initWithRepositoryURLs:(NSArray *)urls {
     if ((self = [self init])) {
         self.repositories = [NSMutableSet set];
+        self.repositoriesByURL = [NSMutableDictionary dictionary];
+        self.packageIndex = [[CPMPackageIndex alloc] init];
         for (NSURL *url in urls) {
             CPMRepository *repo = [CPMRepository repositoryWithURL:url];
-            if (repo)
+            if (repo) {
                 [self.repositories addObject:repo];
+                self.repositoriesByURL[url] = repo;
+                [self.packageIndex addRepository:repo];
+            }
         }
     }
     
@@ -32,24 +90,56 @@
 }
 
 - (CPMRepository *)repositoryWithURL:(NSURL *)url {
-    NSPredicate *pred = [NSPredicate predicateWithFormat:@"url == %@", url];
-    NSSet *filter = [self.repositories filteredSetUsingPredicate:pred];
-    return filter.anyObject;
+    return self.repositoriesByURL[url];
 }
 
-- (void)reloadDataWithCompletion:(void (^)(CPMRepository *repo, NSError *error, BOOL allFinished))completion {
+- (void)reloadDataWithCompletion:(void (^)(CPMRepository *repo, CPMPackageChanges *changes, NSError *error, BOOL allFinished))completion {
+    // repositories only queue their downloads here; CPMDownloadScheduler decides
+    // how many of them actually run at once
     __weak CPMDpkgRepositoryAggregate *weakSelf = self;
-    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-        __block NSUInteger finishedRepos = 0;
-        __block NSUInteger allRepos      = weakSelf.repositories.count;
-        
-        for (CPMRepository *repo in weakSelf.repositories) {
-            [repo reloadData:^(NSError *error) {
-                finishedRepos++;
-                completion(repo, error, finishedRepos == allRepos);
-            }];
-        }
-    });
+    NSSet *repositories = [self.repositories copy];
+    NSUInteger allRepos = repositories.count;
+    NSMutableSet *finishedRepos = [NSMutableSet set];
+    
+    for (CPMRepository *repo in repositories) {
+        uint64_t generation = repo.generation;
+        [repo reloadData:^(CPMPackageChanges *changes, NSError *error) {
+            // only this repository's part of the index is read again, in the background
+            // unless a lookup needs it first, and only if the refresh wrote anything
+            if (repo.generation != generation) {
+                [weakSelf.packageIndex invalidateRepository:repo];
+                [[CPMDownloadScheduler sharedScheduler].workerQueue addOperationWithBlock:^{
+                    [weakSelf.packageIndex reloadStaleRepositories];
+                }];
+            }
+            
+            BOOL allFinished = NO;
+            @synchronized (finishedRepos) {
+                [finishedRepos addObject:repo];
+                allFinished = finishedRepos.count == allRepos;
+            }
+            
+            completion(repo, changes, error, allFinished);
+        }];
+    }
+}
+
+- (NSArray *)refreshMetrics {
+    NSArray *repositories = [self.repositories.allObjects sortedArrayUsingComparator:^NSComparisonResult(CPMRepository *a, CPMRepository *b) {
+        return [a.url.absoluteString compare:b.url.absoluteString];
+    }];
+    
+    NSMutableArray *metrics = [NSMutableArray arrayWithCapacity:repositories.count];
+    for (CPMRepository *repo in repositories) {
+        if (repo.refreshMetrics)
+            [metrics addObject:repo.refreshMetrics];
+    }
+    
+    return metrics;
+}
+
+- (BOOL)writeRefreshTraceToURL:(NSURL *)url error:(NSError **)error {
+    return [CPMRefreshMetrics writeTraceForMetrics:self.refreshMetrics toURL:url error:error];
 }
 
 - (void)installPackage:(NSString *)identifier {
@@ -58,27 +148,105 @@
 }
 
 - (void)downloadPackageWithIdentifier:(NSString *)identifier dependencies:(BOOL)deps completion:(void (^)(NSURL *path, NSError *error))completion {
-    //!TODO: interface with dpkg and shrink the deps list down to dependencies which have not been installed
-    //! also, do proper version checking
+    // the transaction leaves out dependencies dpkg already has
+    NSArray *packages = nil;
+    NSError *error = nil;
+    if (deps) {
+        packages = [self transactionForInstallingIdentifiers:@[ identifier ] error:&error].installs;
+    } else {
+        NSDictionary *package = [self packageWithIdentifier:identifier];
+        if (package)
+            packages = @[ package ];
+    }
+    
+    if (!packages.count) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(nil, error);
+        });
+        return;
+    }
+    
+    // archives live relative to the repository's binary base, which needn't be its index url
+    NSMutableArray *downloads = [NSMutableArray arrayWithCapacity:packages.count];
+    for (NSDictionary *package in packages) {
+        NSMutableDictionary *download = [package mutableCopy];
+        NSURL *base = [self repositoryWithURL:package[@"repo"]].binaryBaseURL;
+        if (base && [package[@"filename"] length])
+            download[@"url"] = [base URLByAppendingPathComponent:package[@"filename"]];
+        [downloads addObject:download];
+    }
+    
+    [[CPMPackageDownloader sharedDownloader] downloadPackages:downloads progress:nil completion:^(NSDictionary *paths, NSError *error) {
+        NSString *path = paths[identifier];
+        completion(path ? [NSURL fileURLWithPath:path] : nil, error);
+    }];
 }
 
 - (NSDictionary *)packageWithIdentifier:(NSString *)identifier {
-    NSDictionary *package = nil;
+    // the index knows which repository has the newest version, so only that one is
+    // queried for the full row
+    CPMPackageIndex *index = self.packageIndex;
+    __block NSDictionary *newest = nil;
+    __block CPMPackageOrigin origin = 0;
+    [index enumerateCandidatesForIdentifier:identifier.UTF8String usingBlock:^(const CPMPackageCandidate *candidate, BOOL *stop) {
+        if (!newest || CPMVersionCompareStrings(candidate->values[CPMPackageIndexFieldVersion], [newest[@"version"] UTF8String]) > 0) {
+            newest = [index dictionaryForCandidate:candidate];
+            origin = candidate->origin;
+        }
+    }];
     
-    for (CPMRepository *repo in self.repositories) {
-        if ((package = [repo packageWithIdentifier:identifier]))
-            break;
-    }
+    if (!newest)
+        return nil;
     
-    return package;
+    // unless the repository's preferred row is another version of it
+    NSDictionary *package = [[index repositoryForOrigin:origin] packageWithIdentifier:identifier];
+    return [package[@"version"] isEqualToString:newest[@"version"]] ? package : newest;
+}
+
+- (CPMTransaction *)transactionForInstallingIdentifiers:(NSArray *)identifiers error:(NSError **)error {
+    CPMResolver *resolver = [[CPMResolver alloc] initWithPackageIndex:self.packageIndex];
+    resolver.installedPackages = [CPMDpkgStatus defaultStatus].installedPackages;
+    return [resolver transactionForInstallingIdentifiers:identifiers error:error];
 }
 
 - (NSArray *)searchForPackage:(NSString *)query {
+    return [self searchForPackage:query limit:50];
+}
+
+- (NSArray *)searchForPackage:(NSString *)query limit:(NSUInteger)limit {
+    // every repository hands back its own best `limit` matches, so the best
+    // `limit` overall are among them
+    NSArray *repositories = self.repositories.allObjects;
     NSMutableArray *packages = [NSMutableArray array];
     
-    for (CPMRepository *repo in self.repositories) {
-        [packages addObjectsFromArray:[repo searchForPackage:query]];
-    }
+    dispatch_apply(repositories.count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^(size_t idx) {
+        NSArray *results = [repositories[idx] searchForPackage:query limit:limit];
+        @synchronized (packages) {
+            [packages addObjectsFromArray:results];
+        }
+    });
+    
+    // raw bm25 scores come from separate corpora, so the merge goes by what means the
+    // same everywhere: how the name matches, then relevance within the repository
+    NSString *term = [query stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]].lowercaseString;
+    NSInteger (^tier)(NSDictionary *) = ^NSInteger(NSDictionary *package) {
+        NSString *identifier = [package[@"package"] lowercaseString], *name = [package[@"name"] lowercaseString];
+        if ([identifier isEqualToString:term] || [name isEqualToString:term])
+            return 0;
+        if ([identifier hasPrefix:term] || [name hasPrefix:term])
+            return 1;
+        return 2;
+    };
+    
+    [packages sortUsingComparator:^NSComparisonResult(NSDictionary *a, NSDictionary *b) {
+        NSInteger tierA = tier(a), tierB = tier(b);
+        if (tierA != tierB)
+            return tierA < tierB ? NSOrderedAscending : NSOrderedDescending;
+        
+        return [b[@"relevance"] compare:a[@"relevance"]];
+    }];
+    if (packages.count > limit)
+        [packages removeObjectsInRange:NSMakeRange(limit, packages.count - limit)];
     
     return packages;
 }
@@ -0,0 +1,92 @@
+//
+//  CPMDpkgStatus.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+// The fields of a status entry that are kept
+typedef NS_ENUM(NSUInteger, CPMDpkgStatusField) {
+    CPMDpkgStatusFieldPackage = 0,
+    CPMDpkgStatusFieldVersion,
+    CPMDpkgStatusFieldArchitecture,
+    CPMDpkgStatusFieldName,
+    CPMDpkgStatusFieldSection,
+    CPMDpkgStatusFieldMaintainer,
+    CPMDpkgStatusFieldInstalledSize,
+    CPMDpkgStatusFieldDescription,
+    CPMDpkgStatusFieldDepends,
+    CPMDpkgStatusFieldPreDepends,
+    CPMDpkgStatusFieldBreaks,
+    CPMDpkgStatusFieldConflicts,
+    CPMDpkgStatusFieldProvides,
+    CPMDpkgStatusFieldReplaces,
+    CPMDpkgStatusFieldCount
+};
+
+// The third word of the Status field, in the order dpkg moves through them
+typedef NS_ENUM(uint8_t, CPMDpkgPackageState) {
+    CPMDpkgPackageStateNotInstalled = 0,
+    CPMDpkgPackageStateConfigFiles,
+    CPMDpkgPackageStateHalfInstalled,
+    CPMDpkgPackageStateUnpacked,
+    CPMDpkgPackageStateHalfConfigured,
+    CPMDpkgPackageStateTriggersAwaited,
+    CPMDpkgPackageStateTriggersPending,
+    CPMDpkgPackageStateInstalled
+};
+
+// One entry of the status file. Missing fields are empty strings, never NULL,
+// and only the first line of the description is kept. The strings are only
+// valid during the enumeration.
+typedef struct {
+    CPMDpkgPackageState state;
+    // the first word of Status is "hold"
+    BOOL held;
+    const char *values[CPMDpkgStatusFieldCount];
+} CPMDpkgInstalledPackage;
+
+// Reads dpkg's status database natively instead of asking dpkg-query.
+//
+// The status file is mapped and split into paragraphs with the same stanza
+// parser the repository indexes use; the fields that matter are interned into
+// a compact table with a hash over the identifiers. The table is kept until
+// the file's inode, size or modification time changes, so asking again is
+// one stat(2) until dpkg writes the file. Lookups are safe from any thread.
+@interface CPMDpkgStatus : NSObject
+@property (readonly, copy) NSString *adminDirectory;
+
+// /var/lib/dpkg
++ (instancetype)defaultStatus;
+- (instancetype)initWithAdminDirectory:(NSString *)path;
+
+// Re-reads the status file if dpkg has changed it since the last call. Entries
+// read before stay in use if it cannot be read now.
+- (BOOL)reloadIfNeeded:(NSError **)error;
+
+// Entries that aren't "not-installed", as of the last reload.
+@property (readonly, assign) NSUInteger count;
+
+// Reload if needed, then call the block for every entry in file order.
+// Returns how many entries were visited.
+- (NSUInteger)enumerateInstalledPackagesUsingBlock:(void (^)(const CPMDpkgInstalledPackage *package, BOOL *stop))block;
+
+// Reload if needed, then look one entry up. Returns NO if dpkg knows nothing
+// of the identifier.
+- (BOOL)enumerateInstalledPackage:(NSString *)identifier usingBlock:(void (^)(const CPMDpkgInstalledPackage *package))block;
+
+// Keyed by column name as in the packages table, plus "status" holding the
+// state as an NSNumber and "held".
+- (NSDictionary *)dictionaryForInstalledPackage:(const CPMDpkgInstalledPackage *)package;
+
+// Dictionaries for every package that is unpacked or further along, which is
+// what CPMResolver.installedPackages takes. Built once per reload.
+- (NSArray *)installedPackages;
+
+// Identifiers of the same packages. Built once per reload.
+- (NSArray *)installedIdentifiers;
+
+@end
@@ -0,0 +1,382 @@
+//
+//  CPMDpkgStatus.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMDpkgStatus.h"
+#import "stanza.h"
+#import "strpool.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// stanza slot and dictionary key of each field, in CPMDpkgStatusField order
+static const CPMStanzaField CPMDpkgStatusStanzaFields[CPMDpkgStatusFieldCount] = {
+    CPMStanzaFieldPackage, CPMStanzaFieldVersion, CPMStanzaFieldArchitecture, CPMStanzaFieldName,
+    CPMStanzaFieldSection, CPMStanzaFieldMaintainer, CPMStanzaFieldInstalledSize, CPMStanzaFieldDescription,
+    CPMStanzaFieldDepends, CPMStanzaFieldPreDepends, CPMStanzaFieldBreaks, CPMStanzaFieldConflicts,
+    CPMStanzaFieldProvides, CPMStanzaFieldReplaces
+};
+
+static const char *const CPMDpkgPackageStateNames[] = {
+    "not-installed", "config-files", "half-installed", "unpacked",
+    "half-configured", "triggers-awaited", "triggers-pending", "installed"
+};
+
+static size_t tableSizeFor(size_t count) {
+    size_t size = 16;
+    while (size < count * 2)
+        size <<= 1;
+
+    return size;
+}
+
+// "install ok installed" -> the state word and whether the want word is "hold"
+static CPMDpkgPackageState stateForStatus(const char *bytes, size_t length, BOOL *held) {
+    *held = length >= 5 && memcmp(bytes, "hold ", 5) == 0;
+
+    const char *state = bytes + length;
+    while (state > bytes && state[-1] != ' ')
+        state--;
+
+    size_t stateLength = bytes + length - state;
+    for (uint8_t i = 0; i < sizeof(CPMDpkgPackageStateNames) / sizeof(*CPMDpkgPackageStateNames); i++) {
+        if (strlen(CPMDpkgPackageStateNames[i]) == stateLength && memcmp(CPMDpkgPackageStateNames[i], state, stateLength) == 0)
+            return i;
+    }
+
+    return CPMDpkgPackageStateNotInstalled;
+}
+
+#pragma mark - Table
+
+// One reading of the status file. Immutable once loaded.
+@interface CPMDpkgStatusTable : NSObject {
+@public
+    uint32_t _count;
+
+    CPMStringPool _strings;
+    uint32_t *_fields[CPMDpkgStatusFieldCount];
+    CPMDpkgPackageState *_states;
+    BOOL *_held;
+    uint32_t *_hashes;
+
+    // open-addressing table of row + 1, keyed by identifier
+    uint32_t *_slots;
+    size_t _size;
+
+    // the file this was read from
+    dev_t _device;
+    ino_t _inode;
+    off_t _length;
+    struct timespec _modified;
+}
+@property (strong) NSArray *installedPackages;
+@property (strong) NSArray *installedIdentifiers;
+- (instancetype)initWithBytes:(const char *)bytes length:(size_t)length;
+- (BOOL)matchesFile:(const struct stat *)info;
+- (void)fillPackage:(CPMDpkgInstalledPackage *)package row:(uint32_t)row;
+@end
+
+@implementation CPMDpkgStatusTable
+
+- (instancetype)initWithBytes:(const char *)bytes length:(size_t)length {
+    if ((self = [super init])) {
+        CPMStringPoolInit(&_strings);
+
+        const char *p = bytes;
+        const char *end = bytes + length;
+        size_t capacity = 0;
+
+        while (p < end) {
+            // paragraphs are separated by a blank line
+            const char *next = p;
+            const char *paragraphEnd = end;
+            while ((next = memchr(next, '\n', end - next))) {
+                if (next + 1 < end && next[1] == '\n') {
+                    paragraphEnd = next + 1;
+                    break;
+                }
+                next++;
+            }
+
+            CPMStanza stanza;
+            CPMStanzaParse(p, paragraphEnd - p, &stanza);
+            p = paragraphEnd;
+            while (p < end && *p == '\n')
+                p++;
+
+            CPMStanzaValue *status = &stanza.values[CPMStanzaFieldStatus];
+            if (!stanza.values[CPMStanzaFieldPackage].length || !status->length)
+                continue;
+
+            BOOL held = NO;
+            CPMDpkgPackageState state = stateForStatus(status->bytes, status->length, &held);
+            if (state == CPMDpkgPackageStateNotInstalled)
+                continue;
+
+            if (_count == capacity) {
+                capacity = MAX(capacity * 2, 512);
+                for (int i = 0; i < CPMDpkgStatusFieldCount; i++) {
+                    _fields[i] = realloc(_fields[i], capacity * sizeof(uint32_t));
+                }
+                _states = realloc(_states, capacity * sizeof(CPMDpkgPackageState));
+                _held = realloc(_held, capacity * sizeof(BOOL));
+                _hashes = realloc(_hashes, capacity * sizeof(uint32_t));
+            }
+
+            for (int i = 0; i < CPMDpkgStatusFieldCount; i++) {
+                CPMStanzaValue value = stanza.values[CPMDpkgStatusStanzaFields[i]];
+                if (i == CPMDpkgStatusFieldDescription && value.length) {
+                    const char *eol = memchr(value.bytes, '\n', value.length);
+                    if (eol)
+                        value.length = eol - value.bytes;
+                }
+
+                uint32_t hash = CPMStringHash(value.bytes, value.length);
+                _fields[i][_count] = CPMStringPoolIntern(&_strings, value.bytes, value.length, hash);
+                if (i == CPMDpkgStatusFieldPackage)
+                    _hashes[_count] = hash;
+            }
+
+            _states[_count] = state;
+            _held[_count] = held;
+            _count++;
+        }
+
+        CPMStringPoolSeal(&_strings);
+
+        _size = tableSizeFor(_count);
+        _slots = calloc(_size, sizeof(uint32_t));
+        for (uint32_t row = 0; row < _count; row++) {
+            size_t slot = _hashes[row] & (_size - 1);
+            while (_slots[slot])
+                slot = (slot + 1) & (_size - 1);
+            _slots[slot] = row + 1;
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc {
+    CPMStringPoolFree(&_strings);
+    for (int i = 0; i < CPMDpkgStatusFieldCount; i++) {
+        free(_fields[i]);
+    }
+    free(_states);
+    free(_held);
+    free(_hashes);
+    free(_slots);
+}
+
+- (BOOL)matchesFile:(const struct stat *)info {
+    return info->st_dev == _device && info->st_ino == _inode && info->st_size == _length &&
+        info->st_mtimespec.tv_sec == _modified.tv_sec && info->st_mtimespec.tv_nsec == _modified.tv_nsec;
+}
+
+- (void)fillPackage:(CPMDpkgInstalledPackage *)package row:(uint32_t)row {
+    package->state = _states[row];
+    package->held = _held[row];
+    for (int i = 0; i < CPMDpkgStatusFieldCount; i++) {
+        package->values[i] = CPMStringPoolString(&_strings, _fields[i][row]);
+    }
+}
+
+@end
+
+#pragma mark - Status
+
+@interface CPMDpkgStatus ()
+@property (readwrite, copy) NSString *adminDirectory;
+@property (strong) CPMDpkgStatusTable *table;
+- (CPMDpkgStatusTable *)currentTable;
+@end
+
+@implementation CPMDpkgStatus
+
++ (instancetype)defaultStatus {
+    static CPMDpkgStatus *status = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        status = [[self alloc] initWithAdminDirectory:@"/var/lib/dpkg"];
+    });
+
+    return status;
+}
+
+- (instancetype)initWithAdminDirectory:(NSString *)path {
+    if ((self = [super init])) {
+        self.adminDirectory = path;
+    }
+
+    return self;
+}
+
+- (BOOL)reloadIfNeeded:(NSError **)error {
+    const char *path = [self.adminDirectory stringByAppendingPathComponent:@"status"].fileSystemRepresentation;
+
+    @synchronized (self) {
+        struct stat info;
+        if (self.table && stat(path, &info) == 0 && [self.table matchesFile:&info])
+            return YES;
+
+        int fd = open(path, O_RDONLY);
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            if (error)
+                *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{ NSFilePathErrorKey: @(path) }];
+            if (fd >= 0)
+                close(fd);
+            return NO;
+        }
+
+        // an empty database can't be mapped, and has nothing in it anyway
+        const char *bytes = NULL;
+        if (info.st_size > 0) {
+            bytes = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (bytes == MAP_FAILED) {
+                if (error)
+                    *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{ NSFilePathErrorKey: @(path) }];
+                close(fd);
+                return NO;
+            }
+            madvise((void *)bytes, (size_t)info.st_size, MADV_SEQUENTIAL);
+        }
+        close(fd);
+
+        CPMDpkgStatusTable *table = [[CPMDpkgStatusTable alloc] initWithBytes:bytes length:(size_t)info.st_size];
+        table->_device = info.st_dev;
+        table->_inode = info.st_ino;
+        table->_length = info.st_size;
+        table->_modified = info.st_mtimespec;
+
+        if (bytes)
+            munmap((void *)bytes, (size_t)info.st_size);
+
+        self.table = table;
+    }
+
+    return YES;
+}
+
+- (CPMDpkgStatusTable *)currentTable {
+    NSError *error = nil;
+    if (![self reloadIfNeeded:&error])
+        NSLog(@"could not read the dpkg status database: %@", error);
+
+    return self.table;
+}
+
+- (NSUInteger)count {
+    CPMDpkgStatusTable *table = self.table;
+    return table ? table->_count : 0;
+}
+
+- (NSUInteger)enumerateInstalledPackagesUsingBlock:(void (^)(const CPMDpkgInstalledPackage *package, BOOL *stop))block {
+    CPMDpkgStatusTable *table = [self currentTable];
+    if (!table)
+        return 0;
+
+    BOOL stop = NO;
+    NSUInteger visited = 0;
+    for (uint32_t row = 0; row < table->_count && !stop; row++) {
+        CPMDpkgInstalledPackage package;
+        [table fillPackage:&package row:row];
+
+        visited++;
+        block(&package, &stop);
+    }
+
+    return visited;
+}
+
+- (BOOL)enumerateInstalledPackage:(NSString *)identifier usingBlock:(void (^)(const CPMDpkgInstalledPackage *package))block {
+    CPMDpkgStatusTable *table = [self currentTable];
+    if (!table)
+        return NO;
+
+    const char *name = identifier.UTF8String;
+    size_t length = strlen(name);
+    uint32_t hash = CPMStringHash(name, length);
+
+    // the same package can be in the database once per architecture
+    BOOL found = NO;
+    for (size_t slot = hash & (table->_size - 1); table->_slots[slot]; slot = (slot + 1) & (table->_size - 1)) {
+        uint32_t row = table->_slots[slot] - 1;
+        if (table->_hashes[row] != hash)
+            continue;
+
+        const char *package = CPMStringPoolString(&table->_strings, table->_fields[CPMDpkgStatusFieldPackage][row]);
+        if (strcmp(package, name) != 0)
+            continue;
+
+        CPMDpkgInstalledPackage entry;
+        [table fillPackage:&entry row:row];
+
+        found = YES;
+        block(&entry);
+    }
+
+    return found;
+}
+
+- (NSDictionary *)dictionaryForInstalledPackage:(const CPMDpkgInstalledPackage *)package {
+    NSMutableDictionary *dictionary = [NSMutableDictionary dictionary];
+    for (int i = 0; i < CPMDpkgStatusFieldCount; i++) {
+        if (*package->values[i])
+            dictionary[@(CPMStanzaFieldColumn(CPMDpkgStatusStanzaFields[i]))] = @(package->values[i]);
+    }
+
+    dictionary[@"status"] = @(package->state);
+    dictionary[@"held"] = @(package->held);
+
+    return dictionary;
+}
+
+- (NSArray *)installedPackages {
+    CPMDpkgStatusTable *table = [self currentTable];
+    if (!table)
+        return @[];
+
+    @synchronized (table) {
+        if (!table.installedPackages) {
+            NSMutableArray *packages = [NSMutableArray arrayWithCapacity:table->_count];
+            for (uint32_t row = 0; row < table->_count; row++) {
+                if (table->_states[row] < CPMDpkgPackageStateUnpacked)
+                    continue;
+
+                CPMDpkgInstalledPackage package;
+                [table fillPackage:&package row:row];
+                [packages addObject:[self dictionaryForInstalledPackage:&package]];
+            }
+            table.installedPackages = packages;
+        }
+
+        return table.installedPackages;
+    }
+}
+
+- (NSArray *)installedIdentifiers {
+    CPMDpkgStatusTable *table = [self currentTable];
+    if (!table)
+        return @[];
+
+    @synchronized (table) {
+        if (!table.installedIdentifiers) {
+            NSMutableArray *identifiers = [NSMutableArray arrayWithCapacity:table->_count];
+            for (uint32_t row = 0; row < table->_count; row++) {
+                if (table->_states[row] >= CPMDpkgPackageStateUnpacked)
+                    [identifiers addObject:@(CPMStringPoolString(&table->_strings, table->_fields[CPMDpkgStatusFieldPackage][row]))];
+            }
+            table.installedIdentifiers = identifiers;
+        }
+
+        return table.installedIdentifiers;
+    }
+}
+
+@end
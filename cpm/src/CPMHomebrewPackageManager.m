@@ -58,16 +58,50 @@ static NSString *const kCPMHomebrewBrewCommandPath = @"bin/brew";
 
 - (void)packagesForIdentifiers:(NSArray *)identifiers completion:(CPMPackageManagerPackagesForIdentifiersCompletion)completion {
 	[self _launchBrewTaskWithArguments:[@[ @"info", @"--json=v1" ] arrayByAddingObjectsFromArray:identifiers] completion:^(NSError *error, id json, NSString *output, NSString *errorOutput) {
-		if (error) {
+		if (!error) {
+			NSMutableDictionary *packages = [NSMutableDictionary dictionary];
+			
+			for (NSDictionary *package in json) {
+				packages[package[@"full_name"]] = [[CPMHomebrewPackage alloc] initWithDictionary:package];
+			}
+			
+			completion(packages, nil);
+			return;
+		}
+		
+		if (identifiers.count < 2) {
 			completion(nil, error);
 			return;
 		}
 		
+		// a single name brew doesn't know fails the whole call, so split the batch
+		// until the names that fail are on their own. only if nothing could be
+		// found is it an error
+		NSUInteger half = identifiers.count / 2;
+		NSArray *halves = @[ [identifiers subarrayWithRange:NSMakeRange(0, half)], [identifiers subarrayWithRange:NSMakeRange(half, identifiers.count - half)] ];
 		NSMutableDictionary *packages = [NSMutableDictionary dictionary];
+		NSMutableArray *errors = [NSMutableArray array];
+		dispatch_group_t group = dispatch_group_create();
 		
-		for (NSDictionary *package in json) {
-			packages[package[@"full_name"]] = [[CPMHomebrewPackage alloc] initWithDictionary:package];
+		for (NSArray *batch in halves) {
+			dispatch_group_enter(group);
+			
+			[self packagesForIdentifiers:batch completion:^(NSDictionary *found, NSError *error) {
+				@synchronized (packages) {
+					[packages addEntriesFromDictionary:found];
+					
+					if (error) {
+						[errors addObject:error];
+					}
+				}
+				
+				dispatch_group_leave(group);
+			}];
 		}
+		
+		dispatch_group_notify(group, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+			completion(packages, errors.count == halves.count ? errors.firstObject : nil);
+		});
 	}];
 }
 
@@ -82,6 +116,18 @@ static NSString *const kCPMHomebrewBrewCommandPath = @"bin/brew";
 	return nil;
 }
 
+- (BOOL)canOwnPackageIdentifier:(NSString *)identifier {
+	// formula names, optionally qualified by their tap. they only have dots in a
+	// version after an @, which keeps out the reverse-DNS identifiers dpkg uses
+	static NSRegularExpression *formulaName;
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		formulaName = [NSRegularExpression regularExpressionWithPattern:@"^([a-z0-9_-]+/[a-z0-9_-]+/)?[a-z0-9+_-]+(@[a-z0-9.+_-]+)?$" options:kNilOptions error:nil];
+	});
+	
+	return self.isInstalled && [formulaName numberOfMatchesInString:identifier options:kNilOptions range:NSMakeRange(0, identifier.length)] > 0;
+}
+
 - (BOOL)isPrefixCompatible {
 	return NO; // TODO: implement
 }
@@ -98,7 +144,39 @@ static NSString *const kCPMHomebrewBrewCommandPath = @"bin/brew";
 	task.arguments = arguments;
 	task.standardOutput = [NSPipe pipe];
 	task.standardError = [NSPipe pipe];
+	
+	// both pipes are read while brew runs: once either one's buffer fills up,
+	// brew blocks writing to it and never exits
+	NSMutableData *outputData = [NSMutableData data];
+	NSMutableData *errorData = [NSMutableData data];
+	dispatch_group_t group = dispatch_group_create();
+	
+	void (^drain)(NSPipe *, NSMutableData *) = ^(NSPipe *pipe, NSMutableData *data) {
+		dispatch_group_enter(group);
+		
+		pipe.fileHandleForReading.readabilityHandler = ^(NSFileHandle *handle) {
+			NSData *available = handle.availableData;
+			
+			if (available.length > 0) {
+				[data appendData:available];
+				return;
+			}
+			
+			handle.readabilityHandler = nil;
+			dispatch_group_leave(group);
+		};
+	};
+	
+	drain(task.standardOutput, outputData);
+	drain(task.standardError, errorData);
+	
+	dispatch_group_enter(group);
+	
 	task.terminationHandler = ^(NSTask *task) {
+		dispatch_group_leave(group);
+	};
+	
+	dispatch_group_notify(group, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
 		NSError *error = nil;
 		
 		if (task.terminationStatus) {
@@ -107,7 +185,6 @@ static NSString *const kCPMHomebrewBrewCommandPath = @"bin/brew";
 			}];
 		}
 		
-		NSData *outputData = ((NSPipe *)task.standardOutput).fileHandleForReading.readDataToEndOfFile;
 		id json = nil;
 		
 		if (outputData.length > 0) {
@@ -126,10 +203,10 @@ static NSString *const kCPMHomebrewBrewCommandPath = @"bin/brew";
 			output = [[NSString alloc] initWithData:outputData encoding:NSUTF8StringEncoding];
 		}
 		
-		NSString *errorOutput = [[NSString alloc] initWithData:((NSPipe *)task.standardError).fileHandleForReading.readDataToEndOfFile encoding:NSUTF8StringEncoding];
+		NSString *errorOutput = [[NSString alloc] initWithData:errorData encoding:NSUTF8StringEncoding];
 		
 		completion(error, json, output, errorOutput);
-	};
+	});
 	
 	[task launch];
 }
@@ -0,0 +1,46 @@
+//
+//  CPMIndexStream.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+// Decompresses an index while it is still downloading and hands out its
+// paragraphs ("stanzas") one at a time.
+//
+// The network side pushes chunks with -appendData: and signals the end of the
+// body with -finish (or -abort on failure). A consumer thread calls
+// -enumerateStanzasUsingBlock:error:, which blocks until the stream ends.
+// Once the consumer reads, at most `window` compressed chunks are queued at
+// once; -appendData: blocks the producer until the consumer catches up, so
+// memory stays bounded no matter how large the index is. Chunks that arrive
+// before anything reads are all kept, and a body that is already whole by
+// then and made of several members is decoded a group of members per thread.
+@interface CPMIndexStream : NSObject
+
+- (instancetype)initWithWindow:(NSUInteger)window;
+
+// Producer side
+- (void)appendData:(NSData *)data;
+- (void)finish;
+- (void)abortWithError:(NSError *)error;
+
+// Called on the consumer thread with the index exactly as it decompresses,
+// before it is split into stanzas.
+@property (copy) void (^decompressedBlock)(const char *bytes, size_t length);
+
+// Consumer side. The bytes passed to the block are only valid for the
+// duration of the call. Return NO from the block to stop early.
+- (BOOL)enumerateStanzasUsingBlock:(BOOL (^)(const char *bytes, size_t length))block error:(NSError **)error;
+
+// Counted as the stream is consumed. The decompression time leaves out time
+// spent waiting for the network.
+@property (readonly, assign) uint64_t compressedBytes;
+@property (readonly, assign) uint64_t decompressedBytes;
+@property (readonly, assign) NSUInteger stanzaCount;
+@property (readonly, assign) NSTimeInterval decompressTime;
+
+@end
@@ -0,0 +1,328 @@
+//
+//  CPMIndexStream.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMIndexStream.h"
+#import "CPDefines.h"
+#import "decompress.h"
+#import <archive.h>
+#import <archive_entry.h>
+
+// how much decompressed data is pulled out of libarchive at a time
+#define CPMIndexStreamReadSize (64 * 1024)
+
+@interface CPMIndexStream ()
+@property (strong) NSCondition *condition;
+@property (strong) NSMutableArray *chunks;
+@property (strong) NSData *currentChunk;
+@property (assign) NSUInteger window;
+@property (assign) BOOL consuming;
+@property (assign) BOOL finished;
+@property (assign) BOOL stopped;
+@property (copy) NSError *error;
+@property (readwrite, assign) uint64_t compressedBytes;
+@property (readwrite, assign) uint64_t decompressedBytes;
+@property (readwrite, assign) NSUInteger stanzaCount;
+@property (readwrite, assign) NSTimeInterval decompressTime;
+@property (assign) NSTimeInterval waitTime;
+- (NSData *)nextChunk;
+- (NSData *)decompressWholeBody;
+@end
+
+// libarchive pulls compressed bytes through this callback. It blocks until the
+// network has delivered another chunk or the body has ended.
+static ssize_t CPMIndexStreamRead(struct archive *a, void *client, const void **buffer) {
+    CPMIndexStream *stream = (__bridge CPMIndexStream *)client;
+    NSData *chunk = [stream nextChunk];
+    if (!chunk) {
+        *buffer = NULL;
+        if (stream.error) {
+            archive_set_error(a, EIO, "%s", stream.error.localizedDescription.UTF8String);
+            return ARCHIVE_FATAL;
+        }
+
+        return 0;
+    }
+
+    *buffer = chunk.bytes;
+    return (ssize_t)chunk.length;
+}
+
+// Hands every complete stanza in buffer[start, length) to the block. A stanza
+// ends at a blank line; the last one is only emitted once the stream is at EOF.
+// `scanned` remembers how far we already looked so no byte is searched twice.
+static BOOL CPMIndexStreamEmitStanzas(const char *buffer, size_t length, size_t *start, size_t *scanned, BOOL eof, BOOL (^block)(const char *bytes, size_t length)) {
+    size_t pos = *scanned;
+    while (pos < length) {
+        const char *newline = memchr(buffer + pos, '\n', length - pos);
+        if (!newline) {
+            pos = length;
+            break;
+        }
+
+        size_t idx = newline - buffer;
+        if (idx + 1 >= length) {
+            // we need the next byte to know whether this is a separator
+            pos = idx;
+            break;
+        }
+
+        if (buffer[idx + 1] != '\n') {
+            pos = idx + 1;
+            continue;
+        }
+
+        if (idx > *start && !block(buffer + *start, idx - *start)) {
+            return NO;
+        }
+
+        *start = idx + 2;
+        pos = *start;
+    }
+    *scanned = pos;
+
+    if (eof && *start < length) {
+        if (!block(buffer + *start, length - *start)) {
+            return NO;
+        }
+        *start = length;
+        *scanned = length;
+    }
+
+    return YES;
+}
+
+@implementation CPMIndexStream
+
+- (instancetype)init {
+    return [self initWithWindow:32];
+}
+
+- (instancetype)initWithWindow:(NSUInteger)window {
+    if ((self = [super init])) {
+        self.condition = [[NSCondition alloc] init];
+        self.chunks = [NSMutableArray array];
+        self.window = MAX(window, 1);
+    }
+
+    return self;
+}
+
+#pragma mark - Producer
+
+- (void)appendData:(NSData *)data {
+    if (!data.length)
+        return;
+
+    // nothing frees the window before a consumer reads, and the consumer may
+    // be waiting for downloads queued behind this one to start
+    [self.condition lock];
+    while (self.consuming && self.chunks.count >= self.window && !self.finished && !self.stopped) {
+        [self.condition wait];
+    }
+
+    if (!self.finished && !self.stopped) {
+        [self.chunks addObject:[data copy]];
+        [self.condition broadcast];
+    }
+    [self.condition unlock];
+}
+
+- (void)finish {
+    [self.condition lock];
+    self.finished = YES;
+    [self.condition broadcast];
+    [self.condition unlock];
+}
+
+- (void)abortWithError:(NSError *)error {
+    [self.condition lock];
+    self.error = error ?: [NSError errorWithDomain:CPMERRORDOMAIN code:CPMErrorDecompression userInfo:nil];
+    self.finished = YES;
+    [self.chunks removeAllObjects];
+    [self.condition broadcast];
+    [self.condition unlock];
+}
+
+#pragma mark - Consumer
+
+- (NSData *)nextChunk {
+    NSTimeInterval start = [NSProcessInfo processInfo].systemUptime;
+    [self.condition lock];
+    while (!self.chunks.count && !self.finished) {
+        [self.condition wait];
+    }
+    self.waitTime += [NSProcessInfo processInfo].systemUptime - start;
+
+    NSData *chunk = nil;
+    if (self.chunks.count && !self.error) {
+        chunk = self.chunks[0];
+        [self.chunks removeObjectAtIndex:0];
+        self.compressedBytes += chunk.length;
+        [self.condition broadcast];
+    }
+
+    // libarchive may still be looking at the bytes we return until the next read
+    self.currentChunk = chunk;
+    [self.condition unlock];
+
+    return chunk;
+}
+
+// A body that arrived whole before anything read it may be made of members
+// that decode side by side, as pigz, pbzip2 and xz -T write them. Returns nil
+// if it has to be streamed after all, leaving the chunks where they were.
+- (NSData *)decompressWholeBody {
+    NSMutableData *body = nil;
+    [self.condition lock];
+    if (self.finished && !self.error && self.chunks.count) {
+        body = [NSMutableData data];
+        for (NSData *chunk in self.chunks) {
+            [body appendData:chunk];
+        }
+    }
+    [self.condition unlock];
+
+    if (!body)
+        return nil;
+
+    NSTimeInterval start = [NSProcessInfo processInfo].systemUptime;
+    NSData *output = decompressDataInParallel(body);
+    if (!output)
+        return nil;
+
+    self.decompressTime += [NSProcessInfo processInfo].systemUptime - start;
+    self.compressedBytes += body.length;
+    self.decompressedBytes += output.length;
+
+    return output;
+}
+
+- (BOOL)enumerateStanzasUsingBlock:(BOOL (^)(const char *bytes, size_t length))block error:(NSError **)error {
+    BOOL (^counted)(const char *, size_t) = ^BOOL(const char *bytes, size_t length) {
+        self.stanzaCount++;
+        return block(bytes, length);
+    };
+
+    [self.condition lock];
+    self.consuming = YES;
+    [self.condition unlock];
+
+    NSData *whole = [self decompressWholeBody];
+    if (whole) {
+        if (self.decompressedBlock)
+            self.decompressedBlock(whole.bytes, whole.length);
+
+        size_t start = 0, scanned = 0;
+        BOOL keepGoing = CPMIndexStreamEmitStanzas(whole.bytes, whole.length, &start, &scanned, YES, counted);
+
+        [self.condition lock];
+        self.stopped = YES;
+        [self.chunks removeAllObjects];
+        [self.condition unlock];
+
+        return keepGoing;
+    }
+
+    struct archive *a = archive_read_new();
+    struct archive_entry *ae;
+#ifdef HAVE_ARCHIVE_READ_SUPPORT_FILTER_ALL
+    archive_read_support_filter_all(a);
+#else
+    archive_read_support_compression_all(a);
+#endif
+    archive_read_support_format_raw(a);
+    archive_read_support_format_empty(a);
+
+    NSString *failure = nil;
+    BOOL keepGoing = YES;
+
+    int r = archive_read_open(a, (__bridge void *)self, NULL, CPMIndexStreamRead, NULL);
+    if (r == ARCHIVE_OK) {
+        r = archive_read_next_header(a, &ae);
+    }
+
+    if (r == ARCHIVE_OK) {
+        size_t capacity = CPMIndexStreamReadSize * 4;
+        size_t length = 0, start = 0, scanned = 0;
+        char *buffer = malloc(capacity);
+        BOOL eof = NO;
+
+        while (keepGoing && !eof) {
+            // slide the unfinished stanza to the front, only growing the window
+            // when a single stanza doesn't fit
+            if (capacity - length < CPMIndexStreamReadSize) {
+                if (start > 0) {
+                    memmove(buffer, buffer + start, length - start);
+                    length -= start;
+                    scanned -= start;
+                    start = 0;
+                }
+
+                if (capacity - length < CPMIndexStreamReadSize) {
+                    capacity *= 2;
+                    buffer = realloc(buffer, capacity);
+                }
+            }
+
+            NSTimeInterval readStart = [NSProcessInfo processInfo].systemUptime;
+            NSTimeInterval waited = self.waitTime;
+            ssize_t size = archive_read_data(a, buffer + length, CPMIndexStreamReadSize);
+            self.decompressTime += [NSProcessInfo processInfo].systemUptime - readStart - (self.waitTime - waited);
+            if (size < 0) {
+                failure = @(archive_error_string(a) ?: "unknown decompression error");
+                break;
+            }
+
+            if (size > 0 && self.decompressedBlock) {
+                self.decompressedBlock(buffer + length, size);
+            }
+            
+            eof = size == 0;
+            length += size;
+            self.decompressedBytes += size;
+            keepGoing = CPMIndexStreamEmitStanzas(buffer, length, &start, &scanned, eof, counted);
+        }
+
+        free(buffer);
+    } else if (r != ARCHIVE_EOF) {
+        // an empty body is a valid, empty index
+        failure = @(archive_error_string(a) ?: "unrecognized index format");
+    }
+
+    archive_read_free(a);
+
+    // let a blocked producer go if we stopped reading early
+    [self.condition lock];
+    self.stopped = YES;
+    [self.chunks removeAllObjects];
+    [self.condition broadcast];
+    [self.condition unlock];
+
+    if (self.error) {
+        if (error)
+            *error = self.error;
+        return NO;
+    }
+
+    if (failure) {
+        if (error) {
+            //!TODO: localize this
+            *error = [NSError errorWithDomain:CPMERRORDOMAIN
+                                         code:CPMErrorDecompression
+                                     userInfo:@{
+                                                NSLocalizedDescriptionKey: @"The downloaded packages index was in an unrecognizable format and could not be decompressed",
+                                                NSLocalizedFailureReasonErrorKey: failure
+                                                }];
+        }
+        return NO;
+    }
+
+    return keepGoing;
+}
+
+@end
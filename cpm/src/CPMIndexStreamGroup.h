@@ -0,0 +1,31 @@
+//
+//  CPMIndexStreamGroup.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "CPMIndexStream.h"
+
+// Consumes several index streams at once for a single consumer, such as the
+// one connection that may write a repository's database.
+//
+// Every stream is decompressed and split on a thread of its own; whole
+// stanzas are copied into batches and handed to the thread that called
+// -enumerateStanzasUsingBlock:error:. Only a few batches per stream are queued
+// at a time, so a consumer that falls behind pushes back on the streams and
+// through them on the network. One stream is consumed in place, without copies.
+@interface CPMIndexStreamGroup : NSObject
+@property (readonly, copy) NSArray *streams;
+
+- (instancetype)initWithStreams:(NSArray *)streams;
+
+// The block is called on the calling thread with each stanza and the index of
+// its stream in `streams`; stanzas of one stream keep their order. Return NO
+// from the block to stop early. When a stream fails the others are aborted
+// and its error is returned.
+- (BOOL)enumerateStanzasUsingBlock:(BOOL (^)(const char *bytes, size_t length, NSUInteger stream))block error:(NSError **)error;
+
+@end
@@ -0,0 +1,193 @@
+//
+//  CPMIndexStreamGroup.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMIndexStreamGroup.h"
+#import "CPDefines.h"
+
+// a batch is handed over once it holds this many bytes of stanzas
+#define CPMIndexStreamGroupBatchSize (256 * 1024)
+
+// batches that may wait for the consumer, per stream
+#define CPMIndexStreamGroupBatchesPerStream 4
+
+// Whole stanzas of one stream, back to back
+@interface CPMIndexStreamBatch : NSObject
+@property (assign) NSUInteger stream;
+@property (strong) NSMutableData *bytes;
+@property (strong) NSMutableData *lengths;
+@end
+
+@implementation CPMIndexStreamBatch
+
+- (instancetype)initWithStream:(NSUInteger)stream {
+    if ((self = [super init])) {
+        self.stream = stream;
+        self.bytes = [NSMutableData dataWithCapacity:CPMIndexStreamGroupBatchSize + 4096];
+        self.lengths = [NSMutableData data];
+    }
+
+    return self;
+}
+
+- (void)addStanza:(const char *)bytes length:(size_t)length {
+    [self.bytes appendBytes:bytes length:length];
+    [self.lengths appendBytes:&length length:sizeof(length)];
+}
+
+@end
+
+@interface CPMIndexStreamGroup ()
+@property (readwrite, copy) NSArray *streams;
+@property (strong) NSCondition *condition;
+@property (strong) NSMutableArray *batches;
+@property (assign) NSUInteger running;
+@property (assign) BOOL stopped;
+@property (copy) NSError *error;
+- (BOOL)enqueueBatch:(CPMIndexStreamBatch *)batch;
+- (void)consumeStreamOnThread:(NSArray *)arguments;
+- (void)consumeStream:(NSUInteger)idx;
+@end
+
+@implementation CPMIndexStreamGroup
+
+- (instancetype)initWithStreams:(NSArray *)streams {
+    if ((self = [super init])) {
+        self.streams = streams;
+        self.condition = [[NSCondition alloc] init];
+        self.batches = [NSMutableArray array];
+    }
+
+    return self;
+}
+
+- (BOOL)enumerateStanzasUsingBlock:(BOOL (^)(const char *bytes, size_t length, NSUInteger stream))block error:(NSError **)error {
+    if (self.streams.count == 1) {
+        return [self.streams[0] enumerateStanzasUsingBlock:^BOOL(const char *bytes, size_t length) {
+            return block(bytes, length, 0);
+        } error:error];
+    }
+
+    // a thread per stream rather than a queue: these block on the network,
+    // which would hold workers that the curlers' own callbacks may be waiting for
+    self.running = self.streams.count;
+    dispatch_group_t group = dispatch_group_create();
+    for (NSUInteger i = 0; i < self.streams.count; i++) {
+        dispatch_group_enter(group);
+        NSThread *thread = [[NSThread alloc] initWithTarget:self selector:@selector(consumeStreamOnThread:) object:@[ @(i), group ]];
+        thread.name = [NSString stringWithFormat:@"cpm.streams.%lu", (unsigned long)i];
+        [thread start];
+    }
+
+    BOOL keepGoing = YES;
+    while (keepGoing) {
+        [self.condition lock];
+        while (!self.batches.count && self.running && !self.error) {
+            [self.condition wait];
+        }
+
+        CPMIndexStreamBatch *batch = nil;
+        if (self.batches.count && !self.error) {
+            batch = self.batches[0];
+            [self.batches removeObjectAtIndex:0];
+            [self.condition broadcast];
+        }
+        [self.condition unlock];
+
+        if (!batch)
+            break;
+
+        const char *bytes = batch.bytes.bytes;
+        const size_t *lengths = batch.lengths.bytes;
+        size_t count = batch.lengths.length / sizeof(size_t);
+        for (size_t i = 0; keepGoing && i < count; i++) {
+            keepGoing = block(bytes, lengths[i], batch.stream);
+            bytes += lengths[i];
+        }
+    }
+
+    // let the streams go, whether they're done or not; once stopped, none of
+    // them sets the error any more
+    [self.condition lock];
+    BOOL finished = !self.running;
+    NSError *failure = self.error;
+    self.stopped = YES;
+    [self.batches removeAllObjects];
+    [self.condition broadcast];
+    [self.condition unlock];
+
+    if (!finished) {
+        for (CPMIndexStream *stream in self.streams) {
+            [stream abortWithError:failure];
+        }
+    }
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+
+    if (failure) {
+        if (error)
+            *error = failure;
+        return NO;
+    }
+
+    return YES;
+}
+
+// The index of the stream and the group to leave once it's consumed
+- (void)consumeStreamOnThread:(NSArray *)arguments {
+    @autoreleasepool {
+        [self consumeStream:[arguments[0] unsignedIntegerValue]];
+        dispatch_group_leave(arguments[1]);
+    }
+}
+
+- (void)consumeStream:(NSUInteger)idx {
+    __block CPMIndexStreamBatch *batch = [[CPMIndexStreamBatch alloc] initWithStream:idx];
+
+    // whether the group stopped is only looked at, under the lock, when a
+    // batch is handed over; until then an aborted stream ends on its own
+    NSError *streamError = nil;
+    BOOL streamed = [self.streams[idx] enumerateStanzasUsingBlock:^BOOL(const char *bytes, size_t length) {
+        [batch addStanza:bytes length:length];
+        if (batch.bytes.length < CPMIndexStreamGroupBatchSize)
+            return YES;
+
+        BOOL enqueued = [self enqueueBatch:batch];
+        batch = [[CPMIndexStreamBatch alloc] initWithStream:idx];
+        return enqueued;
+    } error:&streamError];
+
+    if (streamed && batch.lengths.length)
+        [self enqueueBatch:batch];
+
+    [self.condition lock];
+    // a stream aborted because we stopped isn't what went wrong
+    if (!streamed && !self.stopped && !self.error)
+        self.error = streamError ?: [NSError errorWithDomain:CPMERRORDOMAIN code:CPMErrorDecompression userInfo:nil];
+    self.running--;
+    [self.condition broadcast];
+    [self.condition unlock];
+}
+
+- (BOOL)enqueueBatch:(CPMIndexStreamBatch *)batch {
+    NSUInteger limit = self.streams.count * CPMIndexStreamGroupBatchesPerStream;
+
+    [self.condition lock];
+    while (self.batches.count >= limit && !self.stopped && !self.error) {
+        [self.condition wait];
+    }
+
+    BOOL enqueued = !self.stopped && !self.error;
+    if (enqueued) {
+        [self.batches addObject:batch];
+        [self.condition broadcast];
+    }
+    [self.condition unlock];
+
+    return enqueued;
+}
+
+@end
@@ -0,0 +1,25 @@
+//
+//  CPMPackageCache.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+// Thread safe LRU cache of package objects by identifier. Entries older than
+// the time to live are treated as missing. Store NSNull to remember that a
+// package manager doesn't know an identifier.
+@interface CPMPackageCache : NSObject
+
+@property (readonly) NSUInteger capacity;
+@property (readonly) NSTimeInterval timeToLive;
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity timeToLive:(NSTimeInterval)timeToLive;
+
+- (id)objectForKey:(NSString *)identifier;
+- (void)setObject:(id)object forKey:(NSString *)identifier;
+- (void)removeAllObjects;
+
+@end
@@ -0,0 +1,128 @@
+//
+//  CPMPackageCache.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMPackageCache.h"
+
+@interface CPMPackageCacheEntry : NSObject
+
+@property (strong, nonatomic) NSString *key;
+@property (strong, nonatomic) id object;
+@property NSTimeInterval expiry;
+
+// most recently used first
+@property (weak, nonatomic) CPMPackageCacheEntry *previous;
+@property (strong, nonatomic) CPMPackageCacheEntry *next;
+
+@end
+
+@implementation CPMPackageCacheEntry
+
+@end
+
+@implementation CPMPackageCache {
+	NSMutableDictionary *_entries;
+	CPMPackageCacheEntry *_head;
+	CPMPackageCacheEntry *_tail;
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity timeToLive:(NSTimeInterval)timeToLive {
+	self = [super init];
+	
+	if (self) {
+		_capacity = MAX(capacity, 1);
+		_timeToLive = timeToLive;
+		_entries = [NSMutableDictionary dictionaryWithCapacity:_capacity];
+	}
+	
+	return self;
+}
+
+- (void)_unlinkEntry:(CPMPackageCacheEntry *)entry {
+	if (entry.previous) {
+		entry.previous.next = entry.next;
+	} else {
+		_head = entry.next;
+	}
+	
+	if (entry.next) {
+		entry.next.previous = entry.previous;
+	} else {
+		_tail = entry.previous;
+	}
+	
+	entry.previous = nil;
+	entry.next = nil;
+}
+
+- (void)_pushEntry:(CPMPackageCacheEntry *)entry {
+	entry.next = _head;
+	_head.previous = entry;
+	_head = entry;
+	
+	if (!_tail) {
+		_tail = entry;
+	}
+}
+
+- (id)objectForKey:(NSString *)identifier {
+	@synchronized (self) {
+		CPMPackageCacheEntry *entry = _entries[identifier];
+		
+		if (!entry) {
+			return nil;
+		}
+		
+		if (entry.expiry < [NSDate timeIntervalSinceReferenceDate]) {
+			[self _unlinkEntry:entry];
+			[_entries removeObjectForKey:identifier];
+			return nil;
+		}
+		
+		[self _unlinkEntry:entry];
+		[self _pushEntry:entry];
+		
+		return entry.object;
+	}
+}
+
+- (void)setObject:(id)object forKey:(NSString *)identifier {
+	@synchronized (self) {
+		CPMPackageCacheEntry *entry = _entries[identifier];
+		
+		if (entry) {
+			[self _unlinkEntry:entry];
+		} else {
+			entry = [[CPMPackageCacheEntry alloc] init];
+			entry.key = identifier;
+			_entries[identifier] = entry;
+		}
+		
+		entry.object = object;
+		entry.expiry = [NSDate timeIntervalSinceReferenceDate] + _timeToLive;
+		[self _pushEntry:entry];
+		
+		while (_entries.count > _capacity) {
+			CPMPackageCacheEntry *last = _tail;
+			[self _unlinkEntry:last];
+			[_entries removeObjectForKey:last.key];
+		}
+	}
+}
+
+- (void)removeAllObjects {
+	@synchronized (self) {
+		// unlink one by one so a long chain isn't released recursively
+		while (_head) {
+			[self _unlinkEntry:_head];
+		}
+		
+		[_entries removeAllObjects];
+	}
+}
+
+@end
@@ -0,0 +1,23 @@
+//
+//  CPMPackageChanges.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+// What a refresh changed about the packages a repository lists, as package
+// identifiers sorted by name. A package whose version changed either way is
+// upgraded; one whose other fields changed without a new version isn't listed.
+@interface CPMPackageChanges : NSObject
+@property (readonly, copy) NSArray *added;
+@property (readonly, copy) NSArray *upgraded;
+@property (readonly, copy) NSArray *removed;
+// added, upgraded and removed together
+@property (readonly, assign) NSUInteger count;
+
+- (instancetype)initWithAdded:(NSSet *)added upgraded:(NSSet *)upgraded removed:(NSSet *)removed;
+
+@end
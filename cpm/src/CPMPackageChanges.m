@@ -0,0 +1,38 @@
+//
+//  CPMPackageChanges.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMPackageChanges.h"
+
+@interface CPMPackageChanges ()
+@property (readwrite, copy) NSArray *added;
+@property (readwrite, copy) NSArray *upgraded;
+@property (readwrite, copy) NSArray *removed;
+@end
+
+@implementation CPMPackageChanges
+
+- (instancetype)initWithAdded:(NSSet *)added upgraded:(NSSet *)upgraded removed:(NSSet *)removed {
+    if ((self = [super init])) {
+        self.added = [added.allObjects sortedArrayUsingSelector:@selector(compare:)] ?: @[];
+        self.upgraded = [upgraded.allObjects sortedArrayUsingSelector:@selector(compare:)] ?: @[];
+        self.removed = [removed.allObjects sortedArrayUsingSelector:@selector(compare:)] ?: @[];
+    }
+    
+    return self;
+}
+
+- (NSUInteger)count {
+    return self.added.count + self.upgraded.count + self.removed.count;
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %lu added, %lu upgraded, %lu removed>", self.class,
+            (unsigned long)self.added.count, (unsigned long)self.upgraded.count, (unsigned long)self.removed.count];
+}
+
+@end
@@ -0,0 +1,41 @@
+//
+//  CPMPackageDownloader.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+// Fetches .debs into a content-addressed archive cache, named after the
+// strongest checksum the repository publishes (sha256-<hex>.deb), so a
+// package is never downloaded twice.
+//
+// Downloads go through CPMDownloadScheduler. Bodies are written straight to
+// disk and hashed as they arrive, so verifying costs no second pass. An
+// interrupted download is kept under partial/ and resumed with an HTTP Range
+// request, both on a retry and on the next run.
+@interface CPMPackageDownloader : NSObject
+@property (readonly, copy) NSString *cachePath;
+
+// How many times a download is resumed after a network error. Defaults to 2.
+@property (assign) NSUInteger retryCount;
+
+// Uses LOCALSTORAGE_PATH/archives
++ (instancetype)sharedDownloader;
+- (instancetype)initWithCachePath:(NSString *)path;
+
+// The cached archive for a package dictionary, or nil if it isn't cached or
+// the package has no checksum.
+- (NSString *)cachedPathForPackage:(NSDictionary *)package;
+
+// Packages are dictionaries from the package index or a repository. The
+// archive is fetched from "url" if present, else from "filename" relative to
+// "repo". The completion is called on the main queue with the local paths,
+// keyed by package identifier, or with the first error.
+- (void)downloadPackages:(NSArray *)packages
+                progress:(void (^)(NSDictionary *package, int64_t bytesDownloaded, int64_t bytesExpected))progress
+              completion:(void (^)(NSDictionary *paths, NSError *error))completion;
+
+@end
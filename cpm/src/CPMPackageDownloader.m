@@ -0,0 +1,379 @@
+//
+//  CPMPackageDownloader.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMPackageDownloader.h"
+#import "CPDefines.h"
+#import "CPMCurler.h"
+#import "CPMDownloadScheduler.h"
+#import <CommonCrypto/CommonDigest.h>
+
+typedef NS_ENUM(NSUInteger, CPMDigestAlgorithm) {
+    CPMDigestMD5,
+    CPMDigestSHA1,
+    CPMDigestSHA256
+};
+
+typedef struct {
+    CPMDigestAlgorithm algorithm;
+    union {
+        CC_MD5_CTX md5;
+        CC_SHA1_CTX sha1;
+        CC_SHA256_CTX sha256;
+    } context;
+} CPMDigest;
+
+static void digestInit(CPMDigest *digest, CPMDigestAlgorithm algorithm) {
+    digest->algorithm = algorithm;
+    switch (algorithm) {
+        case CPMDigestMD5:
+            CC_MD5_Init(&digest->context.md5);
+            break;
+        case CPMDigestSHA1:
+            CC_SHA1_Init(&digest->context.sha1);
+            break;
+        case CPMDigestSHA256:
+            CC_SHA256_Init(&digest->context.sha256);
+            break;
+    }
+}
+
+static void digestUpdate(CPMDigest *digest, const void *bytes, size_t length) {
+    switch (digest->algorithm) {
+        case CPMDigestMD5:
+            CC_MD5_Update(&digest->context.md5, bytes, (CC_LONG)length);
+            break;
+        case CPMDigestSHA1:
+            CC_SHA1_Update(&digest->context.sha1, bytes, (CC_LONG)length);
+            break;
+        case CPMDigestSHA256:
+            CC_SHA256_Update(&digest->context.sha256, bytes, (CC_LONG)length);
+            break;
+    }
+}
+
+static NSString *digestFinal(CPMDigest *digest) {
+    unsigned char bytes[CC_SHA256_DIGEST_LENGTH];
+    NSUInteger length = 0;
+    switch (digest->algorithm) {
+        case CPMDigestMD5:
+            CC_MD5_Final(bytes, &digest->context.md5);
+            length = CC_MD5_DIGEST_LENGTH;
+            break;
+        case CPMDigestSHA1:
+            CC_SHA1_Final(bytes, &digest->context.sha1);
+            length = CC_SHA1_DIGEST_LENGTH;
+            break;
+        case CPMDigestSHA256:
+            CC_SHA256_Final(bytes, &digest->context.sha256);
+            length = CC_SHA256_DIGEST_LENGTH;
+            break;
+    }
+
+    NSMutableString *hex = [NSMutableString stringWithCapacity:length * 2];
+    for (NSUInteger i = 0; i < length; i++) {
+        [hex appendFormat:@"%02x", bytes[i]];
+    }
+
+    return hex;
+}
+
+static NSError *downloadError(NSString *reason, NSDictionary *package) {
+    return [NSError errorWithDomain:CPMERRORDOMAIN
+                               code:CPMErrorInvalidFormat
+                           userInfo:@{
+                                      NSLocalizedFailureReasonErrorKey: reason,
+                                      CPMErrorPackageKey: package[@"package"] ?: @""
+                                      }];
+}
+
+#pragma mark - Download
+
+// One archive on its way into the cache
+@interface CPMPackageDownload : NSObject {
+@public
+    CPMDigest _digest;
+    FILE *_file;
+}
+@property (strong) NSDictionary *package;
+@property (strong) NSURL *url;
+@property (assign) CPMDigestAlgorithm algorithm;
+@property (copy) NSString *checksum;
+@property (copy) NSString *partialPath;
+@property (copy) NSString *path;
+@property (assign) NSUInteger attempts;
+@property (strong) NSMutableArray *completions;
+@end
+
+@implementation CPMPackageDownload
+
+- (void)dealloc {
+    if (_file)
+        fclose(_file);
+}
+
+@end
+
+#pragma mark - Downloader
+
+@interface CPMPackageDownloader ()
+@property (readwrite, copy) NSString *cachePath;
+@property (strong) NSMutableDictionary *downloads;
+- (CPMPackageDownload *)downloadForPackage:(NSDictionary *)package error:(NSError **)error;
+- (void)startDownload:(CPMPackageDownload *)download progress:(void (^)(NSDictionary *, int64_t, int64_t))progress;
+- (void)finishDownload:(CPMPackageDownload *)download error:(NSError *)error;
+@end
+
+@implementation CPMPackageDownloader
+
++ (instancetype)sharedDownloader {
+    static CPMPackageDownloader *downloader = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        downloader = [[self alloc] initWithCachePath:[LOCALSTORAGE_PATH stringByAppendingPathComponent:@"archives"]];
+    });
+
+    return downloader;
+}
+
+- (instancetype)initWithCachePath:(NSString *)path {
+    if ((self = [super init])) {
+        self.cachePath = path;
+        self.retryCount = 2;
+        self.downloads = [NSMutableDictionary dictionary];
+
+        [[NSFileManager defaultManager] createDirectoryAtPath:[path stringByAppendingPathComponent:@"partial"]
+                                  withIntermediateDirectories:YES
+                                                   attributes:nil
+                                                        error:nil];
+    }
+
+    return self;
+}
+
+// The strongest checksum the repository gave us decides the cache key
+- (CPMPackageDownload *)downloadForPackage:(NSDictionary *)package error:(NSError **)error {
+    CPMPackageDownload *download = [[CPMPackageDownload alloc] init];
+    download.package = package;
+
+    NSString *name = nil;
+    if ([package[@"sha256"] length]) {
+        download.algorithm = CPMDigestSHA256;
+        download.checksum = package[@"sha256"];
+        name = @"sha256";
+    } else if ([package[@"sha1"] length]) {
+        download.algorithm = CPMDigestSHA1;
+        download.checksum = package[@"sha1"];
+        name = @"sha1";
+    } else if ([package[@"md5sum"] length]) {
+        download.algorithm = CPMDigestMD5;
+        download.checksum = package[@"md5sum"];
+        name = @"md5";
+    } else {
+        if (error)
+            *error = downloadError([NSString stringWithFormat:@"%@ has no checksum to verify it with", package[@"package"]], package);
+        return nil;
+    }
+
+    download.checksum = download.checksum.lowercaseString;
+    NSString *file = [NSString stringWithFormat:@"%@-%@.deb", name, download.checksum];
+    download.path = [self.cachePath stringByAppendingPathComponent:file];
+    download.partialPath = [[self.cachePath stringByAppendingPathComponent:@"partial"] stringByAppendingPathComponent:file];
+
+    download.url = package[@"url"];
+    if (!download.url && package[@"repo"] && [package[@"filename"] length]) {
+        download.url = [package[@"repo"] URLByAppendingPathComponent:package[@"filename"]];
+    }
+
+    if (!download.url) {
+        if (error)
+            *error = downloadError([NSString stringWithFormat:@"%@ has no file to download", package[@"package"]], package);
+        return nil;
+    }
+
+    return download;
+}
+
+- (NSString *)cachedPathForPackage:(NSDictionary *)package {
+    NSString *path = [self downloadForPackage:package error:nil].path;
+    return [[NSFileManager defaultManager] fileExistsAtPath:path] ? path : nil;
+}
+
+- (void)downloadPackages:(NSArray *)packages
+                progress:(void (^)(NSDictionary *package, int64_t bytesDownloaded, int64_t bytesExpected))progress
+              completion:(void (^)(NSDictionary *paths, NSError *error))completion {
+    NSMutableDictionary *paths = [NSMutableDictionary dictionary];
+    __block NSError *firstError = nil;
+    dispatch_group_t group = dispatch_group_create();
+
+    for (NSDictionary *package in packages) {
+        NSError *error = nil;
+        CPMPackageDownload *download = [self downloadForPackage:package error:&error];
+        if (!download) {
+            @synchronized (paths) {
+                firstError = firstError ?: error;
+            }
+            continue;
+        }
+
+        NSString *identifier = package[@"package"] ?: download.path.lastPathComponent;
+        if ([[NSFileManager defaultManager] fileExistsAtPath:download.path]) {
+            @synchronized (paths) {
+                paths[identifier] = download.path;
+            }
+            continue;
+        }
+
+        dispatch_group_enter(group);
+        void (^finished)(NSString *, NSError *) = ^(NSString *path, NSError *error) {
+            @synchronized (paths) {
+                if (path)
+                    paths[identifier] = path;
+                else if (!firstError)
+                    firstError = error;
+            }
+            dispatch_group_leave(group);
+        };
+
+        // the same archive may already be on its way for someone else
+        BOOL start = NO;
+        @synchronized (self.downloads) {
+            CPMPackageDownload *existing = self.downloads[download.path];
+            if (existing) {
+                [existing.completions addObject:finished];
+            } else {
+                download.completions = [NSMutableArray arrayWithObject:finished];
+                self.downloads[download.path] = download;
+                start = YES;
+            }
+        }
+
+        if (start)
+            [self startDownload:download progress:progress];
+    }
+
+    dispatch_group_notify(group, dispatch_get_main_queue(), ^{
+        NSDictionary *result = nil;
+        NSError *error = nil;
+        @synchronized (paths) {
+            result = [paths copy];
+            error = firstError;
+        }
+        completion(error ? nil : result, error);
+    });
+}
+
+// Resumes from whatever is in the partial file. Only those bytes are read
+// back to seed the hash; everything new is hashed as it is written.
+- (void)startDownload:(CPMPackageDownload *)download progress:(void (^)(NSDictionary *, int64_t, int64_t))progress {
+    digestInit(&download->_digest, download.algorithm);
+
+    __block int64_t offset = 0;
+    FILE *existing = fopen(download.partialPath.fileSystemRepresentation, "rb");
+    if (existing) {
+        char buffer[64 * 1024];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), existing)) > 0) {
+            digestUpdate(&download->_digest, buffer, read);
+            offset += read;
+        }
+        fclose(existing);
+    }
+
+    CPMCurler *curl = [[CPMCurler alloc] initWithURL:download.url dataBlock:nil completionBlock:nil];
+    curl.accumulatesData = NO;
+    if (offset > 0) {
+        curl.requestHeaders = @{ @"Range": [NSString stringWithFormat:@"bytes=%lld-", offset] };
+    }
+
+    __weak CPMCurler *weakCurl = curl;
+    __block BOOL writeFailed = NO;
+    curl.dataBlock = ^(NSInteger bytesDownloaded, NSInteger bytesExpected, NSData *data) {
+        if (!download->_file) {
+            // anything but a partial answer is the whole file again
+            if (weakCurl.response.statusCode != 206) {
+                offset = 0;
+                digestInit(&download->_digest, download.algorithm);
+                download->_file = fopen(download.partialPath.fileSystemRepresentation, "wb");
+            } else {
+                download->_file = fopen(download.partialPath.fileSystemRepresentation, "ab");
+            }
+        }
+
+        if (!download->_file || fwrite(data.bytes, 1, data.length, download->_file) != data.length) {
+            if (!writeFailed) {
+                writeFailed = YES;
+                [weakCurl cancel];
+            }
+            return;
+        }
+
+        digestUpdate(&download->_digest, data.bytes, data.length);
+
+        if (progress)
+            progress(download.package, offset + bytesDownloaded, bytesExpected >= 0 ? offset + bytesExpected : -1);
+    };
+
+    curl.completionBlock = ^{
+        if (download->_file) {
+            fclose(download->_file);
+            download->_file = NULL;
+        }
+
+        if (writeFailed) {
+            [self finishDownload:download error:downloadError(@"Could not write the downloaded archive to disk", download.package)];
+            return;
+        }
+
+        NSError *error = weakCurl.error;
+        if (error) {
+            // the server can't resume from what we have, so it is useless
+            if ([error.userInfo[CPMErrorStatusCodeKey] integerValue] == 416) {
+                [[NSFileManager defaultManager] removeItemAtPath:download.partialPath error:nil];
+            }
+
+            if (download.attempts++ < self.retryCount) {
+                [self startDownload:download progress:progress];
+            } else {
+                [self finishDownload:download error:error];
+            }
+            return;
+        }
+
+        NSString *checksum = digestFinal(&download->_digest);
+        // the index hands out strings, a repository row numbers
+        long long size = [download.package[@"size"] longLongValue];
+        int64_t length = [[[NSFileManager defaultManager] attributesOfItemAtPath:download.partialPath error:nil] fileSize];
+
+        if (![checksum isEqualToString:download.checksum] || (size > 0 && size != length)) {
+            [[NSFileManager defaultManager] removeItemAtPath:download.partialPath error:nil];
+            [self finishDownload:download error:downloadError([NSString stringWithFormat:@"%@ does not match its checksum", download.package[@"package"]], download.package)];
+            return;
+        }
+
+        NSError *moveError = nil;
+        [[NSFileManager defaultManager] removeItemAtPath:download.path error:nil];
+        [[NSFileManager defaultManager] moveItemAtPath:download.partialPath toPath:download.path error:&moveError];
+        [self finishDownload:download error:moveError];
+    };
+
+    [[CPMDownloadScheduler sharedScheduler] addCurler:curl];
+}
+
+- (void)finishDownload:(CPMPackageDownload *)download error:(NSError *)error {
+    NSArray *completions = nil;
+    @synchronized (self.downloads) {
+        completions = download.completions;
+        [self.downloads removeObjectForKey:download.path];
+    }
+
+    for (void (^completion)(NSString *, NSError *) in completions) {
+        completion(error ? nil : download.path, error);
+    }
+}
+
+@end
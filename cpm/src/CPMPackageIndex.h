@@ -0,0 +1,80 @@
+//
+//  CPMPackageIndex.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class CPMRepository;
+
+// Compact tag for the repository a package came from, see -repositoryForOrigin:
+typedef uint16_t CPMPackageOrigin;
+
+// The columns of the packages table the index keeps
+typedef NS_ENUM(NSUInteger, CPMPackageIndexField) {
+    CPMPackageIndexFieldPackage = 0,
+    CPMPackageIndexFieldVersion,
+    CPMPackageIndexFieldArchitecture,
+    CPMPackageIndexFieldFilename,
+    CPMPackageIndexFieldSize,
+    CPMPackageIndexFieldDepends,
+    CPMPackageIndexFieldSection,
+    CPMPackageIndexFieldName,
+    CPMPackageIndexFieldSHA256,
+    CPMPackageIndexFieldPreDepends,
+    CPMPackageIndexFieldBreaks,
+    CPMPackageIndexFieldConflicts,
+    CPMPackageIndexFieldProvides,
+    CPMPackageIndexFieldReplaces,
+    CPMPackageIndexFieldCount
+};
+
+// One version of a package in one repository. Missing fields are empty
+// strings, never NULL. The strings are only valid during the enumeration.
+typedef struct {
+    CPMPackageOrigin origin;
+    const char *values[CPMPackageIndexFieldCount];
+} CPMPackageCandidate;
+
+// Every package of every repository in a single table, for the lookups by
+// identifier that dependency resolution and upgrade checks make by the
+// thousand.
+//
+// Each repository is loaded from its database into its own segment, stored
+// column by column as offsets into a pool of interned strings. When one
+// repository refreshes only its segment is read again; the identifier hash
+// over all segments, and the one over the virtual packages named in Provides,
+// are rebuilt from hashes computed at load time. Lookups never touch SQLite
+// and are safe from any thread.
+@interface CPMPackageIndex : NSObject
+@property (readonly, assign) NSUInteger count;
+
+// Registers a repository; its packages are loaded on the next lookup.
+- (CPMPackageOrigin)addRepository:(CPMRepository *)repository;
+- (void)removeRepository:(CPMRepository *)repository;
+- (CPMRepository *)repositoryForOrigin:(CPMPackageOrigin)origin;
+
+// Marks a repository's segment stale so the next lookup reloads it.
+- (void)invalidateRepository:(CPMRepository *)repository;
+// Reloads every stale segment now instead of on the next lookup.
+- (void)reloadStaleRepositories;
+
+// Calls the block with every version of the package in every repository,
+// in repository order. Returns the number of candidates visited.
+- (NSUInteger)enumerateCandidatesForIdentifier:(const char *)identifier usingBlock:(void (^)(const CPMPackageCandidate *candidate, BOOL *stop))block;
+
+// Calls the block with every package that lists the identifier under
+// Provides, along with the version it provides (empty if unversioned).
+- (NSUInteger)enumerateProvidersOfIdentifier:(const char *)identifier usingBlock:(void (^)(const CPMPackageCandidate *candidate, const char *providedVersion, BOOL *stop))block;
+
+// A candidate boxed the same way as -candidatesForIdentifier: does it.
+- (NSDictionary *)dictionaryForCandidate:(const CPMPackageCandidate *)candidate;
+
+// Candidates boxed into dictionaries keyed by column name, with the
+// repository's url under "repo".
+- (NSArray *)candidatesForIdentifier:(NSString *)identifier;
+
+@end
@@ -0,0 +1,509 @@
+//
+//  CPMPackageIndex.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMPackageIndex.h"
+#import "CPMRepository.h"
+#import "relationship.h"
+#import "strpool.h"
+#import <sqlite3.h>
+
+// packages table columns, in CPMPackageIndexField order
+static const char *CPMPackageIndexColumns[CPMPackageIndexFieldCount] = {
+    "package", "version", "architecture", "filename", "size", "depends", "section", "name", "sha256",
+    "pre_depends", "breaks", "conflicts", "provides", "replaces"
+};
+
+static size_t tableSizeFor(size_t count) {
+    size_t size = 16;
+    while (size < count * 2)
+        size <<= 1;
+
+    return size;
+}
+
+#pragma mark - Segment
+
+// The packages of one repository. Immutable once loaded.
+@interface CPMPackageIndexSegment : NSObject {
+@public
+    CPMPackageOrigin _origin;
+    uint32_t _count;
+
+    CPMStringPool _strings;
+
+    // one array of string ids per field
+    uint32_t *_fields[CPMPackageIndexFieldCount];
+    // hash of each row's identifier
+    uint32_t *_hashes;
+
+    // every (virtual package, version) named in a Provides field, and its row
+    uint32_t _providedCount;
+    uint32_t *_provided;
+    uint32_t *_providedVersion;
+    uint32_t *_providedRow;
+    uint32_t *_providedHashes;
+}
+- (instancetype)initWithDatabase:(FMDatabase *)db origin:(CPMPackageOrigin)origin condition:(NSString *)condition;
+- (void)addProvidesOfRow:(uint32_t)row;
+@end
+
+@implementation CPMPackageIndexSegment
+
+- (instancetype)initWithDatabase:(FMDatabase *)db origin:(CPMPackageOrigin)origin condition:(NSString *)condition {
+    if ((self = [super init])) {
+        _origin = origin;
+        CPMStringPoolInit(&_strings);
+
+        NSMutableArray *columns = [NSMutableArray array];
+        for (int i = 0; i < CPMPackageIndexFieldCount; i++) {
+            [columns addObject:@(CPMPackageIndexColumns[i])];
+        }
+        NSString *query = [NSString stringWithFormat:@"select %@ from packages where %@", [columns componentsJoinedByString:@", "], condition ?: @"1"];
+
+        // straight through the sqlite api so no column is ever boxed
+        sqlite3_stmt *statement = NULL;
+        if (sqlite3_prepare_v2(db.sqliteHandle, query.UTF8String, -1, &statement, NULL) != SQLITE_OK) {
+            NSLog(@"could not index packages: %s", sqlite3_errmsg(db.sqliteHandle));
+            statement = NULL;
+        }
+
+        size_t capacity = 0;
+        while (statement && sqlite3_step(statement) == SQLITE_ROW) {
+            if (_count == capacity) {
+                capacity = MAX(capacity * 2, 1024);
+                for (int i = 0; i < CPMPackageIndexFieldCount; i++) {
+                    _fields[i] = realloc(_fields[i], capacity * sizeof(uint32_t));
+                }
+                _hashes = realloc(_hashes, capacity * sizeof(uint32_t));
+            }
+
+            for (int i = 0; i < CPMPackageIndexFieldCount; i++) {
+                const char *text = (const char *)sqlite3_column_text(statement, i);
+                size_t length = text ? (size_t)sqlite3_column_bytes(statement, i) : 0;
+                uint32_t hash = CPMStringHash(text, length);
+
+                _fields[i][_count] = CPMStringPoolIntern(&_strings, text, length, hash);
+                if (i == CPMPackageIndexFieldPackage)
+                    _hashes[_count] = hash;
+            }
+
+            [self addProvidesOfRow:_count];
+            _count++;
+        }
+        sqlite3_finalize(statement);
+
+        CPMStringPoolSeal(&_strings);
+    }
+
+    return self;
+}
+
+- (void)addProvidesOfRow:(uint32_t)row {
+    const char *provides = CPMStringPoolString(&_strings, _fields[CPMPackageIndexFieldProvides][row]);
+    if (!*provides)
+        return;
+
+    // interning may move the pool, so the field is copied out first
+    size_t length = strlen(provides);
+    char *field = malloc(length + 1);
+    memcpy(field, provides, length + 1);
+
+    CPMRelation relations[16];
+    size_t count = CPMRelationParse(field, length, NULL, relations, 16);
+    CPMRelation *all = relations;
+    if (count > 16) {
+        all = malloc(count * sizeof(CPMRelation));
+        CPMRelationParse(field, length, NULL, all, count);
+    }
+
+    _provided = realloc(_provided, (_providedCount + count) * sizeof(uint32_t));
+    _providedVersion = realloc(_providedVersion, (_providedCount + count) * sizeof(uint32_t));
+    _providedRow = realloc(_providedRow, (_providedCount + count) * sizeof(uint32_t));
+    _providedHashes = realloc(_providedHashes, (_providedCount + count) * sizeof(uint32_t));
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t hash = CPMStringHash(all[i].name, all[i].nameLength);
+        _provided[_providedCount] = CPMStringPoolIntern(&_strings, all[i].name, all[i].nameLength, hash);
+        _providedVersion[_providedCount] = CPMStringPoolIntern(&_strings, all[i].version, all[i].versionLength, CPMStringHash(all[i].version, all[i].versionLength));
+        _providedRow[_providedCount] = row;
+        _providedHashes[_providedCount] = hash;
+        _providedCount++;
+    }
+
+    if (all != relations)
+        free(all);
+    free(field);
+}
+
+- (void)dealloc {
+    CPMStringPoolFree(&_strings);
+    free(_hashes);
+    free(_provided);
+    free(_providedVersion);
+    free(_providedRow);
+    free(_providedHashes);
+    for (int i = 0; i < CPMPackageIndexFieldCount; i++) {
+        free(_fields[i]);
+    }
+}
+
+@end
+
+#pragma mark - Table
+
+// A multimap from a name to (segment, item) pairs. Items with the same name
+// are stored next to each other as a group.
+typedef struct {
+    uint32_t *slots; // group index + 1, 0 for an empty slot
+    size_t size;
+
+    uint32_t groupCount;
+    uint32_t *groupStart;
+    uint32_t *groupLength;
+    uint32_t *groupHash;
+    const char **groupKey;
+
+    uint32_t count;
+    uint16_t *entrySegment;
+    uint32_t *entryItem;
+} CPMPackageIndexMap;
+
+// Items are rows for the identifier map and entries of the segment's
+// provided arrays for the provides map.
+static const char *mapKey(CPMPackageIndexSegment *segment, uint32_t item, BOOL provides) {
+    return CPMStringPoolString(&segment->_strings, provides ? segment->_provided[item] : segment->_fields[CPMPackageIndexFieldPackage][item]);
+}
+
+static uint32_t mapGroup(const CPMPackageIndexMap *map, const char *key, size_t length, uint32_t hash) {
+    size_t slot = hash & (map->size - 1);
+    while (map->slots[slot]) {
+        uint32_t group = map->slots[slot] - 1;
+        if (map->groupHash[group] == hash && !strncmp(map->groupKey[group], key, length) && map->groupKey[group][length] == '\0')
+            return group;
+        slot = (slot + 1) & (map->size - 1);
+    }
+
+    return UINT32_MAX;
+}
+
+static void mapBuild(CPMPackageIndexMap *map, NSArray *segments, BOOL provides) {
+    map->count = 0;
+    for (CPMPackageIndexSegment *segment in segments) {
+        map->count += provides ? segment->_providedCount : segment->_count;
+    }
+
+    size_t capacity = MAX(map->count, 1);
+    map->size = tableSizeFor(map->count);
+    map->slots = calloc(map->size, sizeof(uint32_t));
+    map->groupCount = 0;
+    map->groupStart = malloc(capacity * sizeof(uint32_t));
+    map->groupLength = calloc(capacity, sizeof(uint32_t));
+    map->groupHash = malloc(capacity * sizeof(uint32_t));
+    map->groupKey = malloc(capacity * sizeof(const char *));
+    map->entrySegment = malloc(capacity * sizeof(uint16_t));
+    map->entryItem = malloc(capacity * sizeof(uint32_t));
+    uint32_t *entryGroup = malloc(capacity * sizeof(uint32_t));
+
+    // first pass: find or create every item's group and count its members
+    uint32_t entry = 0;
+    for (CPMPackageIndexSegment *segment in segments) {
+        uint32_t items = provides ? segment->_providedCount : segment->_count;
+        for (uint32_t item = 0; item < items; item++) {
+            const char *key = mapKey(segment, item, provides);
+            uint32_t hash = provides ? segment->_providedHashes[item] : segment->_hashes[item];
+            uint32_t group = mapGroup(map, key, strlen(key), hash);
+
+            if (group == UINT32_MAX) {
+                group = map->groupCount++;
+                map->groupHash[group] = hash;
+                map->groupKey[group] = key;
+
+                size_t slot = hash & (map->size - 1);
+                while (map->slots[slot])
+                    slot = (slot + 1) & (map->size - 1);
+                map->slots[slot] = group + 1;
+            }
+
+            map->groupLength[group]++;
+            entryGroup[entry++] = group;
+        }
+    }
+
+    // second pass: lay the groups out back to back, in segment order
+    uint32_t offset = 0;
+    for (uint32_t group = 0; group < map->groupCount; group++) {
+        map->groupStart[group] = offset;
+        offset += map->groupLength[group];
+    }
+
+    uint32_t *fill = calloc(MAX(map->groupCount, 1), sizeof(uint32_t));
+    entry = 0;
+    for (NSUInteger s = 0; s < segments.count; s++) {
+        CPMPackageIndexSegment *segment = segments[s];
+        uint32_t items = provides ? segment->_providedCount : segment->_count;
+        for (uint32_t item = 0; item < items; item++) {
+            uint32_t group = entryGroup[entry++];
+            uint32_t position = map->groupStart[group] + fill[group]++;
+            map->entrySegment[position] = (uint16_t)s;
+            map->entryItem[position] = item;
+        }
+    }
+
+    free(fill);
+    free(entryGroup);
+}
+
+static void mapFree(CPMPackageIndexMap *map) {
+    free(map->slots);
+    free(map->groupStart);
+    free(map->groupLength);
+    free(map->groupHash);
+    free(map->groupKey);
+    free(map->entrySegment);
+    free(map->entryItem);
+}
+
+// The lookup maps over a set of segments. Immutable once built, so a lookup
+// keeps using the table it started with while a new one is built.
+@interface CPMPackageIndexTable : NSObject {
+@public
+    NSArray *_segments;
+    CPMPackageIndexMap _packages;
+    CPMPackageIndexMap _provides;
+}
+- (instancetype)initWithSegments:(NSArray *)segments;
+@end
+
+@implementation CPMPackageIndexTable
+
+- (instancetype)initWithSegments:(NSArray *)segments {
+    if ((self = [super init])) {
+        _segments = [segments copy];
+        mapBuild(&_packages, _segments, NO);
+        mapBuild(&_provides, _segments, YES);
+    }
+
+    return self;
+}
+
+- (void)dealloc {
+    mapFree(&_packages);
+    mapFree(&_provides);
+}
+
+@end
+
+static void fillCandidate(CPMPackageCandidate *candidate, CPMPackageIndexSegment *segment, uint32_t row) {
+    candidate->origin = segment->_origin;
+    for (int f = 0; f < CPMPackageIndexFieldCount; f++) {
+        candidate->values[f] = CPMStringPoolString(&segment->_strings, segment->_fields[f][row]);
+    }
+}
+
+#pragma mark - Index
+
+@interface CPMPackageIndex ()
+@property (strong) NSMutableArray *repositories;
+@property (strong) NSMutableDictionary *segments;
+@property (strong) NSMutableIndexSet *staleOrigins;
+@property (strong) NSLock *reloadLock;
+@property (strong) CPMPackageIndexTable *table;
+- (CPMPackageIndexTable *)currentTable;
+@end
+
+@implementation CPMPackageIndex
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        self.repositories = [NSMutableArray array];
+        self.segments = [NSMutableDictionary dictionary];
+        self.staleOrigins = [NSMutableIndexSet indexSet];
+        self.reloadLock = [[NSLock alloc] init];
+        self.table = [[CPMPackageIndexTable alloc] initWithSegments:@[]];
+    }
+
+    return self;
+}
+
+- (NSUInteger)count {
+    return self.currentTable->_packages.count;
+}
+
+- (CPMPackageOrigin)addRepository:(CPMRepository *)repository {
+    @synchronized (self) {
+        NSUInteger origin = [self.repositories indexOfObject:[NSNull null]];
+        if (origin == NSNotFound) {
+            origin = self.repositories.count;
+            [self.repositories addObject:repository];
+        } else {
+            self.repositories[origin] = repository;
+        }
+
+        NSAssert(origin <= UINT16_MAX, @"too many repositories for the package index");
+        [self.staleOrigins addIndex:origin];
+        return (CPMPackageOrigin)origin;
+    }
+}
+
+- (void)removeRepository:(CPMRepository *)repository {
+    @synchronized (self) {
+        NSUInteger origin = [self.repositories indexOfObjectIdenticalTo:repository];
+        if (origin == NSNotFound)
+            return;
+
+        self.repositories[origin] = [NSNull null];
+        [self.segments removeObjectForKey:@(origin)];
+        [self.staleOrigins addIndex:origin];
+    }
+}
+
+- (CPMRepository *)repositoryForOrigin:(CPMPackageOrigin)origin {
+    @synchronized (self) {
+        if (origin >= self.repositories.count || self.repositories[origin] == [NSNull null])
+            return nil;
+
+        return self.repositories[origin];
+    }
+}
+
+- (void)invalidateRepository:(CPMRepository *)repository {
+    @synchronized (self) {
+        NSUInteger origin = [self.repositories indexOfObjectIdenticalTo:repository];
+        if (origin != NSNotFound)
+            [self.staleOrigins addIndex:origin];
+    }
+}
+
+- (void)reloadStaleRepositories {
+    // one reload at a time; whoever waited here finds the work already done
+    [self.reloadLock lock];
+
+    NSIndexSet *stale = nil;
+    @synchronized (self) {
+        stale = [self.staleOrigins copy];
+        [self.staleOrigins removeAllIndexes];
+    }
+
+    if (stale.count) {
+        [stale enumerateIndexesUsingBlock:^(NSUInteger origin, BOOL *stop) {
+            CPMRepository *repository = [self repositoryForOrigin:(CPMPackageOrigin)origin];
+            if (!repository)
+                return;
+
+            __block CPMPackageIndexSegment *segment = nil;
+            [repository.readerPool inDatabase:^(FMDatabase *db) {
+                segment = [[CPMPackageIndexSegment alloc] initWithDatabase:db origin:(CPMPackageOrigin)origin condition:repository.architectureCondition];
+            }];
+
+            @synchronized (self) {
+                // it may have been removed while we were reading it
+                if (self.repositories[origin] == repository)
+                    self.segments[@(origin)] = segment;
+            }
+        }];
+
+        NSArray *segments = nil;
+        @synchronized (self) {
+            segments = [self.segments.allKeys sortedArrayUsingSelector:@selector(compare:)];
+            segments = [self.segments objectsForKeys:segments notFoundMarker:[NSNull null]];
+        }
+
+        CPMPackageIndexTable *table = [[CPMPackageIndexTable alloc] initWithSegments:segments];
+        @synchronized (self) {
+            self.table = table;
+        }
+    }
+
+    [self.reloadLock unlock];
+}
+
+- (CPMPackageIndexTable *)currentTable {
+    BOOL stale = NO;
+    @synchronized (self) {
+        stale = self.staleOrigins.count > 0;
+    }
+
+    if (stale)
+        [self reloadStaleRepositories];
+
+    @synchronized (self) {
+        return self.table;
+    }
+}
+
+- (NSUInteger)enumerateCandidatesForIdentifier:(const char *)identifier usingBlock:(void (^)(const CPMPackageCandidate *candidate, BOOL *stop))block {
+    CPMPackageIndexTable *table = self.currentTable;
+    const CPMPackageIndexMap *map = &table->_packages;
+    size_t length = strlen(identifier);
+    uint32_t group = mapGroup(map, identifier, length, CPMStringHash(identifier, length));
+    if (group == UINT32_MAX)
+        return 0;
+
+    NSUInteger visited = 0;
+    BOOL stop = NO;
+    uint32_t start = map->groupStart[group];
+    for (uint32_t i = start; i < start + map->groupLength[group] && !stop; i++) {
+        CPMPackageCandidate candidate;
+        fillCandidate(&candidate, table->_segments[map->entrySegment[i]], map->entryItem[i]);
+
+        visited++;
+        block(&candidate, &stop);
+    }
+
+    return visited;
+}
+
+- (NSUInteger)enumerateProvidersOfIdentifier:(const char *)identifier usingBlock:(void (^)(const CPMPackageCandidate *candidate, const char *providedVersion, BOOL *stop))block {
+    CPMPackageIndexTable *table = self.currentTable;
+    const CPMPackageIndexMap *map = &table->_provides;
+    size_t length = strlen(identifier);
+    uint32_t group = mapGroup(map, identifier, length, CPMStringHash(identifier, length));
+    if (group == UINT32_MAX)
+        return 0;
+
+    NSUInteger visited = 0;
+    BOOL stop = NO;
+    uint32_t start = map->groupStart[group];
+    for (uint32_t i = start; i < start + map->groupLength[group] && !stop; i++) {
+        CPMPackageIndexSegment *segment = table->_segments[map->entrySegment[i]];
+        uint32_t item = map->entryItem[i];
+
+        CPMPackageCandidate candidate;
+        fillCandidate(&candidate, segment, segment->_providedRow[item]);
+
+        visited++;
+        block(&candidate, CPMStringPoolString(&segment->_strings, segment->_providedVersion[item]), &stop);
+    }
+
+    return visited;
+}
+
+- (NSDictionary *)dictionaryForCandidate:(const CPMPackageCandidate *)candidate {
+    NSMutableDictionary *package = [NSMutableDictionary dictionary];
+    for (int f = 0; f < CPMPackageIndexFieldCount; f++) {
+        if (*candidate->values[f])
+            package[@(CPMPackageIndexColumns[f])] = @(candidate->values[f]);
+    }
+
+    NSURL *url = [self repositoryForOrigin:candidate->origin].url;
+    if (url)
+        package[@"repo"] = url;
+
+    return package;
+}
+
+- (NSArray *)candidatesForIdentifier:(NSString *)identifier {
+    NSMutableArray *candidates = [NSMutableArray array];
+    [self enumerateCandidatesForIdentifier:identifier.UTF8String usingBlock:^(const CPMPackageCandidate *candidate, BOOL *stop) {
+        [candidates addObject:[self dictionaryForCandidate:candidate]];
+    }];
+
+    return candidates;
+}
+
+@end
@@ -48,6 +48,10 @@ typedef void (^CPMPackageManagerPackagesForIdentifiersCompletion)(NSDictionary *
 // Prefix used to make the package manager compatible with others.
 - (NSString *)packageIdentifierPrefix;
 
+// Whether the identifier could name one of its packages at all. Identifiers it
+// can't own are never passed to packagesForIdentifiers:completion:.
+- (BOOL)canOwnPackageIdentifier:(NSString *)identifier;
+
 // Whether it supports installing to a prefix (e.g., home directory).
 - (BOOL)isPrefixCompatible;
 
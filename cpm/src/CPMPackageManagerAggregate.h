@@ -16,7 +16,12 @@ typedef void (^CPMPackageManagerAggregateRefreshCompletion)(NSArray *errors);
 + (instancetype)sharedInstance;
 
 - (NSArray *)installedPackages;
+// The progress' userInfo carries what the package managers report as they go, such as
+// CPMDpkgPackageManagerRefreshMetricsKey.
 - (NSProgress *)refreshWithCompletion:(CPMPackageManagerAggregateRefreshCompletion)completion;
+// Package objects come from a cache per package manager that is emptied when it refreshes.
+// Lookups the cache can't answer are gathered for a moment and sent to each package manager
+// as one batch. The completion is called on the main queue once every package manager answered.
 - (void)packagesForIdentifiers:(NSArray *)identifiers completion:(CPMPackageManagerPackagesForIdentifiersCompletion)completion;
 - (NSProgress *)package:(id <CPMPackage>)package performOperation:(CPMPackageManagerOperation)operation stateChangeCallback:(CPMPackageManagerStateChangeCallback)stateChangeCallback;
 
@@ -9,9 +9,24 @@
 #import "CPMPackageManagerAggregate.h"
 #import "CPMHomebrewPackageManager.h"
 #import "CPMDpkgPackageManager.h"
+#import "CPMPackageCache.h"
+
+// lookups arriving within this long of each other go to the package managers as one batch
+static const NSTimeInterval kCPMPackageManagerAggregateBatchWindow = 0.02;
+
+static const NSUInteger kCPMPackageManagerAggregateCacheCapacity = 2048;
+static const NSTimeInterval kCPMPackageManagerAggregateCacheTimeToLive = 5 * 60;
 
 @implementation CPMPackageManagerAggregate {
 	NSArray *_packageManagers;
+	
+	// one per package manager, in the same order
+	NSArray *_caches;
+	
+	// requests waiting for the next batch, only touched on _batchQueue
+	dispatch_queue_t _batchQueue;
+	NSMutableArray *_pendingRequests;
+	BOOL _flushScheduled;
 }
 
 + (instancetype)sharedInstance {
@@ -32,6 +47,16 @@
 			[[CPMHomebrewPackageManager alloc] init],
 			[[CPMDpkgPackageManager alloc] init]
 		];
+		
+		NSMutableArray *caches = [NSMutableArray array];
+		
+		for (NSUInteger i = 0; i < _packageManagers.count; i++) {
+			[caches addObject:[[CPMPackageCache alloc] initWithCapacity:kCPMPackageManagerAggregateCacheCapacity timeToLive:kCPMPackageManagerAggregateCacheTimeToLive]];
+		}
+		
+		_caches = caches;
+		_batchQueue = dispatch_queue_create("com.chariz.cpm.packagebatch", DISPATCH_QUEUE_SERIAL);
+		_pendingRequests = [NSMutableArray array];
 	}
 	
 	return self;
@@ -59,7 +84,12 @@
 			dispatch_async(queue, ^{
 				[progress becomeCurrentWithPendingUnitCount:100];
 				
+				CPMPackageCache *cache = _caches[[_packageManagers indexOfObject:packageManager]];
+				
 				[packageManager refreshWithParentProgress:progress completion:^(NSError *error) {
+					// whatever was cached may have changed
+					[cache removeAllObjects];
+					
 					if (error) {
 						[errors addObject:error];
 					}
@@ -78,41 +108,127 @@
 }
 
 - (void)packagesForIdentifiers:(NSArray *)identifiers completion:(CPMPackageManagerPackagesForIdentifiersCompletion)completion {
-	dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+	NSMutableDictionary *packages = [NSMutableDictionary dictionary];
 	
-	dispatch_async(queue, ^{
-		dispatch_group_t group = dispatch_group_create();
-		
-		NSMutableArray *errors = [NSMutableArray array];
-		NSMutableDictionary *finalPackages = [NSMutableDictionary dictionary];
+	if ([self _collectPackages:packages forIdentifiers:identifiers fetched:nil missing:nil]) {
+		dispatch_async(dispatch_get_main_queue(), ^{
+			completion(packages, nil);
+		});
+		return;
+	}
+	
+	dispatch_async(_batchQueue, ^{
+		[_pendingRequests addObject:@[ identifiers, [completion copy] ]];
 		
-		for (id <CPMPackageManager> packageManager in _packageManagers) {
-			dispatch_group_async(group, queue, ^{
-				[packageManager packagesForIdentifiers:identifiers completion:^(NSDictionary *packages, NSError *error) {
-					if (error) {
-						[errors addObject:error];
-						return;
-					}
-					
-					[finalPackages addEntriesFromDictionary:packages];
-				}];
+		if (!_flushScheduled) {
+			_flushScheduled = YES;
+			
+			dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kCPMPackageManagerAggregateBatchWindow * NSEC_PER_SEC)), _batchQueue, ^{
+				[self _flushPendingRequests];
 			});
 		}
+	});
+}
+
+// Fills in what each package manager knows about the identifiers, from the packages it just
+// fetched or else from its cache; later package managers win. Identifiers a manager has to be
+// asked about are added to its set in missing, unless it can't own them. Returns YES if
+// nothing is missing.
+- (BOOL)_collectPackages:(NSMutableDictionary *)packages forIdentifiers:(NSArray *)identifiers fetched:(NSArray *)fetched missing:(NSArray *)missing {
+	BOOL complete = YES;
+	
+	for (NSUInteger i = 0; i < _packageManagers.count; i++) {
+		id <CPMPackageManager> packageManager = _packageManagers[i];
+		BOOL filters = [packageManager respondsToSelector:@selector(canOwnPackageIdentifier:)];
+		CPMPackageCache *cache = _caches[i];
+		NSDictionary *found = fetched[i];
 		
-		dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
-		
-		dispatch_async(dispatch_get_main_queue(), ^{
-			NSError *error = nil;
+		for (NSString *identifier in identifiers) {
+			if (filters && ![packageManager canOwnPackageIdentifier:identifier]) {
+				continue;
+			}
+			
+			id package = found[identifier] ?: [cache objectForKey:identifier];
 			
-			if (errors.count == 1) {
-				error = errors[0];
-			} else if (errors.count > 1) {
-				// TODO: how should we report multiple errors?
-				error = errors[0];
+			if (!package) {
+				complete = NO;
+				[missing[i] addObject:identifier];
+			} else if (package != [NSNull null]) {
+				packages[identifier] = package;
+			}
+		}
+	}
+	
+	return complete;
+}
+
+- (void)_flushPendingRequests {
+	NSArray *requests = _pendingRequests;
+	_pendingRequests = [NSMutableArray array];
+	_flushScheduled = NO;
+	
+	NSMutableArray *missing = [NSMutableArray array];
+	NSMutableArray *fetched = [NSMutableArray array];
+	
+	for (NSUInteger i = 0; i < _packageManagers.count; i++) {
+		[missing addObject:[NSMutableSet set]];
+		[fetched addObject:[NSMutableDictionary dictionary]];
+	}
+	
+	for (NSArray *request in requests) {
+		[self _collectPackages:[NSMutableDictionary dictionary] forIdentifiers:request[0] fetched:nil missing:missing];
+	}
+	
+	// one call per package manager for everything the batch is missing
+	dispatch_group_t group = dispatch_group_create();
+	NSMutableArray *errors = [NSMutableArray array];
+	
+	for (NSUInteger i = 0; i < _packageManagers.count; i++) {
+		NSArray *identifiers = ((NSSet *)missing[i]).allObjects;
+		
+		if (!identifiers.count) {
+			continue;
+		}
+		
+		id <CPMPackageManager> packageManager = _packageManagers[i];
+		CPMPackageCache *cache = _caches[i];
+		NSMutableDictionary *found = fetched[i];
+		
+		dispatch_group_enter(group);
+		
+		[packageManager packagesForIdentifiers:identifiers completion:^(NSDictionary *packages, NSError *error) {
+			@synchronized (errors) {
+				if (error) {
+					[errors addObject:error];
+				}
+				
+				[found addEntriesFromDictionary:packages];
+				
+				// what failed is remembered as unknown too until the entry expires,
+				// or every lookup would ask again
+				for (NSString *identifier in identifiers) {
+					[cache setObject:packages[identifier] ?: [NSNull null] forKey:identifier];
+				}
 			}
 			
-			completion(finalPackages, error);
-		});
+			dispatch_group_leave(group);
+		}];
+	}
+	
+	dispatch_group_notify(group, _batchQueue, ^{
+		// TODO: how should we report multiple errors?
+		NSError *error = errors.firstObject;
+		
+		for (NSArray *request in requests) {
+			NSMutableDictionary *packages = [NSMutableDictionary dictionary];
+			[self _collectPackages:packages forIdentifiers:request[0] fetched:fetched missing:nil];
+			
+			CPMPackageManagerPackagesForIdentifiersCompletion completion = request[1];
+			
+			dispatch_async(dispatch_get_main_queue(), ^{
+				completion(packages, error);
+			});
+		}
 	});
 }
 
@@ -0,0 +1,27 @@
+//
+//  CPMPackagesDiff.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+// Brings a local copy of a Packages index up to date by applying the
+// incremental patches a repository publishes under Packages.diff/ ("PDiffs").
+@interface CPMPackagesDiff : NSObject
+@property (readonly, copy) NSURL *indexURL;
+@property (readonly, copy) NSString *localPath;
+
+// indexURL points at Packages.diff/Index, localPath at the uncompressed
+// Packages file from the last refresh.
+- (instancetype)initWithIndexURL:(NSURL *)indexURL localPath:(NSString *)localPath;
+
+// Calls back with the patched, uncompressed index. Fails if the local copy
+// isn't part of the published history, a patch doesn't apply, or the result
+// doesn't match the published hash; the caller should then download the
+// whole index instead.
+- (void)patchWithCompletion:(void (^)(NSData *patched, NSError *error))completion;
+
+@end
@@ -0,0 +1,202 @@
+//
+//  CPMPackagesDiff.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMPackagesDiff.h"
+#import "CPDefines.h"
+#import "CPMCurler.h"
+#import "CPMDownloadScheduler.h"
+#import "decompress.h"
+#import "pdiff.h"
+#import <CommonCrypto/CommonDigest.h>
+
+static NSString *hexDigest(NSData *data, BOOL sha256) {
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    NSUInteger length = sha256 ? CC_SHA256_DIGEST_LENGTH : CC_SHA1_DIGEST_LENGTH;
+    if (sha256) {
+        CC_SHA256(data.bytes, (CC_LONG)data.length, digest);
+    } else {
+        CC_SHA1(data.bytes, (CC_LONG)data.length, digest);
+    }
+    
+    NSMutableString *hex = [NSMutableString stringWithCapacity:length * 2];
+    for (NSUInteger i = 0; i < length; i++) {
+        [hex appendFormat:@"%02x", digest[i]];
+    }
+    
+    return hex;
+}
+
+static NSError *diffError(NSString *reason) {
+    return [NSError errorWithDomain:CPMERRORDOMAIN
+                               code:CPMErrorInvalidFormat
+                           userInfo:@{ NSLocalizedFailureReasonErrorKey: reason }];
+}
+
+@interface CPMPackagesDiff ()
+@property (readwrite, copy) NSURL *indexURL;
+@property (readwrite, copy) NSString *localPath;
+- (void)applyIndex:(NSString *)index completion:(void (^)(NSData *patched, NSError *error))completion;
+@end
+
+@implementation CPMPackagesDiff
+
+- (instancetype)initWithIndexURL:(NSURL *)indexURL localPath:(NSString *)localPath {
+    if ((self = [super init])) {
+        self.indexURL = indexURL;
+        self.localPath = localPath;
+    }
+    
+    return self;
+}
+
+- (void)patchWithCompletion:(void (^)(NSData *patched, NSError *error))completion {
+    CPMCurler *curl = [[CPMCurler alloc] initWithURL:self.indexURL dataBlock:nil completionBlock:nil];
+    __weak CPMCurler *weakCurl = curl;
+    curl.completionBlock = ^{
+        if (weakCurl.error) {
+            completion(nil, weakCurl.error);
+            return;
+        }
+        
+        // not on the worker queue: an ingest may be waiting on the patched index,
+        // and it could be holding the very worker this would wait for
+        NSString *index = [[NSString alloc] initWithData:weakCurl.data encoding:NSUTF8StringEncoding];
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            [self applyIndex:index completion:completion];
+        });
+    };
+    
+    [[CPMDownloadScheduler sharedScheduler] addCurler:curl];
+}
+
+// Index format:
+//   SHA256-Current: <hash> <size>
+//   SHA256-History:
+//    <hash of an older Packages> <size> <name of the patch that upgrades it>
+//   SHA256-Patches:
+//    <hash of the uncompressed patch> <size> <name>
+// Older repositories only publish the SHA1-* variants.
+- (void)applyIndex:(NSString *)index completion:(void (^)(NSData *patched, NSError *error))completion {
+    BOOL sha256 = [index rangeOfString:@"SHA256-Current:"].location != NSNotFound;
+    NSString *prefix = sha256 ? @"SHA256-" : @"SHA1-";
+    
+    NSString *current = nil;
+    NSMutableArray *history = [NSMutableArray array];
+    NSMutableDictionary *patchHashes = [NSMutableDictionary dictionary];
+    
+    NSString *section = nil;
+    for (NSString *line in [index componentsSeparatedByString:@"\n"]) {
+        NSArray *words = [[line stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]] componentsSeparatedByCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        words = [words filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"length > 0"]];
+        if (!words.count)
+            continue;
+        
+        if (![line hasPrefix:@" "] && ![line hasPrefix:@"\t"]) {
+            section = words[0];
+            if ([section isEqualToString:[prefix stringByAppendingString:@"Current:"]] && words.count > 1) {
+                current = words[1];
+            }
+            continue;
+        }
+        
+        if (words.count < 3)
+            continue;
+        
+        if ([section isEqualToString:[prefix stringByAppendingString:@"History:"]]) {
+            [history addObject:words];
+        } else if ([section isEqualToString:[prefix stringByAppendingString:@"Patches:"]]) {
+            patchHashes[words[2]] = words[0];
+        }
+    }
+    
+    NSData *local = [NSData dataWithContentsOfFile:self.localPath options:NSDataReadingMappedIfSafe error:nil];
+    if (!current || !local) {
+        completion(nil, diffError(@"No usable patch index or local copy of the index"));
+        return;
+    }
+    
+    NSString *localHash = hexDigest(local, sha256);
+    if ([localHash isEqualToString:current]) {
+        completion(local, nil);
+        return;
+    }
+    
+    // every patch from our version onwards has to be applied, in order
+    NSUInteger start = [history indexOfObjectPassingTest:^BOOL(NSArray *entry, NSUInteger idx, BOOL *stop) {
+        return [entry[0] isEqualToString:localHash];
+    }];
+    
+    if (start == NSNotFound) {
+        completion(nil, diffError(@"The local index is too old to be patched"));
+        return;
+    }
+    
+    NSMutableArray *names = [NSMutableArray array];
+    NSMutableArray *patches = [NSMutableArray array];
+    for (NSUInteger i = start; i < history.count; i++) {
+        [names addObject:history[i][2]];
+        [patches addObject:[NSNull null]];
+    }
+    
+    // fetch the patches in parallel, then apply them in sequence
+    dispatch_group_t group = dispatch_group_create();
+    NSURL *base = self.indexURL.URLByDeletingLastPathComponent;
+    [names enumerateObjectsUsingBlock:^(NSString *name, NSUInteger idx, BOOL *stop) {
+        dispatch_group_enter(group);
+        CPMCurler *curl = [[CPMCurler alloc] initWithURL:[base URLByAppendingPathComponent:[name stringByAppendingPathExtension:@"gz"]]
+                                               dataBlock:nil
+                                         completionBlock:nil];
+        __weak CPMCurler *weakCurl = curl;
+        curl.completionBlock = ^{
+            NSData *patch = weakCurl.error ? nil : decompressData(weakCurl.data);
+            if (patch) {
+                @synchronized (patches) {
+                    patches[idx] = patch;
+                }
+            }
+            dispatch_group_leave(group);
+        };
+        [[CPMDownloadScheduler sharedScheduler] addCurler:curl];
+    }];
+    
+    dispatch_group_notify(group, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        // patching is CPU-bound, but it stays off the worker queue for the same reason as the index
+        NSData *patched = local;
+        for (NSUInteger i = 0; i < names.count; i++) {
+            NSData *patch = patches[i];
+            if ([patch isKindOfClass:[NSNull class]]) {
+                completion(nil, diffError([NSString stringWithFormat:@"Could not download patch %@", names[i]]));
+                return;
+            }
+            
+            NSString *expected = patchHashes[names[i]];
+            if (expected && ![hexDigest(patch, sha256) isEqualToString:expected]) {
+                completion(nil, diffError([NSString stringWithFormat:@"Patch %@ does not match its hash", names[i]]));
+                return;
+            }
+            
+            char *output = NULL;
+            size_t outputLength = 0;
+            if (CPMApplyEdScript(patched.bytes, patched.length, patch.bytes, patch.length, &output, &outputLength) != 0) {
+                completion(nil, diffError([NSString stringWithFormat:@"Patch %@ does not apply", names[i]]));
+                return;
+            }
+            
+            patched = [NSData dataWithBytesNoCopy:output length:outputLength freeWhenDone:YES];
+        }
+        
+        if (![hexDigest(patched, sha256) isEqualToString:current]) {
+            completion(nil, diffError(@"The patched index does not match the published hash"));
+            return;
+        }
+        
+        completion(patched, nil);
+    });
+}
+
+@end
@@ -0,0 +1,53 @@
+//
+//  CPMPackagesWriter.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <FMDatabase.h>
+#import "stanza.h"
+
+// Bulk-load mode for the packages table of a repository. Rows are kept per
+// slice, the component and architecture of the index they came from, and
+// every stanza is diffed against its slice instead of being written again:
+// the first stanza of a slice reads the slice's package, version and content
+// hash, and only rows that are new or whose hash changed are inserted or
+// updated. A package listed in several versions within a slice keeps its
+// highest one, by dpkg ordering. Statements are prepared once per load and
+// parsed values are bound straight from the index buffer. Nothing else may
+// write to the database between -begin and -commit/-rollback.
+@interface CPMPackagesWriter : NSObject
+@property (readonly, strong) FMDatabase *database;
+// inserted or updated
+@property (readonly, assign) NSUInteger rowsWritten;
+@property (readonly, assign) NSUInteger rowsUnchanged;
+@property (readonly, assign) NSUInteger rowsRemoved;
+// Identifier -> version of every package that was inserted, removed or got
+// a new version in some slice; the version is the one the slice had before,
+// or NSNull if the slice didn't have the package.
+@property (readonly, copy) NSDictionary *changedPackages;
+@property (readonly, copy) NSError *error;
+
+- (instancetype)initWithDatabase:(FMDatabase *)db;
+
+// Relaxes durability for the load and opens the transaction.
+- (BOOL)begin;
+
+// Stanzas without a Package field are skipped. NULL tags are empty. Returns NO
+// on a database error.
+- (BOOL)writeStanza:(const CPMStanza *)stanza component:(const char *)component architecture:(const char *)architecture;
+
+// Writes the stanzas held back because they were older than their row, if no
+// newer one came, then deletes every row of the slice that no stanza was
+// written for in this load, which is all of them if none was. Call it once the
+// slice's index has been read in full.
+- (BOOL)removeRowsNotWrittenInComponent:(const char *)component architecture:(const char *)architecture;
+
+// Both restore the pragmas changed by -begin.
+- (BOOL)commit;
+- (void)rollback;
+
+@end
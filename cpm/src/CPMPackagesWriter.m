@@ -0,0 +1,526 @@
+//
+//  CPMPackagesWriter.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMPackagesWriter.h"
+#import "CPDefines.h"
+#import "strpool.h"
+#import "version.h"
+#import <FMDatabaseAdditions.h>
+#import <sqlite3.h>
+
+// page cache used while loading, in KiB (negative values are sizes, not pages)
+#define CPMPackagesWriterCacheSize -32768
+
+// FNV-1a, 64 bits
+static uint64_t CPMPackagesWriterHash(uint64_t hash, const void *bytes, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        hash ^= ((const unsigned char *)bytes)[i];
+        hash *= 1099511628211ULL;
+    }
+    
+    return hash;
+}
+
+#pragma mark - Pending Stanza
+
+// A stanza that a later one of the same index may still supersede, copied out
+// of the buffer it was parsed from
+@interface CPMPackagesPendingStanza : NSObject {
+@public
+    CPMStanza _stanza;
+    uint64_t _hash;
+    char *_buffer;
+}
+- (instancetype)initWithStanza:(const CPMStanza *)stanza hash:(uint64_t)hash;
+@end
+
+@implementation CPMPackagesPendingStanza
+
+- (instancetype)initWithStanza:(const CPMStanza *)stanza hash:(uint64_t)hash {
+    if ((self = [super init])) {
+        size_t length = 0;
+        for (int field = 0; field < CPMStanzaFieldCount; field++) {
+            length += stanza->values[field].length;
+        }
+        
+        _buffer = malloc(MAX(length, 1));
+        _hash = hash;
+        char *cursor = _buffer;
+        for (int field = 0; field < CPMStanzaFieldCount; field++) {
+            const CPMStanzaValue *value = &stanza->values[field];
+            _stanza.values[field].bytes = value->bytes ? cursor : NULL;
+            _stanza.values[field].length = value->length;
+            if (value->bytes) {
+                memcpy(cursor, value->bytes, value->length);
+                cursor += value->length;
+            }
+        }
+    }
+    
+    return self;
+}
+
+- (void)dealloc {
+    free(_buffer);
+}
+
+@end
+
+#pragma mark - Slice
+
+// The rows of one component and architecture: what the table holds and what
+// this load has seen of them so far, by package name
+@interface CPMPackagesSlice : NSObject {
+@public
+    char *_component;
+    char *_architecture;
+    
+    // package names and versions
+    CPMStringPool _strings;
+    // by string id; a rowid of 0 means the slice has no such package.
+    // hash and version are the row's, as it is now
+    sqlite3_int64 *_rowids;
+    uint64_t *_hashes;
+    uint32_t *_versions;
+    // whether the load has had a stanza for the package, and the highest version it had
+    BOOL *_seen;
+    uint32_t *_best;
+    uint32_t _capacity;
+}
+// entry -> CPMPackagesPendingStanza
+@property (strong) NSMutableDictionary *pending;
+- (instancetype)initWithComponent:(const char *)component architecture:(const char *)architecture;
+- (BOOL)loadFromDatabase:(FMDatabase *)db;
+- (uint32_t)intern:(const char *)bytes length:(size_t)length;
+@end
+
+@implementation CPMPackagesSlice
+
+- (instancetype)initWithComponent:(const char *)component architecture:(const char *)architecture {
+    if ((self = [super init])) {
+        _component = strdup(component);
+        _architecture = strdup(architecture);
+        CPMStringPoolInit(&_strings);
+        self.pending = [NSMutableDictionary dictionary];
+    }
+    
+    return self;
+}
+
+- (void)dealloc {
+    free(_component);
+    free(_architecture);
+    free(_rowids);
+    free(_hashes);
+    free(_versions);
+    free(_seen);
+    free(_best);
+    CPMStringPoolFree(&_strings);
+}
+
+- (BOOL)loadFromDatabase:(FMDatabase *)db {
+    sqlite3_stmt *statement = NULL;
+    if (sqlite3_prepare_v2(db.sqliteHandle, "select rowid, package, version, stanza_hash from packages where component = ?1 and index_architecture = ?2", -1, &statement, NULL) != SQLITE_OK)
+        return NO;
+    
+    sqlite3_bind_text(statement, 1, _component, -1, SQLITE_STATIC);
+    sqlite3_bind_text(statement, 2, _architecture, -1, SQLITE_STATIC);
+    
+    int rc;
+    while ((rc = sqlite3_step(statement)) == SQLITE_ROW) {
+        uint32_t package = [self intern:(const char *)sqlite3_column_text(statement, 1) length:(size_t)sqlite3_column_bytes(statement, 1)];
+        uint32_t version = [self intern:(const char *)sqlite3_column_text(statement, 2) length:(size_t)sqlite3_column_bytes(statement, 2)];
+        _rowids[package] = sqlite3_column_int64(statement, 0);
+        _hashes[package] = (uint64_t)sqlite3_column_int64(statement, 3);
+        _versions[package] = version;
+    }
+    sqlite3_finalize(statement);
+    
+    return rc == SQLITE_DONE;
+}
+
+- (uint32_t)intern:(const char *)bytes length:(size_t)length {
+    uint32_t id = CPMStringPoolIntern(&_strings, bytes ?: "", length, CPMStringHash(bytes ?: "", length));
+    if (id >= _capacity) {
+        uint32_t capacity = MAX(_capacity * 2, 1024);
+        while (id >= capacity)
+            capacity *= 2;
+        
+        _rowids = realloc(_rowids, capacity * sizeof(*_rowids));
+        _hashes = realloc(_hashes, capacity * sizeof(*_hashes));
+        _versions = realloc(_versions, capacity * sizeof(*_versions));
+        _seen = realloc(_seen, capacity * sizeof(*_seen));
+        _best = realloc(_best, capacity * sizeof(*_best));
+        
+        size_t added = capacity - _capacity;
+        memset(_rowids + _capacity, 0, added * sizeof(*_rowids));
+        memset(_hashes + _capacity, 0, added * sizeof(*_hashes));
+        memset(_versions + _capacity, 0, added * sizeof(*_versions));
+        memset(_seen + _capacity, 0, added * sizeof(*_seen));
+        memset(_best + _capacity, 0, added * sizeof(*_best));
+        _capacity = capacity;
+    }
+    
+    return id;
+}
+
+@end
+
+#pragma mark - Writer
+
+@interface CPMPackagesWriter () {
+    sqlite3_stmt *_insert;
+    sqlite3_stmt *_update;
+    sqlite3_stmt *_delete;
+    CPMStanzaField _columns[CPMStanzaFieldCount];
+    int _columnCount;
+    int _synchronous;
+    int _cacheSize;
+}
+@property (readwrite, strong) FMDatabase *database;
+@property (readwrite, assign) NSUInteger rowsWritten;
+@property (readwrite, assign) NSUInteger rowsUnchanged;
+@property (readwrite, assign) NSUInteger rowsRemoved;
+@property (strong) NSMutableDictionary *changes;
+@property (readwrite, copy) NSError *error;
+// by "<component>\n<architecture>"
+@property (strong) NSMutableDictionary *slices;
+// stanzas of one index come in a row, so this saves a lookup for nearly all of them
+@property (strong) CPMPackagesSlice *lastSlice;
+- (BOOL)prepareStatements;
+- (CPMPackagesSlice *)sliceForComponent:(const char *)component architecture:(const char *)architecture;
+- (uint64_t)hashOfStanza:(const CPMStanza *)stanza;
+- (BOOL)writeStanza:(const CPMStanza *)stanza hash:(uint64_t)hash toEntry:(uint32_t)entry ofSlice:(CPMPackagesSlice *)slice;
+- (void)bindStanza:(const CPMStanza *)stanza hash:(uint64_t)hash toStatement:(sqlite3_stmt *)statement;
+- (BOOL)step:(sqlite3_stmt *)statement;
+- (void)recordChangeOfPackage:(NSString *)package previousVersion:(NSString *)version;
+- (void)finishLoad;
+- (void)recordDatabaseError;
+@end
+
+@implementation CPMPackagesWriter
+
+- (instancetype)initWithDatabase:(FMDatabase *)db {
+    if ((self = [super init])) {
+        self.database = db;
+        self.changes = [NSMutableDictionary dictionary];
+        self.slices = [NSMutableDictionary dictionary];
+    }
+    
+    return self;
+}
+
+- (void)dealloc {
+    sqlite3_finalize(_insert);
+    sqlite3_finalize(_update);
+    sqlite3_finalize(_delete);
+}
+
+- (NSDictionary *)changedPackages {
+    return [self.changes copy];
+}
+
+- (BOOL)begin {
+    FMDatabase *db = self.database;
+    
+    // remember what to restore once the load is over
+    _synchronous = [db intForQuery:@"PRAGMA synchronous"];
+    _cacheSize = [db intForQuery:@"PRAGMA cache_size"];
+    
+    // the rows are rebuilt from the index on the next refresh if we crash midway,
+    // so there is no point in syncing every page of the load
+    [db executeUpdate:@"PRAGMA synchronous = OFF"];
+    [db executeUpdate:[NSString stringWithFormat:@"PRAGMA cache_size = %d", CPMPackagesWriterCacheSize]];
+    
+    if (![self prepareStatements] || ![db beginTransaction]) {
+        [self recordDatabaseError];
+        [self finishLoad];
+        return NO;
+    }
+    
+    return YES;
+}
+
+- (BOOL)prepareStatements {
+    FMDatabase *db = self.database;
+    
+    // bind by position: only fields that are actual columns of the table take part
+    _columnCount = 0;
+    FMResultSet *results = [db executeQuery:@"PRAGMA table_info(packages)"];
+    while (results.next) {
+        const char *name = [results UTF8StringForColumnName:@"name"];
+        CPMStanzaField field = CPMStanzaFieldForName(name, strlen(name));
+        if (field != CPMStanzaFieldUnknown) {
+            _columns[_columnCount++] = field;
+        }
+    }
+    [results close];
+    
+    if (_columnCount == 0)
+        return NO;
+    
+    NSMutableString *names = [NSMutableString string];
+    NSMutableString *params = [NSMutableString string];
+    NSMutableString *assignments = [NSMutableString string];
+    for (int i = 0; i < _columnCount; i++) {
+        [names appendFormat:@"%@%s", i ? @", " : @"", CPMStanzaFieldColumn(_columns[i])];
+        [params appendFormat:@"%@?%d", i ? @", " : @"", i + 1];
+        [assignments appendFormat:@"%@%s = ?%d", i ? @", " : @"", CPMStanzaFieldColumn(_columns[i]), i + 1];
+    }
+    
+    // the tags and the hash go after the fields, then the rowid of an update
+    int component = _columnCount + 1, architecture = _columnCount + 2, hash = _columnCount + 3, rowid = _columnCount + 4;
+    NSString *insert = [NSString stringWithFormat:@"insert into packages (%@, component, index_architecture, stanza_hash) values (%@, ?%d, ?%d, ?%d)",
+                        names, params, component, architecture, hash];
+    NSString *update = [NSString stringWithFormat:@"update packages set %@, stanza_hash = ?%d where rowid = ?%d", assignments, hash, rowid];
+    
+    return sqlite3_prepare_v2(db.sqliteHandle, insert.UTF8String, -1, &_insert, NULL) == SQLITE_OK &&
+           sqlite3_prepare_v2(db.sqliteHandle, update.UTF8String, -1, &_update, NULL) == SQLITE_OK &&
+           sqlite3_prepare_v2(db.sqliteHandle, "delete from packages where rowid = ?1", -1, &_delete, NULL) == SQLITE_OK;
+}
+
+- (BOOL)writeStanza:(const CPMStanza *)stanza component:(const char *)component architecture:(const char *)architecture {
+    if (!_insert)
+        return NO;
+    
+    const CPMStanzaValue *package = &stanza->values[CPMStanzaFieldPackage];
+    const CPMStanzaValue *version = &stanza->values[CPMStanzaFieldVersion];
+    if (!package->length)
+        return YES;
+    
+    CPMPackagesSlice *slice = [self sliceForComponent:component ?: "" architecture:architecture ?: ""];
+    if (!slice) {
+        [self recordDatabaseError];
+        return NO;
+    }
+    
+    uint64_t hash = [self hashOfStanza:stanza];
+    uint32_t entry = [slice intern:package->bytes length:package->length];
+    const char *versionBytes = version->bytes ?: "";
+    
+    // an index may list several versions of a package, which share its row:
+    // only the highest is kept
+    if (slice->_seen[entry]) {
+        const char *best = CPMStringPoolString(&slice->_strings, slice->_best[entry]);
+        if (CPMVersionCompare(versionBytes, version->length, best, strlen(best)) <= 0)
+            return YES;
+        
+        [slice.pending removeObjectForKey:@(entry)];
+    }
+    
+    // the version in the row may still come, so an older one is only written
+    // if it doesn't; a newer but still older one takes its place meanwhile
+    if (slice->_rowids[entry] && slice->_hashes[entry] != hash) {
+        const char *current = CPMStringPoolString(&slice->_strings, slice->_versions[entry]);
+        if (CPMVersionCompare(versionBytes, version->length, current, strlen(current)) < 0) {
+            uint32_t versionID = [slice intern:versionBytes length:version->length];
+            slice->_seen[entry] = YES;
+            slice->_best[entry] = versionID;
+            slice.pending[@(entry)] = [[CPMPackagesPendingStanza alloc] initWithStanza:stanza hash:hash];
+            return YES;
+        }
+    }
+    
+    // interning may grow the arrays, so the entry is indexed afterwards
+    uint32_t versionID = [slice intern:versionBytes length:version->length];
+    slice->_seen[entry] = YES;
+    slice->_best[entry] = versionID;
+    
+    return [self writeStanza:stanza hash:hash toEntry:entry ofSlice:slice];
+}
+
+- (BOOL)removeRowsNotWrittenInComponent:(const char *)component architecture:(const char *)architecture {
+    if (!_delete)
+        return NO;
+    
+    CPMPackagesSlice *slice = [self sliceForComponent:component ?: "" architecture:architecture ?: ""];
+    if (!slice) {
+        [self recordDatabaseError];
+        return NO;
+    }
+    
+    // older versions that nothing superseded after all
+    NSDictionary *pending = [slice.pending copy];
+    [slice.pending removeAllObjects];
+    for (NSNumber *entry in pending) {
+        CPMPackagesPendingStanza *stanza = pending[entry];
+        if (![self writeStanza:&stanza->_stanza hash:stanza->_hash toEntry:entry.unsignedIntValue ofSlice:slice])
+            return NO;
+    }
+    
+    for (uint32_t entry = 0; entry < slice->_strings.count; entry++) {
+        if (!slice->_rowids[entry] || slice->_seen[entry])
+            continue;
+        
+        sqlite3_bind_int64(_delete, 1, slice->_rowids[entry]);
+        if (![self step:_delete])
+            return NO;
+        
+        [self recordChangeOfPackage:@(CPMStringPoolString(&slice->_strings, entry))
+                    previousVersion:@(CPMStringPoolString(&slice->_strings, slice->_versions[entry]))];
+        slice->_rowids[entry] = 0;
+        self.rowsRemoved++;
+    }
+    
+    return YES;
+}
+
+// Brings the entry's row in line with the stanza, if it isn't already
+- (BOOL)writeStanza:(const CPMStanza *)stanza hash:(uint64_t)hash toEntry:(uint32_t)entry ofSlice:(CPMPackagesSlice *)slice {
+    const CPMStanzaValue *package = &stanza->values[CPMStanzaFieldPackage];
+    const CPMStanzaValue *version = &stanza->values[CPMStanzaFieldVersion];
+    
+    if (slice->_rowids[entry]) {
+        if (slice->_hashes[entry] == hash) {
+            self.rowsUnchanged++;
+            return YES;
+        }
+        
+        // same rowid, so the search index only sees an update
+        [self bindStanza:stanza hash:hash toStatement:_update];
+        sqlite3_bind_int64(_update, _columnCount + 4, slice->_rowids[entry]);
+        if (![self step:_update])
+            return NO;
+        
+        const char *previous = CPMStringPoolString(&slice->_strings, slice->_versions[entry]);
+        if (strlen(previous) != version->length || memcmp(previous, version->bytes ?: "", version->length) != 0) {
+            [self recordChangeOfPackage:[[NSString alloc] initWithBytes:package->bytes length:package->length encoding:NSUTF8StringEncoding]
+                        previousVersion:@(previous)];
+        }
+    } else {
+        [self bindStanza:stanza hash:hash toStatement:_insert];
+        sqlite3_bind_text(_insert, _columnCount + 1, slice->_component, -1, SQLITE_STATIC);
+        sqlite3_bind_text(_insert, _columnCount + 2, slice->_architecture, -1, SQLITE_STATIC);
+        if (![self step:_insert])
+            return NO;
+        
+        slice->_rowids[entry] = sqlite3_last_insert_rowid(self.database.sqliteHandle);
+        [self recordChangeOfPackage:[[NSString alloc] initWithBytes:package->bytes length:package->length encoding:NSUTF8StringEncoding]
+                    previousVersion:nil];
+    }
+    
+    uint32_t versionID = [slice intern:version->bytes ?: "" length:version->length];
+    slice->_versions[entry] = versionID;
+    slice->_hashes[entry] = hash;
+    
+    self.rowsWritten++;
+    return YES;
+}
+
+- (BOOL)commit {
+    BOOL succ = [self.database commit];
+    if (!succ) {
+        [self recordDatabaseError];
+        [self.database rollback];
+    }
+    
+    [self finishLoad];
+    return succ;
+}
+
+- (void)rollback {
+    [self.database rollback];
+    [self finishLoad];
+}
+
+#pragma mark - Helpers
+
+- (CPMPackagesSlice *)sliceForComponent:(const char *)component architecture:(const char *)architecture {
+    CPMPackagesSlice *slice = self.lastSlice;
+    if (slice && strcmp(slice->_component, component) == 0 && strcmp(slice->_architecture, architecture) == 0)
+        return slice;
+    
+    NSString *key = [NSString stringWithFormat:@"%s\n%s", component, architecture];
+    slice = self.slices[key];
+    if (!slice) {
+        slice = [[CPMPackagesSlice alloc] initWithComponent:component architecture:architecture];
+        if (![slice loadFromDatabase:self.database])
+            return nil;
+        
+        self.slices[key] = slice;
+    }
+    
+    self.lastSlice = slice;
+    return slice;
+}
+
+// Covers exactly what is stored: every column, with a missing field told
+// apart from an empty one
+- (uint64_t)hashOfStanza:(const CPMStanza *)stanza {
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < _columnCount; i++) {
+        const CPMStanzaValue *value = &stanza->values[_columns[i]];
+        size_t length = value->bytes ? value->length : SIZE_MAX;
+        hash = CPMPackagesWriterHash(hash, &length, sizeof(length));
+        if (value->bytes)
+            hash = CPMPackagesWriterHash(hash, value->bytes, value->length);
+    }
+    
+    return hash;
+}
+
+- (void)bindStanza:(const CPMStanza *)stanza hash:(uint64_t)hash toStatement:(sqlite3_stmt *)statement {
+    for (int i = 0; i < _columnCount; i++) {
+        const CPMStanzaValue *value = &stanza->values[_columns[i]];
+        if (value->bytes) {
+            // the buffer outlives the step, so sqlite doesn't need its own copy
+            sqlite3_bind_text(statement, i + 1, value->bytes, (int)value->length, SQLITE_STATIC);
+        } else {
+            sqlite3_bind_null(statement, i + 1);
+        }
+    }
+    
+    sqlite3_bind_int64(statement, _columnCount + 3, (sqlite3_int64)hash);
+}
+
+- (BOOL)step:(sqlite3_stmt *)statement {
+    int rc = sqlite3_step(statement);
+    sqlite3_reset(statement);
+    
+    if (rc != SQLITE_DONE) {
+        [self recordDatabaseError];
+        return NO;
+    }
+    
+    return YES;
+}
+
+// the version before the first change is the one that counts
+- (void)recordChangeOfPackage:(NSString *)package previousVersion:(NSString *)version {
+    if (package && !self.changes[package])
+        self.changes[package] = version ?: [NSNull null];
+}
+
+- (void)finishLoad {
+    sqlite3_finalize(_insert);
+    sqlite3_finalize(_update);
+    sqlite3_finalize(_delete);
+    _insert = _update = _delete = NULL;
+    self.slices = nil;
+    self.lastSlice = nil;
+    
+    [self.database executeUpdate:[NSString stringWithFormat:@"PRAGMA synchronous = %d", _synchronous]];
+    [self.database executeUpdate:[NSString stringWithFormat:@"PRAGMA cache_size = %d", _cacheSize]];
+}
+
+- (void)recordDatabaseError {
+    if (self.error)
+        return;
+    
+    FMDatabase *db = self.database;
+    NSLog(@"%@", db.lastErrorMessage);
+    self.error = [NSError errorWithDomain:CPMERRORDOMAIN
+                                     code:CPMErrorDatabase
+                                 userInfo:@{
+                                            @"code": @(db.lastErrorCode),
+                                            NSLocalizedDescriptionKey: @"Failed to commit changes to database, rolling back...",
+                                            NSLocalizedFailureReasonErrorKey: db.lastErrorMessage ?: @""
+                                            }];
+}
+
+@end
@@ -0,0 +1,48 @@
+//
+//  CPMRefreshMetrics.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+// Timings and counters of one repository refresh. Times are on the
+// NSProcessInfo systemUptime clock, the same one CPMCurler stamps its requests
+// with, so metrics of refreshes that ran side by side line up. Safe to use
+// from any thread.
+@interface CPMRefreshMetrics : NSObject
+@property (readonly, copy) NSString *name;
+@property (readonly, assign) NSTimeInterval startTime;
+// 0 while the refresh is still running
+@property (readonly, assign) NSTimeInterval finishTime;
+
+- (instancetype)initWithName:(NSString *)name;
+
+// Stamps the end of the refresh; later calls do nothing.
+- (void)finish;
+
+// Phases may overlap, but one name is only open once at a time.
+- (void)beginPhase:(NSString *)phase;
+- (void)endPhase:(NSString *)phase arguments:(NSDictionary *)arguments;
+// For a span that was timed elsewhere, like a request by its curler.
+- (void)recordPhase:(NSString *)phase start:(NSTimeInterval)start end:(NSTimeInterval)end arguments:(NSDictionary *)arguments;
+
+- (void)addValue:(double)value forCounter:(NSString *)counter;
+
+// NSNumbers by counter name.
+@property (readonly, copy) NSDictionary *counters;
+// In the order they ended, each with "name", "start" and "duration" in seconds
+// since the refresh started, and the "arguments" it was ended with.
+@property (readonly, copy) NSArray *phases;
+
+// Complete events in the Chrome trace event format, with the refresh as a
+// whole carrying the counters, all on thread `thread` of the trace.
+- (NSArray *)traceEventsWithThread:(NSUInteger)thread;
+
+// Writes {"traceEvents": [...]} with every refresh on a thread of its own,
+// which chrome://tracing and Perfetto open as is.
++ (BOOL)writeTraceForMetrics:(NSArray *)metrics toURL:(NSURL *)url error:(NSError **)error;
+
+@end
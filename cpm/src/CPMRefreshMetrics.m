@@ -0,0 +1,137 @@
+//
+//  CPMRefreshMetrics.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMRefreshMetrics.h"
+
+static NSTimeInterval now(void) {
+    return [NSProcessInfo processInfo].systemUptime;
+}
+
+// trace timestamps are in microseconds
+static NSNumber *traceTime(NSTimeInterval seconds) {
+    return @((long long)(seconds * 1000000));
+}
+
+@interface CPMRefreshMetrics ()
+@property (readwrite, copy) NSString *name;
+@property (readwrite, assign) NSTimeInterval startTime;
+@property (readwrite, assign) NSTimeInterval finishTime;
+@property (strong) NSMutableDictionary *openPhases;
+@property (strong) NSMutableArray *finishedPhases;
+@property (strong) NSMutableDictionary *mutableCounters;
+@end
+
+@implementation CPMRefreshMetrics
+
+- (instancetype)initWithName:(NSString *)name {
+    if ((self = [self init])) {
+        self.name = name;
+        self.startTime = now();
+        self.openPhases = [NSMutableDictionary dictionary];
+        self.finishedPhases = [NSMutableArray array];
+        self.mutableCounters = [NSMutableDictionary dictionary];
+    }
+
+    return self;
+}
+
+- (void)finish {
+    @synchronized (self) {
+        if (!self.finishTime)
+            self.finishTime = now();
+    }
+}
+
+- (void)beginPhase:(NSString *)phase {
+    @synchronized (self) {
+        self.openPhases[phase] = @(now());
+    }
+}
+
+- (void)endPhase:(NSString *)phase arguments:(NSDictionary *)arguments {
+    NSTimeInterval end = now();
+
+    @synchronized (self) {
+        NSNumber *start = self.openPhases[phase];
+        if (!start)
+            return;
+
+        [self.openPhases removeObjectForKey:phase];
+        [self recordPhase:phase start:start.doubleValue end:end arguments:arguments];
+    }
+}
+
+- (void)recordPhase:(NSString *)phase start:(NSTimeInterval)start end:(NSTimeInterval)end arguments:(NSDictionary *)arguments {
+    // a curler that never started has no times
+    if (start <= 0 || end < start)
+        return;
+
+    @synchronized (self) {
+        [self.finishedPhases addObject:@{ @"name": phase,
+                                          @"start": @(start - self.startTime),
+                                          @"duration": @(end - start),
+                                          @"arguments": arguments ?: @{} }];
+    }
+}
+
+- (void)addValue:(double)value forCounter:(NSString *)counter {
+    @synchronized (self) {
+        self.mutableCounters[counter] = @([self.mutableCounters[counter] doubleValue] + value);
+    }
+}
+
+- (NSDictionary *)counters {
+    @synchronized (self) {
+        return [self.mutableCounters copy];
+    }
+}
+
+- (NSArray *)phases {
+    @synchronized (self) {
+        return [self.finishedPhases copy];
+    }
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %@ %@ %@>", self.class, self.name, self.counters, self.phases];
+}
+
+#pragma mark - Trace
+
+- (NSArray *)traceEventsWithThread:(NSUInteger)thread {
+    NSTimeInterval start = self.startTime;
+    NSTimeInterval finish = self.finishTime ?: now();
+
+    NSMutableArray *events = [NSMutableArray array];
+    [events addObject:@{ @"name": @"thread_name", @"ph": @"M", @"pid": @1, @"tid": @(thread),
+                         @"args": @{ @"name": self.name ?: @"" } }];
+    [events addObject:@{ @"name": @"refresh", @"cat": @"refresh", @"ph": @"X", @"pid": @1, @"tid": @(thread),
+                         @"ts": traceTime(start), @"dur": traceTime(finish - start),
+                         @"args": self.counters }];
+
+    for (NSDictionary *phase in self.phases) {
+        NSTimeInterval phaseStart = start + [phase[@"start"] doubleValue];
+        [events addObject:@{ @"name": phase[@"name"], @"cat": @"refresh", @"ph": @"X", @"pid": @1, @"tid": @(thread),
+                             @"ts": traceTime(phaseStart), @"dur": traceTime([phase[@"duration"] doubleValue]),
+                             @"args": phase[@"arguments"] }];
+    }
+
+    return events;
+}
+
++ (BOOL)writeTraceForMetrics:(NSArray *)metrics toURL:(NSURL *)url error:(NSError **)error {
+    NSMutableArray *events = [NSMutableArray array];
+    [metrics enumerateObjectsUsingBlock:^(CPMRefreshMetrics *refresh, NSUInteger idx, BOOL *stop) {
+        [events addObjectsFromArray:[refresh traceEventsWithThread:idx + 1]];
+    }];
+
+    NSData *data = [NSJSONSerialization dataWithJSONObject:@{ @"traceEvents": events, @"displayTimeUnit": @"ms" } options:0 error:error];
+    return data && [data writeToURL:url options:NSDataWritingAtomic error:error];
+}
+
+@end
@@ -9,6 +9,9 @@
 #import <Foundation/Foundation.h>
 #import <FMDatabaseQueue.h>
 #import <FMDatabase.h>
+#import <FMDatabasePool.h>
+#import "CPMRefreshMetrics.h"
+#import "CPMPackageChanges.h"
 
 @interface CPMRepository : NSObject
 @property (readonly, strong) NSURL *url;
@@ -17,16 +20,45 @@
 @property (copy) NSNumber *version;
 @property (copy) NSString *architectures;
 @property (copy) NSString *repoDescription;
+// The only connection that writes
 @property (strong) FMDatabaseQueue *databaseQueue;
+// Read-only connections for queries, which never wait for a refresh to commit
+@property (strong) FMDatabasePool *readerPool;
 @property (readonly, copy) NSURL *binaryBaseURL;
 
 + (instancetype)repositoryWithURL:(NSURL *)url;
 - (instancetype)initWithURL:(NSURL *)url;
+// Only Packages indexes of these architectures are fetched, and only their
+// packages are listed; "all" and untagged packages of flat repositories
+// always are. Earlier architectures win when a package is in several.
+- (instancetype)initWithURL:(NSURL *)url architectures:(NSArray *)architectures;
+// What dpkg is configured for, or else iphoneos-arm
++ (NSArray *)defaultArchitectures;
 
-- (void)reloadData:(void (^)(NSError *error))completion;
+@property (readonly, copy) NSArray *acceptedArchitectures;
+// SQL condition on the packages table that keeps the rows of accepted
+// architectures; every query on the table goes through it
+@property (readonly, copy) NSString *architectureCondition;
 
+// The completion gets what the refresh changed about the listed packages, or
+// nil with the error.
+- (void)reloadData:(void (^)(CPMPackageChanges *changes, NSError *error))completion;
+// Timings and counters of the refresh in progress, or else of the last one;
+// nil until the first reloadData:.
+@property (readonly, strong) CPMRefreshMetrics *refreshMetrics;
+// Bumped by every refresh that wrote or removed rows, and only then
+@property (readonly, assign) uint64_t generation;
+
+// listPackages, packageWithIdentifier:, groupNames and packagesInGroup: are
+// served from a mapped snapshot of the packages table that every ingest
+// rewrites, without touching the database. Packages are sorted by identifier.
 - (NSArray *)listPackages;
 - (NSArray *)searchForPackage:(NSString *)query;
+// Best matches first, one per package, each with its bm25 score under "score"
+// (lower is better) and that score relative to the best match's under
+// "relevance" (1 for the best, less for the rest). Every word of the query
+// matches as a prefix.
+- (NSArray *)searchForPackage:(NSString *)query limit:(NSUInteger)limit;
 - (NSDictionary *)packageWithIdentifier:(NSString *)identifier;
 
 - (NSSet *)groupNames;
@@ -10,8 +10,26 @@
 #import "CPMRepository.h"
 #import "CPDefines.h"
 #import "CPMCurler.h"
-#import "decompress.h"
+#import "CPMDownloadScheduler.h"
+#import "CPMIndexStream.h"
+#import "CPMIndexStreamGroup.h"
+#import "CPMPackagesWriter.h"
+#import "CPMPackagesDiff.h"
+#import "CPMPackageChanges.h"
 #import "dictionarize.h"
+#import "snapshot.h"
+#import "stanza.h"
+#import <sqlite3.h>
+#import <FMDatabaseAdditions.h>
+
+// bump whenever the tables change shape; older databases are rebuilt from scratch
+#define CPMRepositorySchemaVersion 5
+
+// how many results a search returns unless asked otherwise
+#define CPMRepositorySearchLimit 50
+
+// the snapshot holds every column of the packages table, which are the stanza fields up to Replaces
+#define CPMRepositorySnapshotFieldCount (CPMStanzaFieldReplaces + 1)
 
 typedef NS_ENUM(NSUInteger, CPMRepositoryIndexCompression) {
     CPMRepositoryIndexCompressionLZMA,
@@ -27,12 +45,6 @@ typedef NS_ENUM(NSUInteger, CPMRepositoryFormat) {
     CPMRepositoryFormatModern = 1
 };
 
-typedef NS_ENUM(NSUInteger, CPMRepositoryIndex) {
-    CPMRepositoryIndexRelease = 0,
-    CPMRepositoryIndexPackages = 1,
-    CPMRepositoryIndexSources = 2
-};
-
 NSString *extensionForCompression(CPMRepositoryIndexCompression compression) {
     switch (compression) {
         case CPMRepositoryIndexCompressionBzip2:
@@ -65,18 +77,204 @@ NSString *argumentsForUpdateDictionary(NSDictionary *dict) {
     return [NSString stringWithFormat:@"(%@) values (:%@)", [dict.allKeys componentsJoinedByString:@", "], [dict.allKeys componentsJoinedByString:@", :"]];
 }
 
+// Release indexes list their files as "<hash> <size> <path>", one per line
+NSDictionary *hashesFromReleaseListing(NSString *listing) {
+    NSMutableDictionary *hashes = [NSMutableDictionary dictionary];
+    NSCharacterSet *whitespace = [NSCharacterSet whitespaceCharacterSet];
+    for (NSString *line in [listing componentsSeparatedByString:@"\n"]) {
+        NSMutableArray *words = [[line componentsSeparatedByCharactersInSet:whitespace] mutableCopy];
+        [words removeObject:@""];
+        if (words.count == 3) {
+            hashes[words[2]] = words[0];
+        }
+    }
+    
+    return hashes;
+}
+
+// Turns what the user typed into an FTS5 expression: every word has to match,
+// and every word is a prefix so results show up while typing. Words are quoted
+// so nothing the user types is taken as FTS5 syntax.
+NSString *matchExpressionForQuery(NSString *query) {
+    NSMutableArray *terms = [NSMutableArray array];
+    for (NSString *word in [query componentsSeparatedByCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]]) {
+        if (!word.length)
+            continue;
+        
+        NSString *escaped = [word stringByReplacingOccurrencesOfString:@"\"" withString:@"\"\""];
+        [terms addObject:[NSString stringWithFormat:@"\"%@\"*", escaped]];
+    }
+    
+    return terms.count ? [terms componentsJoinedByString:@" "] : nil;
+}
+
+#pragma mark - Snapshot
+
+// A mapped snapshot of the packages table, unmapped once nothing uses it
+@interface CPMRepositorySnapshot : NSObject {
+@public
+    CPMSnapshot _snapshot;
+}
+- (instancetype)initWithPath:(NSString *)path tag:(uint64_t)tag;
+@end
+
+@implementation CPMRepositorySnapshot
+
+- (instancetype)initWithPath:(NSString *)path tag:(uint64_t)tag {
+    if ((self = [super init])) {
+        if (CPMSnapshotOpen(&_snapshot, path.fileSystemRepresentation, CPMRepositorySnapshotFieldCount, tag) != 0)
+            return nil;
+    }
+    
+    return self;
+}
+
+- (void)dealloc {
+    CPMSnapshotClose(&_snapshot);
+}
+
+@end
+
+// One row of a snapshot as a dictionary. Values are only read out of the
+// mapping when asked for, so listing a repository creates one object per
+// package and nothing else.
+@interface CPMSnapshotPackage : NSDictionary {
+    CPMRepositorySnapshot *_snapshot;
+    uint32_t _row;
+    NSURL *_url;
+}
+- (instancetype)initWithSnapshot:(CPMRepositorySnapshot *)snapshot row:(uint32_t)row url:(NSURL *)url;
+@end
+
+@implementation CPMSnapshotPackage
+
+- (instancetype)initWithSnapshot:(CPMRepositorySnapshot *)snapshot row:(uint32_t)row url:(NSURL *)url {
+    if ((self = [super init])) {
+        _snapshot = snapshot;
+        _row = row;
+        _url = url;
+    }
+    
+    return self;
+}
+
+- (NSUInteger)count {
+    NSUInteger count = _url ? 1 : 0;
+    for (int field = 0; field < CPMRepositorySnapshotFieldCount; field++) {
+        if (*CPMSnapshotValue(&_snapshot->_snapshot, _row, field))
+            count++;
+    }
+    
+    return count;
+}
+
+- (id)objectForKey:(id)key {
+    if (![key isKindOfClass:[NSString class]])
+        return nil;
+    if ([key isEqualToString:@"repo"])
+        return _url;
+    
+    const char *name = [key UTF8String];
+    CPMStanzaField field = CPMStanzaFieldForName(name, strlen(name));
+    if (field == CPMStanzaFieldUnknown || field >= CPMRepositorySnapshotFieldCount)
+        return nil;
+    
+    const char *value = CPMSnapshotValue(&_snapshot->_snapshot, _row, field);
+    if (!*value)
+        return nil;
+    
+    // integer columns come back from the database as numbers
+    if (field == CPMStanzaFieldSize || field == CPMStanzaFieldInstalledSize)
+        return @(strtoll(value, NULL, 10));
+    
+    return @(value);
+}
+
+- (NSEnumerator *)keyEnumerator {
+    NSMutableArray *keys = [NSMutableArray arrayWithCapacity:CPMRepositorySnapshotFieldCount + 1];
+    for (int field = 0; field < CPMRepositorySnapshotFieldCount; field++) {
+        if (*CPMSnapshotValue(&_snapshot->_snapshot, _row, field))
+            [keys addObject:@(CPMStanzaFieldColumn(field))];
+    }
+    if (_url)
+        [keys addObject:@"repo"];
+    
+    return keys.objectEnumerator;
+}
+
+@end
+
+#pragma mark - Packages Index
+
+// One Packages index of a repository, and what became of it during a refresh
+@interface CPMRepositoryPackagesIndex : NSObject
+// both empty for a flat repository
+@property (copy) NSString *component;
+@property (copy) NSString *architecture;
+// relative to the Release index, without a compression extension
+@property (copy) NSString *path;
+// "<algorithm>:<hash>" the Release index publishes for it, and the one we ingested last
+@property (copy) NSString *publishedHash;
+@property (copy) NSString *ingestedHash;
+// the smallest variant listed; unlisted means probing every compression in turn, starting with the first
+@property (assign) CPMRepositoryIndexCompression compression;
+@property (assign) BOOL offersDiffs;
+
+@property (strong) CPMIndexStream *stream;
+@property (copy) void (^startIngest)(void);
+// the download that filled the stream, for its validators
+@property (copy) NSURL *downloadURL;
+@property (strong) NSHTTPURLResponse *response;
+// answered 304
+@property (assign) BOOL unchanged;
+// not found with any compression
+@property (assign) BOOL missing;
+@end
+
+@implementation CPMRepositoryPackagesIndex
+@end
+
+#pragma mark - Repository
+
 @interface CPMRepository ()
 @property (readwrite, strong) NSURL *url;
 @property (strong) NSMutableData *releaseData;
 @property (strong) NSMutableData *sourcesData;
-@property (strong) NSOperationQueue *downloadQueue;
 @property (assign) CPMRepositoryFormat format;
 @property (readwrite, copy) NSURL *binaryBaseURL;
-@property (copy) void (^reloadCompletion)(NSError *);
+@property (copy) NSString *databasePath;
+@property (readwrite, copy) NSArray *acceptedArchitectures;
+@property (readwrite, copy) NSString *architectureCondition;
+// orders rows of one package by how early their architecture was accepted
+@property (copy) NSString *architectureRank;
+@property (copy) void (^reloadCompletion)(CPMPackageChanges *, NSError *);
+@property (strong) CPMRepositorySnapshot *snapshot;
+@property (readwrite, strong) CPMRefreshMetrics *refreshMetrics;
+@property (readwrite, assign) uint64_t generation;
+- (void)migrateDatabase:(FMDatabase *)db;
 - (void)obtainIndices;
 - (void)obtainReleaseIndexWithCompression:(CPMRepositoryIndexCompression)compression;
+- (void)obtainPackagesIndexes;
+- (void)obtainPackagesIndex:(CPMRepositoryPackagesIndex *)index withCompression:(CPMRepositoryIndexCompression)compression;
+- (void)obtainPackagesDiffsForIndex:(CPMRepositoryPackagesIndex *)index;
+- (void)ingestPackagesIndexes:(NSArray *)indexes listedIndexes:(NSArray *)listed;
+- (CPMPackageChanges *)changesFromWriter:(CPMPackagesWriter *)writer snapshot:(CPMRepositorySnapshot *)snapshot inDatabase:(FMDatabase *)db;
+- (void)finishReloadWithError:(NSError *)error;
+- (void)finishReloadWithChanges:(CPMPackageChanges *)changes error:(NSError *)error;
+- (CPMCurler *)curlerWithURL:(NSURL *)url conditional:(BOOL)conditional;
+- (void)recordRequest:(CPMCurler *)curl phase:(NSString *)phase;
+- (void)storeValidatorsFromResponse:(NSHTTPURLResponse *)response forURL:(NSURL *)url inDatabase:(FMDatabase *)db;
+- (NSString *)stateForKey:(NSString *)key inDatabase:(FMDatabase *)db;
+- (void)setState:(NSString *)value forKey:(NSString *)key inDatabase:(FMDatabase *)db;
+- (NSArray *)packagesIndexesInDatabase:(FMDatabase *)db;
+- (NSURL *)urlForPackagesIndex:(CPMRepositoryPackagesIndex *)index;
+- (NSString *)localPathForPackagesIndex:(CPMRepositoryPackagesIndex *)index;
 - (void)updateRepositoryInformationFromDatabase:(FMDatabase *)db;
 - (NSDictionary *)packageWithResultSet:(FMResultSet *)result;
+- (NSString *)snapshotPath;
+- (uint64_t)generationInDatabase:(FMDatabase *)db;
+- (uint64_t)snapshotTagInDatabase:(FMDatabase *)db;
+- (void)writeSnapshotFromDatabase:(FMDatabase *)db;
 @end
 
 @implementation CPMRepository
@@ -85,10 +283,41 @@ NSString *argumentsForUpdateDictionary(NSDictionary *dict) {
     return [[self alloc] initWithURL:url];
 }
 
++ (NSArray *)defaultArchitectures {
+    // dpkg lists the native architecture and any foreign ones here, one per line
+    NSString *list = [NSString stringWithContentsOfFile:@"/var/lib/dpkg/arch" encoding:NSUTF8StringEncoding error:nil];
+    NSMutableArray *architectures = [NSMutableArray array];
+    for (NSString *architecture in [list componentsSeparatedByCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]]) {
+        if (architecture.length && ![architectures containsObject:architecture])
+            [architectures addObject:architecture];
+    }
+    
+    return architectures.count ? architectures : @[ @"iphoneos-arm" ];
+}
+
 - (instancetype)initWithURL:(NSURL *)url {
+    return [self initWithURL:url architectures:[[self class] defaultArchitectures]];
+}
+
+- (instancetype)initWithURL:(NSURL *)url architectures:(NSArray *)architectures {
     if ((self = [super init])) {
-        self.downloadQueue = [[NSOperationQueue alloc] init];
         self.url = url;
+        self.acceptedArchitectures = architectures;
+        
+        // rows of flat repositories have no architecture, and "all" fits every one
+        NSMutableArray *quoted = [NSMutableArray arrayWithObjects:@"''", @"'all'", nil];
+        NSMutableString *rank = [NSMutableString stringWithString:@"case index_architecture"];
+        [architectures enumerateObjectsUsingBlock:^(NSString *architecture, NSUInteger idx, BOOL *stop) {
+            NSString *literal = [NSString stringWithFormat:@"'%@'", [architecture stringByReplacingOccurrencesOfString:@"'" withString:@"''"]];
+            [quoted addObject:literal];
+            [rank appendFormat:@" when %@ then %lu", literal, (unsigned long)idx];
+        }];
+        [rank appendFormat:@" else %lu end", (unsigned long)architectures.count];
+        self.architectureCondition = [NSString stringWithFormat:@"index_architecture in (%@)", [quoted componentsJoinedByString:@", "]];
+        self.architectureRank = rank;
+        
+        // Filename fields are relative to the archive root, which is the repository url for both layouts
+        self.binaryBaseURL = url;
         
         [[NSFileManager defaultManager] createDirectoryAtPath:LOCALSTORAGE_PATH
                                   withIntermediateDirectories:YES
@@ -96,8 +325,8 @@ NSString *argumentsForUpdateDictionary(NSDictionary *dict) {
                                                         error:nil];
         
         // Generate database path for this url:
-        NSString *dbPath = [LOCALSTORAGE_PATH stringByAppendingPathComponent:baseify(self.url)];
-        self.databaseQueue = [FMDatabaseQueue databaseQueueWithPath:dbPath];
+        self.databasePath = [LOCALSTORAGE_PATH stringByAppendingPathComponent:baseify(self.url)];
+        self.databaseQueue = [FMDatabaseQueue databaseQueueWithPath:self.databasePath];
         
         if (!self.databaseQueue) {
             //!TODO: error
@@ -107,26 +336,107 @@ NSString *argumentsForUpdateDictionary(NSDictionary *dict) {
         
         [self.databaseQueue inDatabase:^(FMDatabase *db) {
             db.shouldCacheStatements = NO;
+            
+            // WAL keeps the bulk loads in ingestPackagesIndexes: cheap to commit,
+            // and lets readerPool keep reading while they run
+            FMResultSet *mode = [db executeQuery:@"PRAGMA journal_mode = WAL"];
+            [mode next];
+            [mode close];
+            
+            [self migrateDatabase:db];
             [self updateRepositoryInformationFromDatabase:db];
+            self.generation = [self generationInDatabase:db];
+            
+            // reads are served from the snapshot; a missing or stale one is written again once
+            self.snapshot = [[CPMRepositorySnapshot alloc] initWithPath:self.snapshotPath tag:[self snapshotTagInDatabase:db]];
+            if (!self.snapshot)
+                [self writeSnapshotFromDatabase:db];
         }];
+        
+        // readers get their own connections and see the last committed state while a
+        // refresh writes through databaseQueue, which stays the only writer
+        self.readerPool = [FMDatabasePool databasePoolWithPath:self.databasePath flags:SQLITE_OPEN_READONLY];
+        self.readerPool.maximumNumberOfDatabasesToCreate = [NSProcessInfo processInfo].activeProcessorCount;
     }
     
     return self;
 }
 
-- (void)reloadData:(void (^)(NSError *error))completion; {
-    __weak CPMRepository *weakSelf = self;
-    [self.databaseQueue inDatabase:^(FMDatabase *db) {
-        [db executeUpdate:@"drop table if exists release"];
-        [db executeUpdate:@"create table release (architectures text, codename text, components text, description text, label text, suite text, version text, origin text, md5sum text, sha1 text, sha256 text)"];
-        [db executeUpdate:@"create table if not exists packages (package text primary key, size integer, version text, filename text, architecture text, maintainer text, installed_size integer, depends text, md5sum text, sha1 text, sha256 text, section text, priority text, homepage text, description text, author text, depiction text, sponsor text, icon text, name text)"];
+- (void)migrateDatabase:(FMDatabase *)db {
+    if ([db intForQuery:@"PRAGMA user_version"] < CPMRepositorySchemaVersion) {
+        // everything in here can be rebuilt from the network, so just start over
+        for (NSString *table in @[ @"release", @"packages_fts", @"packages", @"validators", @"state" ]) {
+            [db executeUpdate:[NSString stringWithFormat:@"drop table if exists %@", table]];
+        }
         
-        weakSelf.reloadCompletion = completion;
-        [weakSelf obtainIndices];
-    }];
+        // and so can the local copies of Packages indexes and the snapshot, which are all named after the database
+        NSFileManager *manager = [NSFileManager defaultManager];
+        NSString *prefix = [self.databasePath.lastPathComponent stringByAppendingString:@"."];
+        for (NSString *file in [manager contentsOfDirectoryAtPath:LOCALSTORAGE_PATH error:nil]) {
+            if ([file hasPrefix:prefix])
+                [manager removeItemAtPath:[LOCALSTORAGE_PATH stringByAppendingPathComponent:file] error:nil];
+        }
+        
+        [db executeUpdate:[NSString stringWithFormat:@"PRAGMA user_version = %d", CPMRepositorySchemaVersion]];
+    }
+    
+    [db executeUpdate:@"create table if not exists release (architectures text, codename text, components text, description text, label text, suite text, version text, origin text, md5sum text, sha1 text, sha256 text)"];
+    [db executeUpdate:@"create table if not exists packages (package text not null, size integer, version text, filename text, architecture text, maintainer text, installed_size integer, depends text, md5sum text, sha1 text, sha256 text, section text, priority text, homepage text, description text, author text, depiction text, sponsor text, icon text, name text, pre_depends text, recommends text, suggests text, enhances text, breaks text, conflicts text, provides text, replaces text, "
+     "component text not null default '', index_architecture text not null default '', stanza_hash integer, primary key (package, component, index_architecture))"];
+    
+    // an ingest reads and prunes the table one component and architecture at a time
+    [db executeUpdate:@"create index if not exists packages_slice on packages (component, index_architecture)"];
+    
+    // search index over the packages table; the triggers keep it current through every ingest
+    [db executeUpdate:@"create virtual table if not exists packages_fts using fts5(package, name, description, author, section, content='packages', content_rowid='rowid', tokenize='unicode61 remove_diacritics 1', prefix='2 3')"];
+    [db executeUpdate:@"create trigger if not exists packages_fts_insert after insert on packages begin "
+     "insert into packages_fts (rowid, package, name, description, author, section) values (new.rowid, new.package, new.name, new.description, new.author, new.section); "
+     "end"];
+    [db executeUpdate:@"create trigger if not exists packages_fts_delete after delete on packages begin "
+     "insert into packages_fts (packages_fts, rowid, package, name, description, author, section) values ('delete', old.rowid, old.package, old.name, old.description, old.author, old.section); "
+     "end"];
+    [db executeUpdate:@"create trigger if not exists packages_fts_update after update on packages begin "
+     "insert into packages_fts (packages_fts, rowid, package, name, description, author, section) values ('delete', old.rowid, old.package, old.name, old.description, old.author, old.section); "
+     "insert into packages_fts (rowid, package, name, description, author, section) values (new.rowid, new.package, new.name, new.description, new.author, new.section); "
+     "end"];
+    
+    // HTTP validators of every index we downloaded, keyed by url
+    [db executeUpdate:@"create table if not exists validators (url text primary key, etag text, last_modified text)"];
+    
+    // format: the CPMRepositoryFormat the Release index was found at
+    // packages_hash:<path>: hash the Release index published for the Packages index at path when we ingested it
+    // generation: bumped by every ingest that wrote or removed rows, a snapshot is only used if it was written for the current one
+    [db executeUpdate:@"create table if not exists state (key text primary key, value text)"];
+}
+
+- (void)reloadData:(void (^)(CPMPackageChanges *changes, NSError *error))completion; {
+    self.reloadCompletion = completion;
+    self.refreshMetrics = [[CPMRefreshMetrics alloc] initWithName:self.url.absoluteString];
+    [self obtainIndices];
+}
+
+- (void)finishReloadWithError:(NSError *)error {
+    [self finishReloadWithChanges:nil error:error];
+}
+
+- (void)finishReloadWithChanges:(CPMPackageChanges *)changes error:(NSError *)error {
+    void (^completion)(CPMPackageChanges *, NSError *) = self.reloadCompletion;
+    self.reloadCompletion = nil;
+    [self.refreshMetrics finish];
+    
+    // a refresh that went through without writing anything changed nothing
+    if (!error && !changes)
+        changes = [[CPMPackageChanges alloc] initWithAdded:nil upgraded:nil removed:nil];
+    
+    if (completion) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(error ? nil : changes, error);
+        });
+    }
 }
 
 - (void)dealloc {
+    [self.readerPool releaseAllDatabases];
     [self.databaseQueue close];
 }
 
@@ -135,20 +445,192 @@ NSString *argumentsForUpdateDictionary(NSDictionary *dict) {
 // Release, Packages, Sources
 //!TODO: Implement HTTP authentication or make the user put it into the url
 - (void)obtainIndices {
+    // start with the layout that worked last time instead of probing for it again
+    __block NSString *format = nil;
+    [self.databaseQueue inDatabase:^(FMDatabase *db) {
+        format = [self stateForKey:@"format" inDatabase:db];
+    }];
+    
+    self.format = format ? (CPMRepositoryFormat)format.integerValue : CPMRepositoryFormatFlat;
     [self obtainReleaseIndexWithCompression:CPMRepositoryIndexCompressionNone];
 }
 
-//!TODO: utilize FMDB's database queue for multitheading
-- (void)obtainPackagesIndexWithCompression:(CPMRepositoryIndexCompression)compression {
+- (void)obtainReleaseIndexWithCompression:(CPMRepositoryIndexCompression)compression {
     if (compression > CPMRepositoryIndexCompressionNone) {
-        // error...
+        if (self.format < CPMRepositoryFormatModern) {
+            self.format++;
+            [self obtainReleaseIndexWithCompression:0];
+            return;
+        }
+        
+        //!TODO: localize this
+        [self finishReloadWithError:[NSError errorWithDomain:CPMERRORDOMAIN
+                                                        code:CPMErrorUnacceptableStatusCode
+                                                    userInfo:@{ NSLocalizedFailureReasonErrorKey: @"The repository does not have a release index" }]];
         return;
     }
     
-    // find the appropriate url for the packages index
-    NSURL *packagesURL = [self urlForIndex:CPMRepositoryIndexPackages withFormat:self.format];
+    NSURL *releaseURL = [self urlForReleaseIndexWithFormat:self.format];
+    NSString *ext = extensionForCompression(compression);
+    if (ext.length > 0) {
+        releaseURL = [releaseURL URLByAppendingPathExtension:ext];
+    }
+    
+    __weak CPMRepository *weakSelf = self;
+    CPMCurler *curl = [self curlerWithURL:releaseURL conditional:YES];
+    __weak CPMCurler *weakCurl = curl;
+    curl.completionBlock = ^{
+        // if we could not find the file, progress through each supported compression format until we get a match
+        NSLog(@"%@", releaseURL);
+        [weakSelf recordRequest:weakCurl phase:@"release"];
+        [weakSelf.refreshMetrics addValue:weakCurl.bytesReceived forCounter:@"bytes_downloaded"];
+        if (weakCurl.error) {
+            [weakSelf.refreshMetrics addValue:1 forCounter:@"release_retries"];
+            [weakSelf obtainReleaseIndexWithCompression:compression + 1];
+            return;
+        }
+        
+        if (weakCurl.response.statusCode != 304) {
+            NSString *strRep = [[NSString alloc] initWithData:weakCurl.data encoding:NSUTF8StringEncoding];
+            [weakSelf.databaseQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
+                [db executeUpdate:@"delete from release"];
+                
+                NSDictionary *information = dictionarize(strRep, db, @"release");
+                NSString *format = [NSString stringWithFormat:@"insert into release %@", argumentsForUpdateDictionary(information)];
+                [db executeUpdate:format withParameterDictionary:information];
+                
+                [weakSelf storeValidatorsFromResponse:weakCurl.response forURL:releaseURL inDatabase:db];
+                [weakSelf setState:[NSString stringWithFormat:@"%lu", (unsigned long)weakSelf.format] forKey:@"format" inDatabase:db];
+                [weakSelf updateRepositoryInformationFromDatabase:db];
+            }];
+        }
+        
+        [weakSelf obtainPackagesIndexes];
+    };
+    
+    [[CPMDownloadScheduler sharedScheduler] addCurler:curl];
+}
+
+// NSURLConnection has no DNS or connect timings, so a request is measured from
+// start to first byte and from first byte to the end
+- (void)recordRequest:(CPMCurler *)curl phase:(NSString *)phase {
+    NSTimeInterval transfer = curl.responseTime ? curl.finishTime - curl.responseTime : 0;
+    NSMutableDictionary *arguments = [NSMutableDictionary dictionary];
+    arguments[@"url"] = curl.url.absoluteString;
+    arguments[@"status"] = @(curl.response.statusCode);
+    arguments[@"bytes"] = @(curl.bytesReceived);
+    arguments[@"ttfb"] = @(curl.responseTime ? curl.responseTime - curl.startTime : 0);
+    arguments[@"transfer_time"] = @(transfer);
+    arguments[@"bytes_per_second"] = @(curl.bytesReceived / MAX(transfer, 0.001));
+    if (curl.error)
+        arguments[@"error"] = curl.error.localizedDescription ?: @(curl.error.code).stringValue;
+    
+    [self.refreshMetrics recordPhase:phase start:curl.startTime end:curl.finishTime arguments:arguments];
+    [self.refreshMetrics addValue:1 forCounter:@"requests"];
+}
+
+#pragma mark - Packages Indexes
+
+// Decides how much of each Packages index has to be fetched: nothing if the
+// Release index still publishes the hash we ingested last time, only the PDiffs
+// since then if the repository offers them, or else the whole index. Whatever
+// is stale is fetched at once, and the indexes are ingested side by side.
+- (void)obtainPackagesIndexes {
+    __block NSArray *indexes = nil;
+    [self.databaseQueue inDatabase:^(FMDatabase *db) {
+        indexes = [self packagesIndexesInDatabase:db];
+    }];
+    
+    if (!indexes.count) {
+        //!TODO: localize this
+        [self finishReloadWithError:[NSError errorWithDomain:CPMERRORDOMAIN
+                                                        code:CPMErrorUnacceptableStatusCode
+                                                    userInfo:@{ NSLocalizedFailureReasonErrorKey: @"The repository does not have a packages index for this device" }]];
+        return;
+    }
+    
+    NSMutableArray *stale = [NSMutableArray array];
+    for (CPMRepositoryPackagesIndex *index in indexes) {
+        if (index.publishedHash && [index.publishedHash isEqualToString:index.ingestedHash])
+            continue;
+        
+        [stale addObject:index];
+    }
+    
+    if (!stale.count) {
+        NSLog(@"%@: packages indexes are unchanged", self.url);
+        [self finishReloadWithError:nil];
+        return;
+    }
+    
+    // the ingest only starts once every index is arriving or has ended, so it
+    // never sits waiting on a download still queued in the scheduler; until then
+    // the streams keep what arrives. It blocks on the network from then on, so
+    // it goes on the unbounded ingest queue
+    __weak CPMRepository *weakSelf = self;
+    __block NSUInteger waiting = stale.count;
+    for (CPMRepositoryPackagesIndex *index in stale) {
+        __block BOOL started = NO;
+        index.stream = [[CPMIndexStream alloc] init];
+        index.startIngest = ^{
+            @synchronized (stale) {
+                if (started)
+                    return;
+                started = YES;
+                if (--waiting)
+                    return;
+            }
+            
+            [[CPMDownloadScheduler sharedScheduler].ingestQueue addOperationWithBlock:^{
+                [weakSelf ingestPackagesIndexes:stale listedIndexes:indexes];
+            }];
+        };
+    }
+    
+    for (CPMRepositoryPackagesIndex *index in stale) {
+        if (index.offersDiffs && index.ingestedHash && [[NSFileManager defaultManager] fileExistsAtPath:[self localPathForPackagesIndex:index]]) {
+            [self obtainPackagesDiffsForIndex:index];
+        } else {
+            [self obtainPackagesIndex:index withCompression:index.compression];
+        }
+    }
+}
+
+- (void)obtainPackagesDiffsForIndex:(CPMRepositoryPackagesIndex *)index {
+    NSURL *indexURL = [[self urlForPackagesIndex:index].URLByDeletingLastPathComponent URLByAppendingPathComponent:@"Packages.diff/Index"];
+    
+    __weak CPMRepository *weakSelf = self;
+    CPMRefreshMetrics *metrics = self.refreshMetrics;
+    NSString *phase = [@"pdiff " stringByAppendingString:index.path];
+    [metrics beginPhase:phase];
+    CPMPackagesDiff *diff = [[CPMPackagesDiff alloc] initWithIndexURL:indexURL localPath:[self localPathForPackagesIndex:index]];
+    [diff patchWithCompletion:^(NSData *patched, NSError *error) {
+        [metrics endPhase:phase arguments:@{ @"patched": @(patched != nil), @"bytes": @(patched.length) }];
+        if (!patched) {
+            [metrics addValue:1 forCounter:@"pdiff_failures"];
+            NSLog(@"%@: could not apply pdiffs to %@ (%@), downloading the whole index", weakSelf.url, index.path, error.localizedFailureReason);
+            [weakSelf obtainPackagesIndex:index withCompression:index.compression];
+            return;
+        }
+        
+        // the patched index is already in memory, so it goes through the stream in one piece
+        index.startIngest();
+        [index.stream appendData:patched];
+        [index.stream finish];
+    }];
+}
+
+- (void)obtainPackagesIndex:(CPMRepositoryPackagesIndex *)index withCompression:(CPMRepositoryIndexCompression)compression {
+    if (compression > CPMRepositoryIndexCompressionNone) {
+        // only an error if no index of the repository could be found
+        index.missing = YES;
+        index.startIngest();
+        [index.stream finish];
+        return;
+    }
     
     // append correct extension for compression
+    NSURL *packagesURL = [self urlForPackagesIndex:index];
     NSString *ext = extensionForCompression(compression);
     if (ext.length > 0) {
         packagesURL = [packagesURL URLByAppendingPathExtension:ext];
@@ -157,149 +639,560 @@ NSString *argumentsForUpdateDictionary(NSDictionary *dict) {
     __weak CPMRepository *weakSelf = self;
     NSLog(@"%@", packagesURL);
     
-    // attempt to download the packages index
-    CPMCurler *curl = [[CPMCurler alloc] initWithURL:packagesURL
-                                           dataBlock:^(NSInteger bytesDownloaded, NSInteger bytesExpected, NSData *data) {
-                                               //!TODO do something with progress
-                                           }
-                                     completionBlock:nil];
+    // the index is decompressed and inserted while it downloads, so only a small
+    // window of it is ever held in memory; the consumer may push back on the
+    // connection, which only stalls this curler's own delegate queue
+    CPMRefreshMetrics *metrics = self.refreshMetrics;
+    CPMCurler *curl = [self curlerWithURL:packagesURL conditional:YES];
+    curl.dataBlock = ^(NSInteger bytesDownloaded, NSInteger bytesExpected, NSData *data) {
+        [metrics addValue:data.length forCounter:@"bytes_downloaded"];
+        index.startIngest();
+        [index.stream appendData:data];
+    };
+    curl.accumulatesData = NO;
+    
     __weak CPMCurler *weakCurl = curl;
     curl.completionBlock = ^{
+        [weakSelf recordRequest:weakCurl phase:@"packages"];
+        
         if (weakCurl.error) {
-            // we couldn't pull them down, so try a different compression extension.
+            // we couldn't pull it down, so try a different compression extension.
             // the beginning of this method has an end condition to prevent stack overflow
             if (weakCurl.error.code == CPMErrorUnacceptableStatusCode) {
-                [weakSelf obtainPackagesIndexWithCompression:compression + 1];
+                [metrics addValue:1 forCounter:@"compression_retries"];
+                [weakSelf obtainPackagesIndex:index withCompression:compression + 1];
+            } else {
+                index.startIngest();
+                [index.stream abortWithError:weakCurl.error];
             }
+            return;
+        }
+        
+        if (weakCurl.response.statusCode == 304) {
+            // same index we ingested last time
+            NSLog(@"%@: %@ is unchanged", weakSelf.url, index.path);
+            index.unchanged = YES;
         } else {
-            @autoreleasepool {
-                dispatch_async(dispatch_get_global_queue(0, DISPATCH_QUEUE_PRIORITY_HIGH), ^{
-                    NSString *package = decompress(weakCurl.data);
-                    if (!package) {
-                        if (weakSelf.reloadCompletion) {
-                            //!TODO: localize this
-                            dispatch_async(dispatch_get_main_queue(), ^{
-                                weakSelf.reloadCompletion([NSError errorWithDomain:CPMERRORDOMAIN code:CPMErrorDecompression userInfo:@{
-                                                                                                                                        NSLocalizedFailureReasonErrorKey: @"The downloaded packages index was in an unrecognizable format and could not be decompressed"
-                                                                                                                                        }]);
-                            });
-                            weakSelf.reloadCompletion = nil;
-                        }
-                        NSLog(@"could not decompress package data");
-                        return;
-                    }
-                    
-                    
-                    [weakSelf.databaseQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
-                        BOOL succ = YES;
-                        
-                        NSRange range = NSMakeRange(0, package.length);
-                        while (range.location != NSNotFound) {
-                            @autoreleasepool {
-                                if (!succ) {
-                                    if (weakSelf.reloadCompletion) {
-                                        weakSelf.reloadCompletion([NSError errorWithDomain:CPMERRORDOMAIN
-                                                                                  code:CPMErrorDatabase
-                                                                              userInfo:@{
-                                                                                         @"code": @(db.lastErrorCode),
-                                                                                         NSLocalizedDescriptionKey: @"Failed to commit changes to database, rolling back...",
-                                                                                         NSLocalizedFailureReasonErrorKey: db.lastErrorMessage
-                                                                                         }]);
-                                        weakSelf.reloadCompletion = nil;
-                                    }
-                                    NSLog(@"%@", db.lastErrorMessage);
-                                    *rollback = YES;
-                                    break;
-                                }
-                                
-                                // find the next paragraph, each is separated by a newline
-                                NSRange nextRange = [package rangeOfString:@"\n\n"
-                                                                   options:NSLiteralSearch
-                                                                     range:NSMakeRange(range.location + 2, package.length - range.location - 2)];
-                                NSUInteger end = nextRange.location;
-                                if (end == NSNotFound) {
-                                    end = package.length;
-                                }
-                                
-                                // retreive the string for the whole paragraph
-                                NSString *segment = [package substringWithRange:NSMakeRange(range.location, end - range.location)];
-                                range = nextRange;
-                                
-                                // parse the values into a dictionary
-                                NSDictionary *dict = dictionarize(segment, db, @"packages");
-                                if (dict.count == 0) {
-                                    continue;
-                                }
-                                
-                                // update the database value
-                                NSString *query = [NSString stringWithFormat:@"insert or replace into packages %@",
-                                                   argumentsForUpdateDictionary(dict)];
-                                succ = [db executeUpdate:query withParameterDictionary:dict];
-                            } //autoreleasepool
-                            
-                        } // while loop
-                        
-                        if (succ) {
-                            if (weakSelf.reloadCompletion) {
-                                dispatch_async(dispatch_get_main_queue(), ^{
-                                    weakSelf.reloadCompletion(nil);
-                                });
-                            }
-                        }
-                    }]; // inTransaction
-                    
+            index.downloadURL = packagesURL;
+            index.response = weakCurl.response;
+        }
+        
+        index.startIngest();
+        [index.stream finish];
+    };
+    
+    [[CPMDownloadScheduler sharedScheduler] addCurler:curl];
+}
+
+// Writes the stanzas of every index in one transaction, each row tagged with
+// the component and architecture of its index. SQLite has a single writer, so
+// the indexes are decompressed and split concurrently while the inserts are
+// serialized here. Only rows that changed are written: packages an index no
+// longer has are deleted from its slice, and slices of indexes that are no
+// longer listed at all go entirely. Bookkeeping is written before the commit,
+// so it only sticks if the rows do. Indexes that offer PDiffs leave an
+// uncompressed copy behind.
+- (void)ingestPackagesIndexes:(NSArray *)indexes listedIndexes:(NSArray *)listed {
+    __weak CPMRepository *weakSelf = self;
+    NSFileManager *manager = [NSFileManager defaultManager];
+    NSUInteger count = indexes.count;
+    
+    NSMutableArray *localPaths = [NSMutableArray arrayWithCapacity:count];
+    FILE **copies = calloc(count, sizeof(FILE *));
+    for (NSUInteger i = 0; i < count; i++) {
+        CPMRepositoryPackagesIndex *index = indexes[i];
+        NSString *localPath = [self localPathForPackagesIndex:index];
+        [localPaths addObject:localPath];
+        
+        // keep an uncompressed copy around only if we'll be able to patch it next time
+        if (!index.offersDiffs)
+            continue;
+        
+        copies[i] = fopen([localPath stringByAppendingPathExtension:@"partial"].fileSystemRepresentation, "wb");
+        if (copies[i]) {
+            index.stream.decompressedBlock = ^(const char *bytes, size_t length) {
+                if (copies[i] && fwrite(bytes, 1, length, copies[i]) != length) {
+                    fclose(copies[i]);
+                    copies[i] = NULL;
+                }
+            };
+        }
+    }
+    
+    // what the repository listed until now, to tell what changed
+    CPMRepositorySnapshot *snapshot = self.snapshot;
+    NSMutableSet *listedSlices = [NSMutableSet set];
+    for (CPMRepositoryPackagesIndex *index in listed) {
+        [listedSlices addObject:@[ index.component, index.architecture ]];
+    }
+    
+    CPMRefreshMetrics *metrics = self.refreshMetrics;
+    [self.databaseQueue inDatabase:^(FMDatabase *db) {
+        NSDate *start = [NSDate date];
+        [metrics beginPhase:@"ingest"];
+        CPMPackagesWriter *writer = [[CPMPackagesWriter alloc] initWithDatabase:db];
+        CPMPackageChanges *changes = nil;
+        __block NSTimeInterval insertTime = 0;
+        
+        NSError *error = nil;
+        if (![writer begin]) {
+            error = writer.error;
+            for (CPMRepositoryPackagesIndex *index in indexes) {
+                [index.stream abortWithError:error];
+            }
+        } else {
+            CPMIndexStreamGroup *group = [[CPMIndexStreamGroup alloc] initWithStreams:[indexes valueForKey:@"stream"]];
+            NSError *streamError = nil;
+            BOOL streamed = [group enumerateStanzasUsingBlock:^BOOL(const char *bytes, size_t length, NSUInteger stream) {
+                CPMRepositoryPackagesIndex *index = indexes[stream];
+                CPMStanza stanza;
+                CPMStanzaParse(bytes, length, &stanza);
+                
+                NSTimeInterval insertStart = [NSProcessInfo processInfo].systemUptime;
+                BOOL written = [writer writeStanza:&stanza component:index.component.UTF8String architecture:index.architecture.UTF8String];
+                insertTime += [NSProcessInfo processInfo].systemUptime - insertStart;
+                return written;
+            } error:&streamError];
+            
+            BOOL found = NO;
+            for (CPMRepositoryPackagesIndex *index in indexes) {
+                found |= !index.missing;
+            }
+            
+            if (streamed && found) {
+                // an index that wasn't read in full keeps its rows until it is
+                for (CPMRepositoryPackagesIndex *index in indexes) {
+                    if (!index.unchanged && !index.missing)
+                        [writer removeRowsNotWrittenInComponent:index.component.UTF8String architecture:index.architecture.UTF8String];
+                }
+                
+                FMResultSet *slices = [db executeQuery:@"select distinct component, index_architecture from packages"];
+                NSMutableArray *unlisted = [NSMutableArray array];
+                while (slices.next) {
+                    NSArray *slice = @[ [slices stringForColumnIndex:0], [slices stringForColumnIndex:1] ];
+                    if (![listedSlices containsObject:slice])
+                        [unlisted addObject:slice];
+                }
+                [slices close];
+                
+                for (NSArray *slice in unlisted) {
+                    [writer removeRowsNotWrittenInComponent:[slice[0] UTF8String] architecture:[slice[1] UTF8String]];
+                }
+            }
+            
+            if (writer.error) {
+                error = writer.error;
+                [writer rollback];
+            } else if (!streamed) {
+                NSLog(@"could not decompress package data");
+                error = streamError;
+                [writer rollback];
+            } else if (!found) {
+                //!TODO: localize this
+                error = [NSError errorWithDomain:CPMERRORDOMAIN
+                                            code:CPMErrorUnacceptableStatusCode
+                                        userInfo:@{ NSLocalizedFailureReasonErrorKey: @"The repository does not have a packages index" }];
+                [writer rollback];
+            } else {
+                for (CPMRepositoryPackagesIndex *index in indexes) {
+                    if (index.missing)
+                        continue;
                     
-                }); //dispatch_async
-            } // autoreleasepool
-        } // else
-    }; // dispatch_async
+                    [weakSelf storeValidatorsFromResponse:index.response forURL:index.downloadURL inDatabase:db];
+                    [weakSelf setState:index.publishedHash forKey:[@"packages_hash:" stringByAppendingString:index.path] inDatabase:db];
+                }
+                
+                // whatever snapshot exists is stale from here on, even if writing the new one fails
+                BOOL modified = writer.rowsWritten || writer.rowsRemoved;
+                uint64_t generation = [weakSelf generationInDatabase:db] + 1;
+                if (modified) {
+                    changes = [weakSelf changesFromWriter:writer snapshot:snapshot inDatabase:db];
+                    [weakSelf setState:@(generation).stringValue forKey:@"generation" inDatabase:db];
+                }
+                
+                if (![writer commit]) {
+                    error = writer.error;
+                } else if (modified) {
+                    weakSelf.generation = generation;
+                    [weakSelf writeSnapshotFromDatabase:db];
+                }
+            }
+        }
+        
+        // a local copy has to match what is in the database, or not exist at all
+        for (NSUInteger i = 0; i < count; i++) {
+            CPMRepositoryPackagesIndex *index = indexes[i];
+            NSString *partialPath = [localPaths[i] stringByAppendingPathExtension:@"partial"];
+            BOOL copied = copies[i] != NULL;
+            index.stream.decompressedBlock = nil;
+            index.startIngest = nil;
+            if (copied) {
+                fclose(copies[i]);
+                copies[i] = NULL;
+            }
+            
+            if (!error && !index.unchanged && !index.missing) {
+                if (copied)
+                    rename(partialPath.fileSystemRepresentation, [localPaths[i] fileSystemRepresentation]);
+                else
+                    [manager removeItemAtPath:localPaths[i] error:nil];
+            }
+            [manager removeItemAtPath:partialPath error:nil];
+        }
+        free(copies);
+        
+        NSTimeInterval elapsed = -start.timeIntervalSinceNow;
+        if (!error) {
+            NSLog(@"%@: wrote %lu packages, kept %lu and removed %lu from %lu indexes in %.2fs (%@)", weakSelf.url,
+                  (unsigned long)writer.rowsWritten, (unsigned long)writer.rowsUnchanged, (unsigned long)writer.rowsRemoved, (unsigned long)count, elapsed, changes);
+        }
+        
+        NSUInteger stanzas = 0;
+        uint64_t compressed = 0, decompressed = 0;
+        NSTimeInterval decompressTime = 0;
+        for (CPMRepositoryPackagesIndex *index in indexes) {
+            stanzas += index.stream.stanzaCount;
+            compressed += index.stream.compressedBytes;
+            decompressed += index.stream.decompressedBytes;
+            decompressTime += index.stream.decompressTime;
+        }
+        
+        [metrics endPhase:@"ingest" arguments:@{ @"indexes": @(count),
+                                                 @"rows_written": @(writer.rowsWritten),
+                                                 @"rows_unchanged": @(writer.rowsUnchanged),
+                                                 @"rows_removed": @(writer.rowsRemoved),
+                                                 @"added": @(changes.added.count),
+                                                 @"upgraded": @(changes.upgraded.count),
+                                                 @"removed": @(changes.removed.count),
+                                                 @"stanzas": @(stanzas),
+                                                 @"stanzas_per_second": @(stanzas / MAX(elapsed, 0.001)),
+                                                 @"insert_time": @(insertTime),
+                                                 @"decompress_time": @(decompressTime),
+                                                 @"compressed_bytes": @(compressed),
+                                                 @"decompressed_bytes": @(decompressed),
+                                                 @"ratio": @(decompressed / (double)MAX(compressed, 1)),
+                                                 @"failed": @(error != nil) }];
+        [metrics addValue:writer.rowsWritten forCounter:@"rows_written"];
+        [metrics addValue:writer.rowsRemoved forCounter:@"rows_removed"];
+        
+        [weakSelf finishReloadWithChanges:changes error:error];
+    }];
+}
+
+// Turns the rows the writer touched into what changed about the packages the
+// repository lists. The version a package was listed with comes from the
+// snapshot of the last generation if there is one, or else from the writer;
+// only packages that may have changed are looked up again.
+- (CPMPackageChanges *)changesFromWriter:(CPMPackagesWriter *)writer snapshot:(CPMRepositorySnapshot *)snapshot inDatabase:(FMDatabase *)db {
+    NSMutableSet *added = [NSMutableSet set];
+    NSMutableSet *upgraded = [NSMutableSet set];
+    NSMutableSet *removed = [NSMutableSet set];
+    NSString *query = [NSString stringWithFormat:@"select version from packages where package = ? and %@ order by %@, component limit 1", self.architectureCondition, self.architectureRank];
     
-    [self.downloadQueue addOperation:curl];
+    NSDictionary *changed = writer.changedPackages;
+    for (NSString *package in changed) {
+        id before = changed[package];
+        if (snapshot) {
+            const char *name = package.UTF8String;
+            uint32_t row = CPMSnapshotFind(&snapshot->_snapshot, name, strlen(name));
+            before = row == UINT32_MAX ? [NSNull null] : @(CPMSnapshotValue(&snapshot->_snapshot, row, CPMStanzaFieldVersion));
+        }
+        
+        // a package that wasn't listed and got a row of an accepted architecture is listed now
+        if (before == [NSNull null] && changed[package] == [NSNull null]) {
+            [added addObject:package];
+            continue;
+        }
+        
+        NSString *after = [db stringForQuery:query, package];
+        if (before == [NSNull null]) {
+            if (after)
+                [added addObject:package];
+        } else if (!after) {
+            [removed addObject:package];
+        } else if (![after isEqualToString:before]) {
+            [upgraded addObject:package];
+        }
+    }
+    
+    return [[CPMPackageChanges alloc] initWithAdded:added upgraded:upgraded removed:removed];
 }
 
-- (void)obtainReleaseIndexWithCompression:(CPMRepositoryIndexCompression)compression {
-    if (compression > CPMRepositoryIndexCompressionNone) {
-        if (self.format < CPMRepositoryFormatModern) {
-            self.format++;
-            [self obtainReleaseIndexWithCompression:0];
-            return;
+#pragma mark - Index State
+
+- (CPMCurler *)curlerWithURL:(NSURL *)url conditional:(BOOL)conditional {
+    CPMCurler *curl = [[CPMCurler alloc] initWithURL:url dataBlock:nil completionBlock:nil];
+    
+    if (conditional) {
+        // not through databaseQueue: an ingest holds it while waiting on the very requests made here
+        NSMutableDictionary *headers = [NSMutableDictionary dictionary];
+        [self.readerPool inDatabase:^(FMDatabase *db) {
+            FMResultSet *results = [db executeQuery:@"select etag, last_modified from validators where url = ?", url.absoluteString];
+            if (results.next) {
+                NSString *etag = [results stringForColumn:@"etag"];
+                NSString *lastModified = [results stringForColumn:@"last_modified"];
+                if (etag)
+                    headers[@"If-None-Match"] = etag;
+                if (lastModified)
+                    headers[@"If-Modified-Since"] = lastModified;
+            }
+            [results close];
+        }];
+        
+        curl.requestHeaders = headers;
+    }
+    
+    return curl;
+}
+
+- (void)storeValidatorsFromResponse:(NSHTTPURLResponse *)response forURL:(NSURL *)url inDatabase:(FMDatabase *)db {
+    if (!response || response.statusCode != 200)
+        return;
+    
+    NSString *etag = nil;
+    NSString *lastModified = nil;
+    for (NSString *field in response.allHeaderFields) {
+        if ([field caseInsensitiveCompare:@"ETag"] == NSOrderedSame) {
+            etag = response.allHeaderFields[field];
+        } else if ([field caseInsensitiveCompare:@"Last-Modified"] == NSOrderedSame) {
+            lastModified = response.allHeaderFields[field];
+        }
+    }
+    
+    if (etag || lastModified) {
+        [db executeUpdate:@"insert or replace into validators (url, etag, last_modified) values (?, ?, ?)",
+         url.absoluteString, etag ?: [NSNull null], lastModified ?: [NSNull null]];
+    } else {
+        [db executeUpdate:@"delete from validators where url = ?", url.absoluteString];
+    }
+}
+
+- (NSString *)stateForKey:(NSString *)key inDatabase:(FMDatabase *)db {
+    return [db stringForQuery:@"select value from state where key = ?", key];
+}
+
+- (void)setState:(NSString *)value forKey:(NSString *)key inDatabase:(FMDatabase *)db {
+    if (value) {
+        [db executeUpdate:@"insert or replace into state (key, value) values (?, ?)", key, value];
+    } else {
+        [db executeUpdate:@"delete from state where key = ?", key];
+    }
+}
+
+// Every Packages index the Release index lists, or if it lists none, the ones
+// its Components and Architectures fields add up to, which are then probed for
+- (NSArray *)packagesIndexesInDatabase:(FMDatabase *)db {
+    NSMutableDictionary *indexes = [NSMutableDictionary dictionary];
+    NSMutableDictionary *variants = [NSMutableDictionary dictionary];
+    NSSet *diffIndexes = nil;
+    NSString *components = nil;
+    NSString *architectures = nil;
+    
+    FMResultSet *results = [db executeQuery:@"select components, architectures, md5sum, sha1, sha256 from release limit 1"];
+    if (results.next) {
+        components = [results stringForColumn:@"components"];
+        architectures = [results stringForColumn:@"architectures"];
+        
+        NSMutableSet *diffs = [NSMutableSet set];
+        for (NSString *algorithm in @[ @"sha256", @"sha1", @"md5sum" ]) {
+            NSDictionary *hashes = hashesFromReleaseListing([results stringForColumn:algorithm]);
+            for (NSString *listed in hashes) {
+                if ([listed.lastPathComponent isEqualToString:@"Index"] && [listed.stringByDeletingLastPathComponent.lastPathComponent isEqualToString:@"Packages.diff"]) {
+                    [diffs addObject:[listed.stringByDeletingLastPathComponent.stringByDeletingLastPathComponent stringByAppendingPathComponent:@"Packages"]];
+                    continue;
+                }
+                
+                NSString *path = listed;
+                NSString *ext = @"";
+                if (![path.lastPathComponent isEqualToString:@"Packages"]) {
+                    ext = path.pathExtension;
+                    path = path.stringByDeletingPathExtension;
+                }
+                if (![path.lastPathComponent isEqualToString:@"Packages"])
+                    continue;
+                
+                // <component>/binary-<architecture>/Packages, where the component may have slashes of its own
+                NSString *component = @"";
+                NSString *architecture = @"";
+                if (self.format == CPMRepositoryFormatModern) {
+                    NSString *binary = path.stringByDeletingLastPathComponent.lastPathComponent;
+                    component = path.stringByDeletingLastPathComponent.stringByDeletingLastPathComponent;
+                    if (![binary hasPrefix:@"binary-"] || binary.length <= 7 || !component.length)
+                        continue;
+                    architecture = [binary substringFromIndex:7];
+                } else if (![path isEqualToString:@"Packages"]) {
+                    continue;
+                }
+                
+                CPMRepositoryPackagesIndex *index = indexes[path];
+                if (!index) {
+                    index = [[CPMRepositoryPackagesIndex alloc] init];
+                    index.component = component;
+                    index.architecture = architecture;
+                    index.path = path;
+                    indexes[path] = index;
+                    variants[path] = [NSMutableSet set];
+                }
+                [variants[path] addObject:ext];
+            }
+            
+            // prefer the uncompressed index's hash, it doesn't depend on which compression we end up with
+            for (CPMRepositoryPackagesIndex *index in indexes.allValues) {
+                for (NSString *ext in @[ @"", @"xz", @"bz2", @"gz", @"lzma", @"lz" ]) {
+                    NSString *hash = hashes[ext.length ? [index.path stringByAppendingPathExtension:ext] : index.path];
+                    if (!index.publishedHash && hash) {
+                        index.publishedHash = [NSString stringWithFormat:@"%@:%@", algorithm, hash];
+                    }
+                }
+            }
+        }
+        diffIndexes = diffs;
+    }
+    [results close];
+    
+    if (!indexes.count) {
+        NSArray *paths = @[ @"Packages" ];
+        if (self.format == CPMRepositoryFormatModern) {
+            NSMutableArray *modern = [NSMutableArray array];
+            NSCharacterSet *whitespace = [NSCharacterSet whitespaceAndNewlineCharacterSet];
+            NSMutableArray *componentList = [[components componentsSeparatedByCharactersInSet:whitespace] mutableCopy] ?: [NSMutableArray array];
+            NSMutableArray *architectureList = [[architectures componentsSeparatedByCharactersInSet:whitespace] mutableCopy] ?: [NSMutableArray array];
+            [componentList removeObject:@""];
+            [architectureList removeObject:@""];
+            
+            // if none specific, default to main
+            for (NSString *component in componentList.count ? componentList : @[ @"main" ]) {
+                for (NSString *architecture in architectureList.count ? architectureList : @[ @"iphoneos-arm" ]) {
+                    [modern addObject:[NSString stringWithFormat:@"%@/binary-%@/Packages", component, architecture]];
+                }
+            }
+            paths = modern;
+        }
+        
+        for (NSString *path in paths) {
+            CPMRepositoryPackagesIndex *index = [[CPMRepositoryPackagesIndex alloc] init];
+            index.path = path;
+            index.component = self.format == CPMRepositoryFormatModern ? path.stringByDeletingLastPathComponent.stringByDeletingLastPathComponent : @"";
+            index.architecture = self.format == CPMRepositoryFormatModern ? [path.stringByDeletingLastPathComponent.lastPathComponent substringFromIndex:7] : @"";
+            indexes[path] = index;
+        }
+    }
+    
+    NSMutableArray *list = [NSMutableArray array];
+    for (NSString *path in [indexes.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+        CPMRepositoryPackagesIndex *index = indexes[path];
+        
+        // only fetch indexes of architectures we accept
+        if (index.architecture.length && ![index.architecture isEqualToString:@"all"] && ![self.acceptedArchitectures containsObject:index.architecture])
+            continue;
+        
+        // download the smallest variant the repository says it has, instead of probing for one
+        index.compression = CPMRepositoryIndexCompressionLZMA;
+        for (NSNumber *candidate in @[ @(CPMRepositoryIndexCompressionXZ), @(CPMRepositoryIndexCompressionLZMA), @(CPMRepositoryIndexCompressionBzip2), @(CPMRepositoryIndexCompressionLZIP), @(CPMRepositoryIndexCompressionGzip2), @(CPMRepositoryIndexCompressionNone) ]) {
+            if ([variants[path] containsObject:extensionForCompression(candidate.unsignedIntegerValue)]) {
+                index.compression = candidate.unsignedIntegerValue;
+                break;
+            }
         }
-        // error...
+        
+        index.offersDiffs = [diffIndexes containsObject:path];
+        index.ingestedHash = [self stateForKey:[@"packages_hash:" stringByAppendingString:path] inDatabase:db];
+        [list addObject:index];
+    }
+    
+    return list;
+}
+
+// Packages indexes are listed relative to the Release index
+- (NSURL *)urlForPackagesIndex:(CPMRepositoryPackagesIndex *)index {
+    NSURL *releaseURL = [self urlForReleaseIndexWithFormat:self.format];
+    return [releaseURL.URLByDeletingLastPathComponent URLByAppendingPathComponent:index.path];
+}
+
+// uncompressed copy of the last ingested Packages index, kept for PDiffs; the
+// one of a flat repository keeps the name it always had
+- (NSString *)localPathForPackagesIndex:(CPMRepositoryPackagesIndex *)index {
+    return [self.databasePath stringByAppendingFormat:@".%@", [index.path stringByReplacingOccurrencesOfString:@"/" withString:@"_"]];
+}
+
+// read-optimized copy of the packages table, rewritten after every ingest
+- (NSString *)snapshotPath {
+    return [self.databasePath stringByAppendingString:@".snapshot"];
+}
+
+- (uint64_t)generationInDatabase:(FMDatabase *)db {
+    return strtoull([self stateForKey:@"generation" inDatabase:db].UTF8String ?: "0", NULL, 10);
+}
+
+// A snapshot holds one generation of the table as filtered for one set of
+// architectures, so both go into its tag
+- (uint64_t)snapshotTagInDatabase:(FMDatabase *)db {
+    // FNV-1a over the filter, then the generation
+    uint64_t tag = 14695981039346656037ULL;
+    for (const char *c = self.architectureCondition.UTF8String; *c; c++) {
+        tag = (tag ^ (uint8_t)*c) * 1099511628211ULL;
+    }
+    
+    uint64_t generation = [self generationInDatabase:db];
+    for (int i = 0; i < 8; i++) {
+        tag = (tag ^ ((generation >> (i * 8)) & 0xff)) * 1099511628211ULL;
+    }
+    
+    return tag;
+}
+
+- (void)writeSnapshotFromDatabase:(FMDatabase *)db {
+    NSDate *start = [NSDate date];
+    [self.refreshMetrics beginPhase:@"snapshot"];
+    uint64_t tag = [self snapshotTagInDatabase:db];
+    
+    NSMutableArray *columns = [NSMutableArray array];
+    for (int field = 0; field < CPMRepositorySnapshotFieldCount; field++) {
+        [columns addObject:@(CPMStanzaFieldColumn(field))];
+    }
+    // a package listed for several architectures or components is kept once:
+    // the earliest accepted architecture wins, then the first component
+    NSString *query = [NSString stringWithFormat:@"select %@ from packages where %@ order by package, %@, component",
+                       [columns componentsJoinedByString:@", "], self.architectureCondition, self.architectureRank];
+    
+    sqlite3_stmt *statement = NULL;
+    if (sqlite3_prepare_v2(db.sqliteHandle, query.UTF8String, -1, &statement, NULL) != SQLITE_OK) {
+        NSLog(@"could not snapshot packages: %s", sqlite3_errmsg(db.sqliteHandle));
+        [self.refreshMetrics endPhase:@"snapshot" arguments:@{ @"written": @NO }];
         return;
     }
     
-    NSURL *releaseURL = [self urlForIndex:CPMRepositoryIndexRelease
-                               withFormat:self.format];
-    NSString *ext = extensionForCompression(compression);
-    if (ext.length > 0) {
-        releaseURL = [releaseURL URLByAppendingPathExtension:ext];
+    CPMSnapshotWriter *writer = CPMSnapshotWriterCreate(CPMRepositorySnapshotFieldCount, CPMStanzaFieldPackage, CPMStanzaFieldSection);
+    const char *values[CPMRepositorySnapshotFieldCount];
+    size_t lengths[CPMRepositorySnapshotFieldCount];
+    NSMutableData *previous = [NSMutableData data];
+    while (sqlite3_step(statement) == SQLITE_ROW) {
+        for (int field = 0; field < CPMRepositorySnapshotFieldCount; field++) {
+            values[field] = (const char *)sqlite3_column_text(statement, field);
+            lengths[field] = (size_t)sqlite3_column_bytes(statement, field);
+        }
+        
+        const char *package = values[CPMStanzaFieldPackage];
+        size_t length = lengths[CPMStanzaFieldPackage];
+        if (previous.length == length && memcmp(previous.bytes, package, length) == 0)
+            continue;
+        [previous setData:[NSData dataWithBytesNoCopy:(void *)package length:length freeWhenDone:NO]];
+        
+        CPMSnapshotWriterAddRow(writer, values, lengths);
     }
+    sqlite3_finalize(statement);
     
-    __weak CPMRepository *weakSelf = self;
-    [NSURLConnection sendAsynchronousRequest:[NSURLRequest requestWithURL:releaseURL
-                                                              cachePolicy:NSURLRequestReloadIgnoringLocalCacheData
-                                                          timeoutInterval:5]
-                                       queue:self.downloadQueue
-                           completionHandler:^(NSURLResponse *response, NSData *data, NSError *connectionError) {
-                               // if we could not find the file, progress through each supported compression format until we get a match
-                               NSLog(@"%@", releaseURL);
-                               if (connectionError || ((NSHTTPURLResponse *)response).statusCode != 200) {
-                                   return [weakSelf obtainReleaseIndexWithCompression:compression + 1];
-                               } else if (data) {
-                                   NSString *strRep = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
-                                   [weakSelf.databaseQueue inDatabase:^(FMDatabase *db) {
-                                       NSDictionary *information = dictionarize(strRep, db, @"release");
-                                       NSString *format = [NSString stringWithFormat:@"insert into release %@", argumentsForUpdateDictionary(information)];
-                                       [db executeUpdate:format withParameterDictionary:information];
-                                   }];
-                                   
-                                   [weakSelf.databaseQueue inDatabase:^(FMDatabase *db) {
-                                       [weakSelf updateRepositoryInformationFromDatabase:db];
-                                   }];
-                                   
-                                   [weakSelf obtainPackagesIndexWithCompression:CPMRepositoryIndexCompressionLZMA];
-                               }
-                           }];
+    int written = CPMSnapshotWriterWrite(writer, self.snapshotPath.fileSystemRepresentation, tag);
+    CPMSnapshotWriterFree(writer);
+    
+    self.snapshot = written == 0 ? [[CPMRepositorySnapshot alloc] initWithPath:self.snapshotPath tag:tag] : nil;
+    if (!self.snapshot) {
+        NSLog(@"%@: could not write a snapshot: %s", self.url, strerror(errno));
+        [[NSFileManager defaultManager] removeItemAtPath:self.snapshotPath error:nil];
+    } else {
+        NSLog(@"%@: wrote a snapshot of %u packages in %.3fs", self.url, CPMSnapshotCount(&self.snapshot->_snapshot), -start.timeIntervalSinceNow);
+    }
+    [self.refreshMetrics endPhase:@"snapshot" arguments:@{ @"written": @(self.snapshot != nil) }];
 }
 
 - (void)updateRepositoryInformationFromDatabase:(FMDatabase *)db {
@@ -316,10 +1209,22 @@ NSString *argumentsForUpdateDictionary(NSDictionary *dict) {
 #pragma mark - API
 
 - (NSArray *)listPackages {
+    CPMRepositorySnapshot *snapshot = self.snapshot;
+    if (snapshot) {
+        uint32_t count = CPMSnapshotCount(&snapshot->_snapshot);
+        NSMutableArray *list = [NSMutableArray arrayWithCapacity:count];
+        for (uint32_t i = 0; i < count; i++) {
+            [list addObject:[[CPMSnapshotPackage alloc] initWithSnapshot:snapshot row:snapshot->_snapshot.identifiers[i] url:self.url]];
+        }
+        
+        return list;
+    }
+    
     __block NSMutableArray *list = [NSMutableArray array];
     
-    [self.databaseQueue inDatabase:^(FMDatabase *db) {
-        FMResultSet *results = [db executeQuery:@"select package, name, description, icon, version, section from packages"];
+    [self.readerPool inDatabase:^(FMDatabase *db) {
+        NSString *query = [NSString stringWithFormat:@"select package, name, description, icon, version, section from packages where %@", self.architectureCondition];
+        FMResultSet *results = [db executeQuery:query];
         while ([results next]) {
             [list addObject:[self packageWithResultSet:results]];
         }
@@ -331,38 +1236,61 @@ NSString *argumentsForUpdateDictionary(NSDictionary *dict) {
 }
 
 - (NSArray *)searchForPackage:(NSString *)input {
+    return [self searchForPackage:input limit:CPMRepositorySearchLimit];
+}
+
+- (NSArray *)searchForPackage:(NSString *)input limit:(NSUInteger)limit {
     __block NSMutableArray *list = [NSMutableArray array];
+    NSString *match = matchExpressionForQuery(input);
+    if (!match || !limit)
+        return list;
     
-    [self.databaseQueue inDatabase:^(FMDatabase *db) {
-        NSString *query = [NSString stringWithFormat:@"select * from packages where name like '%%%@%%'", input];
-        FMResultSet *results = [db executeQuery:query];
+    [self.readerPool inDatabase:^(FMDatabase *db) {
+        // name hits count the most, then the identifier, author and the rest; a package
+        // is in every index it was published in, so only the row packageWithIdentifier:
+        // would pick counts
+        NSString *query = [NSString stringWithFormat:@"with hits as (select packages.rowid as id, bm25(packages_fts, 5.0, 10.0, 1.0, 2.0, 1.0) as score, "
+                           "row_number() over (partition by packages.package order by %@, packages.component) as pick from packages_fts "
+                           "join packages on packages.rowid = packages_fts.rowid "
+                           "where packages_fts match ? and packages.%@) "
+                           "select packages.*, hits.score as score from hits join packages on packages.rowid = hits.id "
+                           "where hits.pick = 1 order by hits.score limit ?", self.architectureRank, self.architectureCondition];
+        FMResultSet *results = [db executeQuery:query, match, @(limit)];
         while ([results next]) {
             [list addObject:[self packageWithResultSet:results]];
         }
         
         [results close];
-        
     }];
     
+    // bm25 depends on the statistics of this repository's corpus, so other
+    // repositories' scores can only be compared with relative to their best
+    double best = [[list.firstObject objectForKey:@"score"] doubleValue];
+    for (NSMutableDictionary *package in list) {
+        package[@"relevance"] = @(best < 0 ? [package[@"score"] doubleValue] / best : 1.0);
+    }
+    
     return list;
 }
 
 - (NSDictionary *)packageWithIdentifier:(NSString *)identifier {
+    CPMRepositorySnapshot *snapshot = self.snapshot;
+    if (snapshot) {
+        const char *name = identifier.UTF8String;
+        uint32_t row = CPMSnapshotFind(&snapshot->_snapshot, name, strlen(name));
+        return row == UINT32_MAX ? nil : [[CPMSnapshotPackage alloc] initWithSnapshot:snapshot row:row url:self.url];
+    }
+    
     __block NSDictionary *dict = [NSMutableDictionary dictionary];
     
-    [self.databaseQueue inDatabase:^(FMDatabase *db) {
-        NSString *query = [NSString stringWithFormat:@"select * from packages where package is '%@' limit 2", identifier];
-        FMResultSet *results = [db executeQuery:query];
+    [self.readerPool inDatabase:^(FMDatabase *db) {
+        // the same row the snapshot would have kept
+        NSString *query = [NSString stringWithFormat:@"select * from packages where package = ? and %@ order by %@, component limit 1", self.architectureCondition, self.architectureRank];
+        FMResultSet *results = [db executeQuery:query, identifier];
 
         [results next];
         
         dict = [self packageWithResultSet:results];
-        
-        [results next];
-        if (results.hasAnotherRow) {
-            NSLog(@"too many items with the same identifier");
-            dict = nil;
-        }
         [results close];
     }];
     
@@ -370,9 +1298,20 @@ NSString *argumentsForUpdateDictionary(NSDictionary *dict) {
 }
 
 - (NSSet *)groupNames {
+    CPMRepositorySnapshot *snapshot = self.snapshot;
+    if (snapshot) {
+        const CPMSnapshotHeader *header = snapshot->_snapshot.header;
+        NSMutableSet *groups = [NSMutableSet setWithCapacity:header->sectionCount];
+        for (uint32_t i = 0; i < header->sectionCount; i++) {
+            [groups addObject:@(CPMSnapshotString(&snapshot->_snapshot, snapshot->_snapshot.sections[i].name))];
+        }
+        
+        return groups;
+    }
+    
     __block NSSet *groups = nil;
-    [self.databaseQueue inDatabase:^(FMDatabase *db) {
-        FMResultSet *result = [db executeQuery:@"select distinct section from packages"];
+    [self.readerPool inDatabase:^(FMDatabase *db) {
+        FMResultSet *result = [db executeQuery:[NSString stringWithFormat:@"select distinct section from packages where %@", self.architectureCondition]];
         NSDictionary *results = result.resultDictionary;
         if (results.count)
             groups = [NSSet setWithArray:(NSArray *)results[@"section"]];
@@ -384,12 +1323,28 @@ NSString *argumentsForUpdateDictionary(NSDictionary *dict) {
 }
 
 - (NSArray *)packagesInGroup:(NSString *)group {
+    CPMRepositorySnapshot *snapshot = self.snapshot;
+    if (snapshot) {
+        const char *name = group.UTF8String;
+        uint32_t count = 0;
+        const uint32_t *rows = CPMSnapshotSectionRows(&snapshot->_snapshot, CPMSnapshotFindSection(&snapshot->_snapshot, name, strlen(name)), &count);
+        
+        NSMutableArray *packages = [NSMutableArray arrayWithCapacity:count];
+        for (uint32_t i = 0; i < count; i++) {
+            [packages addObject:[[CPMSnapshotPackage alloc] initWithSnapshot:snapshot row:rows[i] url:self.url]];
+        }
+        
+        return packages;
+    }
+    
     __block NSMutableArray *packages = [NSMutableArray array];
-    [self.databaseQueue inDatabase:^(FMDatabase *db) {
-        FMResultSet *results = [db executeQueryWithFormat:@"select * in packages where section is '%@'", group];
+    [self.readerPool inDatabase:^(FMDatabase *db) {
+        NSString *query = [NSString stringWithFormat:@"select * from packages where section = ? and %@", self.architectureCondition];
+        FMResultSet *results = [db executeQuery:query, group];
         while (results.next) {
             [packages addObject:[self packageWithResultSet:results]];
         }
+        [results close];
     }];
     
     return packages;
@@ -399,9 +1354,18 @@ NSString *argumentsForUpdateDictionary(NSDictionary *dict) {
 
 - (NSDictionary *)packageWithResultSet:(FMResultSet *)results {
     NSDictionary *map = results.columnNameToIndexMap;
+    // bookkeeping of the ingest, which the snapshot doesn't carry either
+    static NSSet *internalColumns = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        internalColumns = [NSSet setWithObjects:@"component", @"index_architecture", @"stanza_hash", nil];
+    });
 
     NSMutableDictionary *dict = [NSMutableDictionary dictionary];
     for (NSString *key in map) {
+        if ([internalColumns containsObject:key])
+            continue;
+        
         id value = [results objectForColumnName:key];
         if (value && ![value isKindOfClass:[NSNull class]]) {
             dict[key] = value;
@@ -413,63 +1377,9 @@ NSString *argumentsForUpdateDictionary(NSDictionary *dict) {
     return dict;
 }
 
-- (NSURL *)urlForIndex:(CPMRepositoryIndex)index withFormat:(CPMRepositoryFormat)format {
-    NSString *components = @"";
-    switch (format) {
-        case CPMRepositoryFormatFlat:
-            switch (index) {
-                case CPMRepositoryIndexRelease:
-                    components = @"Release";
-                    break;
-                case CPMRepositoryIndexPackages:
-                    components = @"Packages";
-                    break;
-                case CPMRepositoryIndexSources:
-                    components = @"Sources";
-                    break;
-                default:
-                    break;
-            }
-            break;
-        case CPMRepositoryFormatModern:
-            switch (index) {
-                case CPMRepositoryIndexRelease:
-                    components = @"dists/stable/Release";
-                    break;
-                case CPMRepositoryIndexPackages: {
-                    __block NSString *comps = nil;
-                    [self.databaseQueue inDatabase:^(FMDatabase *db) {
-                        FMResultSet *results = [db executeQuery:@"select components from release limit 1"];
-                        // use the first component from the release index
-                        // if none specific, default to main
-                        NSString *component = @"main";
-                        if (results.next) {
-                            NSString *res = [results stringForColumn:@"components"];
-                            NSArray *separated = [res componentsSeparatedByString:@" "];
-                            if (separated.count)
-                                comps = separated[0];
-                        }
-                        //!TODO: make sure architectures matches what we want somewhere, and if not, error out
-                        comps = [NSString stringWithFormat:@"dists/stable/%@/binary-iphoneos-arm/Packages", component];
-                        
-                        [results close];
-                    }];
-                    
-                    components = comps;
-                    break;
-                }
-                case CPMRepositoryIndexSources:
-                    components = @"dists/stable/main/binary-iphoneos-arm/Sources";
-                    break;
-                default:
-                    break;
-            }
-            break;
-        default:
-            break;
-    }
-    
-    return [self.url URLByAppendingPathComponent:components];
+// every other index is listed in the Release index, relative to it
+- (NSURL *)urlForReleaseIndexWithFormat:(CPMRepositoryFormat)format {
+    return [self.url URLByAppendingPathComponent:format == CPMRepositoryFormatModern ? @"dists/stable/Release" : @"Release"];
 }
 
 @end
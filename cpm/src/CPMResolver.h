@@ -0,0 +1,51 @@
+//
+//  CPMResolver.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "CPMPackageIndex.h"
+
+// What has to happen to install a set of packages.
+@interface CPMTransaction : NSObject
+// Packages to download and install, as dictionaries from the package index.
+// Every package comes after the packages it depends on.
+@property (readonly, copy) NSArray *installs;
+// Identifiers of installed packages that have to be removed because a new
+// package conflicts with and replaces them.
+@property (readonly, copy) NSArray *removals;
+@end
+
+// Works out the install transaction for a request over every package of every
+// repository in a CPMPackageIndex.
+//
+// Every chosen package's dependencies are resolved in turn. A relation that
+// isn't met already gets the newest version of a real package that satisfies
+// it, or else of a package that provides it; candidates that would conflict
+// with the transaction so far are skipped in favour of the next one, with no
+// further backtracking. Pre-Depends, Depends, Conflicts, Breaks, Provides and
+// Replaces are honoured; Recommends and Suggests are not installed. Package
+// names are interned once per resolution, so the solver mostly compares small
+// integer ids.
+@interface CPMResolver : NSObject
+@property (readonly, strong) CPMPackageIndex *packageIndex;
+
+// Architectures packages may be built for, besides "all", native one first.
+// Architecture restrictions in relations are checked against the native one.
+// Defaults to +[CPMRepository defaultArchitectures].
+@property (copy) NSArray *architectures;
+
+// What is installed already, as dictionaries with at least "package" and
+// "version", and optionally "provides", "conflicts" and "breaks".
+@property (copy) NSArray *installedPackages;
+
+- (instancetype)initWithPackageIndex:(CPMPackageIndex *)index;
+
+// Returns nil and a CPMErrorUnresolvable error naming the package under
+// CPMErrorPackageKey if some dependency cannot be met.
+- (CPMTransaction *)transactionForInstallingIdentifiers:(NSArray *)identifiers error:(NSError **)error;
+
+@end
@@ -0,0 +1,728 @@
+//
+//  CPMResolver.m
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#import "CPMResolver.h"
+#import "CPMRepository.h"
+#import "CPDefines.h"
+#import "relationship.h"
+#import "strpool.h"
+#import "version.h"
+
+#define CPMResolverNone    (-1)
+#define CPMResolverNoOwner INT32_MIN
+
+#define CPMResolverGrow(array, count, capacity) do { \
+    if ((count) == (capacity)) { \
+        (capacity) = (capacity) ? (capacity) * 2 : 64; \
+        (array) = realloc((array), (capacity) * sizeof(*(array))); \
+    } \
+} while (0)
+
+// A package version picked for the transaction, with its fields interned
+typedef struct {
+    uint32_t name;
+    CPMPackageOrigin origin;
+    uint32_t values[CPMPackageIndexFieldCount];
+} CPMResolverChoice;
+
+// Owners below are choices when >= 0, and installed package -owner - 1 otherwise.
+typedef struct {
+    int32_t owner;
+    uint32_t version; // 0 for an unversioned Provides
+    int32_t next;
+} CPMResolverProvide;
+
+typedef struct {
+    int32_t owner;
+    CPMRelationOperator op;
+    uint32_t version;
+    int32_t next;
+} CPMResolverConflict;
+
+typedef struct {
+    uint32_t name;
+    uint32_t version;
+    uint32_t provides;
+    uint32_t conflicts;
+    uint32_t breaks;
+} CPMResolverInstalled;
+
+// Parses a relationship field. The relations point into *copy, which the
+// caller frees along with *relations.
+static size_t parseRelations(const char *field, const char *architecture, char **copy, CPMRelation **relations) {
+    size_t length = strlen(field);
+    *copy = malloc(length + 1);
+    memcpy(*copy, field, length + 1);
+
+    size_t count = CPMRelationParse(*copy, length, architecture, NULL, 0);
+    *relations = malloc(MAX(count, 1) * sizeof(CPMRelation));
+    CPMRelationParse(*copy, length, architecture, *relations, count);
+
+    return count;
+}
+
+static BOOL versionSatisfies(CPMRelationOperator op, const char *required, const char *version) {
+    CPMRelation relation = { .op = op, .version = required, .versionLength = strlen(required) };
+    return CPMRelationSatisfiedBy(&relation, version, strlen(version));
+}
+
+#pragma mark - Resolution
+
+// The state of a single call to -transactionForInstallingIdentifiers:error:.
+// Everything is indexed by interned name id or by choice index.
+@interface CPMResolution : NSObject {
+    CPMPackageIndex *_index;
+    // the native one is first
+    char **_architectures;
+    size_t _architectureCount;
+    const char *_architecture;
+    CPMStringPool _strings;
+
+    // per name id
+    uint32_t _nameCapacity;
+    int32_t *_selected;
+    int32_t *_installedIndex;
+    uint8_t *_removed;
+    int32_t *_provideHead;
+    int32_t *_conflictHead;
+
+    CPMResolverChoice *_choices;
+    uint32_t _choiceCount;
+    uint32_t _choiceCapacity;
+
+    CPMResolverInstalled *_installed;
+    uint32_t _installedCount;
+    uint32_t _installedCapacity;
+
+    CPMResolverProvide *_provides;
+    uint32_t _provideCount;
+    uint32_t _provideCapacity;
+
+    CPMResolverConflict *_conflicts;
+    uint32_t _conflictCount;
+    uint32_t _conflictCapacity;
+
+    // (dependent, dependency) pairs of choices
+    uint32_t *_edges;
+    uint32_t _edgeCount;
+    uint32_t _edgeCapacity;
+}
+@property (strong) NSMutableArray *removals;
+@property (copy) NSError *error;
+- (instancetype)initWithIndex:(CPMPackageIndex *)index architectures:(NSArray *)architectures installed:(NSArray *)installed;
+- (BOOL)installIdentifier:(NSString *)identifier;
+- (BOOL)resolveDependencies;
+- (NSArray *)orderedInstalls;
+@end
+
+@implementation CPMResolution
+
+- (instancetype)initWithIndex:(CPMPackageIndex *)index architectures:(NSArray *)architectures installed:(NSArray *)installed {
+    if ((self = [super init])) {
+        _index = index;
+        _architectures = calloc(MAX(architectures.count, 1), sizeof(*_architectures));
+        for (NSString *architecture in architectures) {
+            _architectures[_architectureCount++] = strdup(architecture.UTF8String);
+        }
+        _architecture = _architectureCount ? _architectures[0] : NULL;
+        CPMStringPoolInit(&_strings);
+        self.removals = [NSMutableArray array];
+
+        for (NSDictionary *package in installed) {
+            NSString *name = package[@"package"];
+            if (!name.length)
+                continue;
+
+            CPMResolverGrow(_installed, _installedCount, _installedCapacity);
+            CPMResolverInstalled *entry = &_installed[_installedCount];
+            entry->name = [self intern:name.UTF8String];
+            entry->version = [self intern:[package[@"version"] UTF8String]];
+            entry->provides = [self intern:[package[@"provides"] UTF8String]];
+            entry->conflicts = [self intern:[package[@"conflicts"] UTF8String]];
+            entry->breaks = [self intern:[package[@"breaks"] UTF8String]];
+
+            _installedIndex[entry->name] = _installedCount;
+            [self registerRelationsOfOwner:-(int32_t)_installedCount - 1
+                                  provides:entry->provides
+                                 conflicts:entry->conflicts
+                                    breaks:entry->breaks];
+            _installedCount++;
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc {
+    for (size_t i = 0; i < _architectureCount; i++) {
+        free(_architectures[i]);
+    }
+    free(_architectures);
+    CPMStringPoolFree(&_strings);
+    free(_selected);
+    free(_installedIndex);
+    free(_removed);
+    free(_provideHead);
+    free(_conflictHead);
+    free(_choices);
+    free(_installed);
+    free(_provides);
+    free(_conflicts);
+    free(_edges);
+}
+
+#pragma mark - Interning
+
+- (uint32_t)internBytes:(const char *)bytes length:(size_t)length {
+    uint32_t name = CPMStringPoolIntern(&_strings, bytes, length, CPMStringHash(bytes, length));
+
+    if (_strings.count > _nameCapacity) {
+        uint32_t capacity = MAX(_nameCapacity * 2, 1024);
+        while (capacity < _strings.count)
+            capacity *= 2;
+
+        _selected = realloc(_selected, capacity * sizeof(int32_t));
+        _installedIndex = realloc(_installedIndex, capacity * sizeof(int32_t));
+        _removed = realloc(_removed, capacity * sizeof(uint8_t));
+        _provideHead = realloc(_provideHead, capacity * sizeof(int32_t));
+        _conflictHead = realloc(_conflictHead, capacity * sizeof(int32_t));
+        for (uint32_t i = _nameCapacity; i < capacity; i++) {
+            _selected[i] = CPMResolverNone;
+            _installedIndex[i] = CPMResolverNone;
+            _removed[i] = 0;
+            _provideHead[i] = CPMResolverNone;
+            _conflictHead[i] = CPMResolverNone;
+        }
+        _nameCapacity = capacity;
+    }
+
+    return name;
+}
+
+- (uint32_t)intern:(const char *)string {
+    return string ? [self internBytes:string length:strlen(string)] : 0;
+}
+
+- (uint32_t)findBytes:(const char *)bytes length:(size_t)length {
+    return CPMStringPoolFind(&_strings, bytes, length, CPMStringHash(bytes, length));
+}
+
+- (const char *)string:(uint32_t)string {
+    return CPMStringPoolString(&_strings, string);
+}
+
+- (uint32_t)versionOfOwner:(int32_t)owner {
+    return owner >= 0 ? _choices[owner].values[CPMPackageIndexFieldVersion] : _installed[-owner - 1].version;
+}
+
+- (uint32_t)nameOfOwner:(int32_t)owner {
+    return owner >= 0 ? _choices[owner].name : _installed[-owner - 1].name;
+}
+
+// installed packages stop counting once they are removed or upgraded
+- (BOOL)ownerIsActive:(int32_t)owner {
+    if (owner >= 0)
+        return YES;
+
+    uint32_t name = _installed[-owner - 1].name;
+    return !_removed[name] && _selected[name] == CPMResolverNone;
+}
+
+#pragma mark - State
+
+- (void)registerRelationsOfOwner:(int32_t)owner provides:(uint32_t)provides conflicts:(uint32_t)conflicts breaks:(uint32_t)breaks {
+    char *copy = NULL;
+    CPMRelation *relations = NULL;
+
+    size_t count = parseRelations([self string:provides], NULL, &copy, &relations);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t name = [self internBytes:relations[i].name length:relations[i].nameLength];
+        uint32_t version = [self internBytes:relations[i].version length:relations[i].versionLength];
+
+        CPMResolverGrow(_provides, _provideCount, _provideCapacity);
+        _provides[_provideCount] = (CPMResolverProvide){ owner, version, _provideHead[name] };
+        _provideHead[name] = _provideCount++;
+    }
+    free(copy);
+    free(relations);
+
+    for (int f = 0; f < 2; f++) {
+        count = parseRelations([self string:f ? breaks : conflicts], _architecture, &copy, &relations);
+        for (size_t i = 0; i < count; i++) {
+            uint32_t name = [self internBytes:relations[i].name length:relations[i].nameLength];
+            uint32_t version = [self internBytes:relations[i].version length:relations[i].versionLength];
+
+            CPMResolverGrow(_conflicts, _conflictCount, _conflictCapacity);
+            _conflicts[_conflictCount] = (CPMResolverConflict){ owner, relations[i].op, version, _conflictHead[name] };
+            _conflictHead[name] = _conflictCount++;
+        }
+        free(copy);
+        free(relations);
+    }
+}
+
+// Calls the block with every active package, selected or installed, that
+// satisfies the relation, either by name or through Provides. A versioned
+// relation is only met by a versioned Provides.
+- (void)enumerateOwnersSatisfying:(const CPMRelation *)relation usingBlock:(BOOL (^)(int32_t owner))block {
+    uint32_t name = [self findBytes:relation->name length:relation->nameLength];
+    if (name == UINT32_MAX)
+        return;
+
+    int32_t owner = CPMResolverNoOwner;
+    if (_selected[name] != CPMResolverNone) {
+        owner = _selected[name];
+    } else if (_installedIndex[name] != CPMResolverNone && !_removed[name]) {
+        owner = -_installedIndex[name] - 1;
+    }
+
+    if (owner != CPMResolverNoOwner) {
+        const char *version = [self string:[self versionOfOwner:owner]];
+        if (CPMRelationSatisfiedBy(relation, version, strlen(version)) && !block(owner))
+            return;
+    }
+
+    for (int32_t p = _provideHead[name]; p != CPMResolverNone; p = _provides[p].next) {
+        CPMResolverProvide provide = _provides[p];
+        if (![self ownerIsActive:provide.owner])
+            continue;
+
+        const char *version = [self string:provide.version];
+        if (relation->op != CPMRelationAny && (!provide.version || !CPMRelationSatisfiedBy(relation, version, strlen(version))))
+            continue;
+
+        if (!block(provide.owner))
+            return;
+    }
+}
+
+- (int32_t)ownerSatisfying:(const CPMRelation *)relation {
+    __block int32_t found = CPMResolverNoOwner;
+    [self enumerateOwnersSatisfying:relation usingBlock:^BOOL(int32_t owner) {
+        found = owner;
+        return NO;
+    }];
+
+    return found;
+}
+
+- (BOOL)choice:(uint32_t)choice replaces:(uint32_t)name {
+    char *copy = NULL;
+    CPMRelation *relations = NULL;
+    size_t count = parseRelations([self string:_choices[choice].values[CPMPackageIndexFieldReplaces]], _architecture, &copy, &relations);
+
+    BOOL replaces = NO;
+    const char *target = [self string:name];
+    for (size_t i = 0; i < count && !replaces; i++) {
+        replaces = relations[i].nameLength == strlen(target) && !memcmp(relations[i].name, target, relations[i].nameLength);
+    }
+
+    free(copy);
+    free(relations);
+    return replaces;
+}
+
+// Decides whether a conflict between the choice and an active owner can be
+// settled by removing an installed package. Collects those in `removals`.
+- (BOOL)choice:(uint32_t)choice canCoexistWith:(int32_t)owner removals:(NSMutableIndexSet *)removals {
+    if (owner >= 0)
+        return NO;
+
+    // an older version of the same package is upgraded, not conflicted with
+    uint32_t name = [self nameOfOwner:owner];
+    if (name == _choices[choice].name)
+        return YES;
+
+    if (![self choice:choice replaces:name])
+        return NO;
+
+    [removals addIndex:-owner - 1];
+    return YES;
+}
+
+// Adds the last choice to the transaction unless it conflicts with it.
+- (BOOL)commitLastChoice {
+    uint32_t choice = _choiceCount - 1;
+    NSMutableIndexSet *removals = [NSMutableIndexSet indexSet];
+    __block BOOL conflicts = NO;
+
+    // what this package conflicts with
+    for (int f = 0; f < 2 && !conflicts; f++) {
+        char *copy = NULL;
+        CPMRelation *relations = NULL;
+        CPMPackageIndexField field = f ? CPMPackageIndexFieldBreaks : CPMPackageIndexFieldConflicts;
+        size_t count = parseRelations([self string:_choices[choice].values[field]], _architecture, &copy, &relations);
+
+        for (size_t i = 0; i < count && !conflicts; i++) {
+            [self enumerateOwnersSatisfying:&relations[i] usingBlock:^BOOL(int32_t owner) {
+                conflicts = ![self choice:choice canCoexistWith:owner removals:removals];
+                return !conflicts;
+            }];
+        }
+
+        free(copy);
+        free(relations);
+    }
+
+    // what conflicts with this package, by its own name or by what it provides
+    if (!conflicts) {
+        char *copy = NULL;
+        CPMRelation *relations = NULL;
+        size_t count = parseRelations([self string:_choices[choice].values[CPMPackageIndexFieldProvides]], NULL, &copy, &relations);
+
+        for (size_t i = 0; i <= count && !conflicts; i++) {
+            uint32_t name = i < count ? [self findBytes:relations[i].name length:relations[i].nameLength] : _choices[choice].name;
+            if (name == UINT32_MAX)
+                continue;
+
+            char *version = NULL;
+            if (i < count) {
+                version = strndup(relations[i].version ?: "", relations[i].versionLength);
+            } else {
+                version = strdup([self string:_choices[choice].values[CPMPackageIndexFieldVersion]]);
+            }
+
+            for (int32_t c = _conflictHead[name]; c != CPMResolverNone && !conflicts; c = _conflicts[c].next) {
+                CPMResolverConflict conflict = _conflicts[c];
+                if (![self ownerIsActive:conflict.owner])
+                    continue;
+
+                if (conflict.op != CPMRelationAny && (!*version || !versionSatisfies(conflict.op, [self string:conflict.version], version)))
+                    continue;
+
+                conflicts = ![self choice:choice canCoexistWith:conflict.owner removals:removals];
+            }
+
+            free(version);
+        }
+
+        free(copy);
+        free(relations);
+    }
+
+    if (conflicts) {
+        _choiceCount--;
+        return NO;
+    }
+
+    [removals enumerateIndexesUsingBlock:^(NSUInteger installed, BOOL *stop) {
+        uint32_t name = _installed[installed].name;
+        if (!_removed[name]) {
+            _removed[name] = 1;
+            [self.removals addObject:@([self string:name])];
+        }
+    }];
+
+    _selected[_choices[choice].name] = choice;
+    [self registerRelationsOfOwner:choice
+                          provides:_choices[choice].values[CPMPackageIndexFieldProvides]
+                         conflicts:_choices[choice].values[CPMPackageIndexFieldConflicts]
+                            breaks:_choices[choice].values[CPMPackageIndexFieldBreaks]];
+    return YES;
+}
+
+#pragma mark - Choosing
+
+- (BOOL)candidateIsForArchitecture:(const CPMPackageCandidate *)candidate {
+    const char *architecture = candidate->values[CPMPackageIndexFieldArchitecture];
+    if (!*architecture || !strcmp(architecture, "all"))
+        return YES;
+
+    for (size_t i = 0; i < _architectureCount; i++) {
+        if (!strcmp(architecture, _architectures[i]))
+            return YES;
+    }
+
+    return NO;
+}
+
+- (void)addCandidate:(const CPMPackageCandidate *)candidate to:(NSMutableData *)choices {
+    CPMResolverChoice choice;
+    choice.origin = candidate->origin;
+    for (int f = 0; f < CPMPackageIndexFieldCount; f++) {
+        choice.values[f] = [self intern:candidate->values[f]];
+    }
+    choice.name = choice.values[CPMPackageIndexFieldPackage];
+
+    [choices appendBytes:&choice length:sizeof(choice)];
+}
+
+// Tries the choices newest first until one fits into the transaction.
+- (int32_t)commitNewestOf:(NSMutableData *)data {
+    CPMResolverChoice *choices = data.mutableBytes;
+    NSUInteger count = data.length / sizeof(CPMResolverChoice);
+
+    qsort_b(choices, count, sizeof(CPMResolverChoice), ^int(const void *a, const void *b) {
+        const char *va = [self string:((const CPMResolverChoice *)a)->values[CPMPackageIndexFieldVersion]];
+        const char *vb = [self string:((const CPMResolverChoice *)b)->values[CPMPackageIndexFieldVersion]];
+        return CPMVersionCompareStrings(vb, va);
+    });
+
+    for (NSUInteger i = 0; i < count; i++) {
+        if (_selected[choices[i].name] != CPMResolverNone)
+            continue;
+
+        CPMResolverGrow(_choices, _choiceCount, _choiceCapacity);
+        _choices[_choiceCount++] = choices[i];
+        if ([self commitLastChoice])
+            return _choiceCount - 1;
+    }
+
+    return CPMResolverNone;
+}
+
+// Picks a real package for the relation, or failing that one that provides it.
+- (int32_t)chooseFor:(const CPMRelation *)relation newerThan:(const char *)installedVersion {
+    NSMutableData *choices = [NSMutableData data];
+    char *name = strndup(relation->name, relation->nameLength);
+
+    [_index enumerateCandidatesForIdentifier:name usingBlock:^(const CPMPackageCandidate *candidate, BOOL *stop) {
+        const char *version = candidate->values[CPMPackageIndexFieldVersion];
+        if (![self candidateIsForArchitecture:candidate] || !CPMRelationSatisfiedBy(relation, version, strlen(version)))
+            return;
+        if (installedVersion && CPMVersionCompareStrings(version, installedVersion) <= 0)
+            return;
+
+        [self addCandidate:candidate to:choices];
+    }];
+
+    int32_t choice = [self commitNewestOf:choices];
+    if (choice == CPMResolverNone && !installedVersion) {
+        choices.length = 0;
+        [_index enumerateProvidersOfIdentifier:name usingBlock:^(const CPMPackageCandidate *candidate, const char *providedVersion, BOOL *stop) {
+            if (![self candidateIsForArchitecture:candidate])
+                return;
+            if (relation->op != CPMRelationAny && (!*providedVersion || !CPMRelationSatisfiedBy(relation, providedVersion, strlen(providedVersion))))
+                return;
+
+            [self addCandidate:candidate to:choices];
+        }];
+
+        choice = [self commitNewestOf:choices];
+    }
+
+    free(name);
+    return choice;
+}
+
+- (void)addEdgeFrom:(uint32_t)dependent to:(int32_t)dependency {
+    if (dependency < 0)
+        return;
+
+    if (_edgeCount + 2 > _edgeCapacity) {
+        _edgeCapacity = MAX(_edgeCapacity * 2, 128);
+        _edges = realloc(_edges, _edgeCapacity * sizeof(uint32_t));
+    }
+    _edges[_edgeCount++] = dependent;
+    _edges[_edgeCount++] = dependency;
+}
+
+#pragma mark - Resolving
+
+- (BOOL)installIdentifier:(NSString *)identifier {
+    const char *name = identifier.UTF8String;
+    CPMRelation relation = { .name = name, .nameLength = strlen(name), .op = CPMRelationAny };
+
+    uint32_t nameId = [self findBytes:name length:relation.nameLength];
+    if (nameId != UINT32_MAX && _selected[nameId] != CPMResolverNone)
+        return YES;
+
+    const char *installedVersion = NULL;
+    if (nameId != UINT32_MAX && _installedIndex[nameId] != CPMResolverNone)
+        installedVersion = [self string:_installed[_installedIndex[nameId]].version];
+
+    // an installed package with nothing newer available is simply left alone
+    if ([self chooseFor:&relation newerThan:installedVersion] != CPMResolverNone || installedVersion)
+        return YES;
+
+    self.error = [NSError errorWithDomain:CPMERRORDOMAIN
+                                     code:CPMErrorUnresolvable
+                                 userInfo:@{
+                                            NSLocalizedFailureReasonErrorKey: [NSString stringWithFormat:@"%@ is not available or conflicts with the other packages", identifier],
+                                            CPMErrorPackageKey: identifier
+                                            }];
+    return NO;
+}
+
+- (BOOL)resolveDependencies {
+    // every choice appended while resolving is visited too
+    for (uint32_t dependent = 0; dependent < _choiceCount; dependent++) {
+        for (int f = 0; f < 2; f++) {
+            CPMPackageIndexField field = f ? CPMPackageIndexFieldDepends : CPMPackageIndexFieldPreDepends;
+            char *copy = NULL;
+            CPMRelation *relations = NULL;
+            size_t count = parseRelations([self string:_choices[dependent].values[field]], _architecture, &copy, &relations);
+
+            for (size_t start = 0, end = 0; start < count; start = end) {
+                while (end < count && relations[end].clause == relations[start].clause)
+                    end++;
+
+                // already met by something installed or chosen?
+                int32_t owner = CPMResolverNoOwner;
+                for (size_t i = start; i < end && owner == CPMResolverNoOwner; i++) {
+                    owner = [self ownerSatisfying:&relations[i]];
+                }
+
+                for (size_t i = start; i < end && owner == CPMResolverNoOwner; i++) {
+                    int32_t choice = [self chooseFor:&relations[i] newerThan:NULL];
+                    if (choice != CPMResolverNone)
+                        owner = choice;
+                }
+
+                if (owner == CPMResolverNoOwner) {
+                    NSMutableArray *alternatives = [NSMutableArray array];
+                    for (size_t i = start; i < end; i++) {
+                        [alternatives addObject:[[NSString alloc] initWithBytes:relations[i].name length:relations[i].nameLength encoding:NSUTF8StringEncoding]];
+                    }
+
+                    NSString *package = @([self string:_choices[dependent].name]);
+                    self.error = [NSError errorWithDomain:CPMERRORDOMAIN
+                                                     code:CPMErrorUnresolvable
+                                                 userInfo:@{
+                                                            NSLocalizedFailureReasonErrorKey: [NSString stringWithFormat:@"%@ depends on %@, which cannot be installed", package, [alternatives componentsJoinedByString:@" | "]],
+                                                            CPMErrorPackageKey: package
+                                                            }];
+                    free(copy);
+                    free(relations);
+                    return NO;
+                }
+
+                [self addEdgeFrom:dependent to:owner];
+            }
+
+            free(copy);
+            free(relations);
+        }
+    }
+
+    return YES;
+}
+
+// Dependencies before dependents; cycles are broken where they are found,
+// as dpkg configures the members of a cycle together anyway.
+- (NSArray *)orderedInstalls {
+    uint32_t *start = calloc(_choiceCount + 1, sizeof(uint32_t));
+    uint32_t *targets = malloc(MAX(_edgeCount / 2, 1) * sizeof(uint32_t));
+    for (uint32_t e = 0; e < _edgeCount; e += 2) {
+        start[_edges[e] + 1]++;
+    }
+    for (uint32_t c = 0; c < _choiceCount; c++) {
+        start[c + 1] += start[c];
+    }
+
+    uint32_t *fill = calloc(MAX(_choiceCount, 1), sizeof(uint32_t));
+    for (uint32_t e = 0; e < _edgeCount; e += 2) {
+        uint32_t from = _edges[e];
+        targets[start[from] + fill[from]++] = _edges[e + 1];
+    }
+    free(fill);
+
+    NSMutableArray *ordered = [NSMutableArray arrayWithCapacity:_choiceCount];
+    uint8_t *visited = calloc(MAX(_choiceCount, 1), 1);
+    uint32_t *stack = malloc(MAX(_choiceCount, 1) * sizeof(uint32_t));
+    uint32_t *next = malloc(MAX(_choiceCount, 1) * sizeof(uint32_t));
+
+    for (uint32_t root = 0; root < _choiceCount; root++) {
+        if (visited[root])
+            continue;
+
+        uint32_t depth = 0;
+        stack[depth] = root;
+        next[depth] = start[root];
+        visited[root] = 1;
+
+        while (YES) {
+            uint32_t node = stack[depth];
+            if (next[depth] < start[node + 1]) {
+                uint32_t target = targets[next[depth]++];
+                if (!visited[target]) {
+                    visited[target] = 1;
+                    depth++;
+                    stack[depth] = target;
+                    next[depth] = start[target];
+                }
+                continue;
+            }
+
+            CPMPackageCandidate candidate;
+            candidate.origin = _choices[node].origin;
+            for (int f = 0; f < CPMPackageIndexFieldCount; f++) {
+                candidate.values[f] = [self string:_choices[node].values[f]];
+            }
+            [ordered addObject:[_index dictionaryForCandidate:&candidate]];
+
+            if (!depth)
+                break;
+            depth--;
+        }
+    }
+
+    free(start);
+    free(targets);
+    free(visited);
+    free(stack);
+    free(next);
+    return ordered;
+}
+
+@end
+
+#pragma mark - Transaction
+
+@interface CPMTransaction ()
+@property (readwrite, copy) NSArray *installs;
+@property (readwrite, copy) NSArray *removals;
+@end
+
+@implementation CPMTransaction
+@end
+
+#pragma mark - Resolver
+
+@interface CPMResolver ()
+@property (readwrite, strong) CPMPackageIndex *packageIndex;
+@end
+
+@implementation CPMResolver
+
+- (instancetype)initWithPackageIndex:(CPMPackageIndex *)index {
+    if ((self = [super init])) {
+        self.packageIndex = index;
+        self.architectures = [CPMRepository defaultArchitectures];
+    }
+
+    return self;
+}
+
+- (CPMTransaction *)transactionForInstallingIdentifiers:(NSArray *)identifiers error:(NSError **)error {
+    CPMResolution *resolution = [[CPMResolution alloc] initWithIndex:self.packageIndex
+                                                       architectures:self.architectures
+                                                           installed:self.installedPackages];
+
+    BOOL resolved = YES;
+    for (NSString *identifier in identifiers) {
+        if (!(resolved = [resolution installIdentifier:identifier]))
+            break;
+    }
+
+    if (resolved)
+        resolved = [resolution resolveDependencies];
+
+    if (!resolved) {
+        if (error)
+            *error = resolution.error;
+        return nil;
+    }
+
+    CPMTransaction *transaction = [[CPMTransaction alloc] init];
+    transaction.installs = [resolution orderedInstalls];
+    transaction.removals = resolution.removals;
+    return transaction;
+}
+
+@end
@@ -0,0 +1,152 @@
+//
+//  compression.c
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#include "compression.h"
+#include <string.h>
+
+static const uint8_t CPMGzipMagic[] = { 0x1f, 0x8b, 0x08 };
+static const uint8_t CPMBzip2Magic[] = { 'B', 'Z', 'h' };
+// pi and sqrt(pi), the first block and the end of stream markers of a bzip2 stream
+static const uint8_t CPMBzip2Block[] = { 0x31, 0x41, 0x59, 0x26, 0x53, 0x59 };
+static const uint8_t CPMBzip2End[] = { 0x17, 0x72, 0x45, 0x38, 0x50, 0x90 };
+static const uint8_t CPMXZMagic[] = { 0xfd, '7', 'z', 'X', 'Z', 0x00 };
+static const uint8_t CPMLZIPMagic[] = { 'L', 'Z', 'I', 'P' };
+
+// smallest possible members, so a match can't start inside the previous header
+#define CPMGzipMinimumMember 18
+#define CPMBzip2MinimumMember 14
+#define CPMXZMinimumMember 32
+
+static int hasPrefix(const uint8_t *bytes, size_t length, const uint8_t *magic, size_t magicLength) {
+    return length >= magicLength && memcmp(bytes, magic, magicLength) == 0;
+}
+
+static int isBzip2Stream(const uint8_t *bytes, size_t length) {
+    if (length < 10 || !hasPrefix(bytes, length, CPMBzip2Magic, sizeof(CPMBzip2Magic)) || bytes[3] < '1' || bytes[3] > '9')
+        return 0;
+
+    return memcmp(bytes + 4, CPMBzip2Block, sizeof(CPMBzip2Block)) == 0 || memcmp(bytes + 4, CPMBzip2End, sizeof(CPMBzip2End)) == 0;
+}
+
+static int isGzipMember(const uint8_t *bytes, size_t length) {
+    // reserved flag bits are always clear
+    return length >= 10 && hasPrefix(bytes, length, CPMGzipMagic, sizeof(CPMGzipMagic)) && (bytes[3] & 0xe0) == 0;
+}
+
+static int isXZStream(const uint8_t *bytes, size_t length) {
+    // the stream flags are a zero byte and a check type below 16
+    return length >= 12 && hasPrefix(bytes, length, CPMXZMagic, sizeof(CPMXZMagic)) && bytes[6] == 0 && bytes[7] < 0x10;
+}
+
+CPMCompression CPMCompressionSniff(const uint8_t *bytes, size_t length) {
+    if (isGzipMember(bytes, length))
+        return CPMCompressionGzip;
+    if (isBzip2Stream(bytes, length))
+        return CPMCompressionBzip2;
+    if (isXZStream(bytes, length))
+        return CPMCompressionXZ;
+    if (hasPrefix(bytes, length, CPMLZIPMagic, sizeof(CPMLZIPMagic)))
+        return CPMCompressionLZIP;
+
+    // .lzma has no magic, only a properties byte below 225 and a power of two dictionary size
+    if (length >= 13 && bytes[0] < 225) {
+        uint32_t dictionary = bytes[1] | bytes[2] << 8 | bytes[3] << 16 | (uint32_t)bytes[4] << 24;
+        if (dictionary >= 4096 && (dictionary & (dictionary - 1)) == 0 && bytes[0] == 0x5d)
+            return CPMCompressionLZMA;
+    }
+
+    // an index is plain text, so an empty body or printable bytes are taken as uncompressed
+    for (size_t i = 0; i < length && i < 64; i++) {
+        if (bytes[i] < 0x09 || (bytes[i] > 0x0d && bytes[i] < 0x20))
+            return CPMCompressionUnknown;
+    }
+
+    return CPMCompressionNone;
+}
+
+CPMCompression CPMCompressionForExtension(const char *extension) {
+    static const struct {
+        const char *extension;
+        CPMCompression compression;
+    } extensions[] = {
+        { "", CPMCompressionNone },
+        { "gz", CPMCompressionGzip },
+        { "bz2", CPMCompressionBzip2 },
+        { "xz", CPMCompressionXZ },
+        { "lzma", CPMCompressionLZMA },
+        { "lz", CPMCompressionLZIP },
+    };
+
+    for (size_t i = 0; i < sizeof(extensions) / sizeof(*extensions); i++) {
+        if (strcmp(extension, extensions[i].extension) == 0)
+            return extensions[i].compression;
+    }
+
+    return CPMCompressionUnknown;
+}
+
+size_t CPMCompressionMembers(const uint8_t *bytes, size_t length, CPMCompression compression, size_t *offsets, size_t capacity) {
+    const uint8_t *magic = NULL;
+    size_t minimum = 0;
+    int (*isMember)(const uint8_t *, size_t) = NULL;
+
+    switch (compression) {
+        case CPMCompressionGzip:
+            magic = CPMGzipMagic;
+            minimum = CPMGzipMinimumMember;
+            isMember = isGzipMember;
+            break;
+        case CPMCompressionBzip2:
+            magic = CPMBzip2Magic;
+            minimum = CPMBzip2MinimumMember;
+            isMember = isBzip2Stream;
+            break;
+        case CPMCompressionXZ:
+            magic = CPMXZMagic;
+            minimum = CPMXZMinimumMember;
+            isMember = isXZStream;
+            break;
+        default:
+            break;
+    }
+
+    size_t count = 0;
+    if (capacity)
+        offsets[0] = 0;
+    count++;
+
+    if (!isMember || length < minimum)
+        return count;
+
+    size_t last = 0;
+    const uint8_t *p = bytes + minimum;
+    const uint8_t *end = bytes + length;
+    while (p < end && (p = memchr(p, magic[0], end - p))) {
+        size_t offset = p - bytes;
+        p++;
+
+        if (offset - last < minimum || !isMember(bytes + offset, length - offset))
+            continue;
+
+        // an xz stream ends in the footer magic, possibly followed by zero padding
+        if (compression == CPMCompressionXZ) {
+            size_t footer = offset;
+            while (footer > last && bytes[footer - 1] == 0)
+                footer--;
+            if (footer - last < minimum || bytes[footer - 2] != 'Y' || bytes[footer - 1] != 'Z')
+                continue;
+        }
+
+        if (count < capacity)
+            offsets[count] = offset;
+        count++;
+        last = offset;
+    }
+
+    return count;
+}
@@ -0,0 +1,43 @@
+//
+//  compression.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#ifndef __cpm__compression__
+#define __cpm__compression__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The compressions a Debian index can come in, recognized from their first
+// bytes instead of being guessed at.
+
+typedef enum {
+    CPMCompressionUnknown = -1,
+    CPMCompressionNone = 0,
+    CPMCompressionGzip,
+    CPMCompressionBzip2,
+    CPMCompressionXZ,
+    CPMCompressionLZMA,
+    CPMCompressionLZIP
+} CPMCompression;
+
+// Looks at the magic bytes. Anything that isn't one of the compressions and
+// looks like text is CPMCompressionNone.
+CPMCompression CPMCompressionSniff(const uint8_t *bytes, size_t length);
+
+// "gz" -> CPMCompressionGzip, "" -> CPMCompressionNone
+CPMCompression CPMCompressionForExtension(const char *extension);
+
+// gzip, bzip2 and xz files may be several complete members back to back, as
+// pigz --independent, pbzip2 and xz -T write them, and each member decodes on
+// its own. Fills `offsets` with where members appear to start, the first being
+// 0, and returns how many were found (possibly more than capacity). The scan
+// is a heuristic: a false start inside a member only makes decoding that piece
+// fail, so callers must be ready to decode the whole input in one go instead.
+size_t CPMCompressionMembers(const uint8_t *bytes, size_t length, CPMCompression compression, size_t *offsets, size_t capacity);
+
+#endif /* defined(__cpm__compression__) */
@@ -11,6 +11,13 @@
 #ifndef __cpm__decompress__
 #define __cpm__decompress__
 
+// The compression is recognized from the data's magic bytes. Inputs made of
+// several gzip, bzip2 or xz members are decoded a group of members per thread.
 NSString *decompress(NSData *data);
+NSData *decompressData(NSData *data);
+
+// Only the parallel path: nil if the input is too small to be worth it, isn't
+// made of several members, or one of the pieces doesn't decode on its own.
+NSData *decompressDataInParallel(NSData *data);
 
 #endif /* defined(__cpm__decompress__) */
@@ -7,52 +7,171 @@
 //
 
 #import "decompress.h"
+#import "compression.h"
 #import <archive.h>
 #import <archive_entry.h>
 
-NSString *decompress(NSData *data) {
-    int r;
-    ssize_t size;
-    
-    struct archive *a = archive_read_new();
-    struct archive_entry *ae;
+// decompressed data is read straight into the output, at least this much at a time
+#define CPMDecompressReadSize (256 * 1024)
+
+// smaller inputs aren't worth splitting across threads
+#define CPMDecompressParallelThreshold (1024 * 1024)
+
+// most member starts considered when splitting an input
+#define CPMDecompressMaximumMembers 256
+
+static void supportCompression(struct archive *a, CPMCompression compression) {
+    // only the filter the magic bytes asked for, so nothing else bids on the input
+    switch (compression) {
+        case CPMCompressionGzip:
+            archive_read_support_filter_gzip(a);
+            break;
+        case CPMCompressionBzip2:
+            archive_read_support_filter_bzip2(a);
+            break;
+        case CPMCompressionXZ:
+            archive_read_support_filter_xz(a);
+            break;
+        case CPMCompressionLZMA:
+            archive_read_support_filter_lzma(a);
+            break;
+        case CPMCompressionLZIP:
+            archive_read_support_filter_lzip(a);
+            break;
+        case CPMCompressionNone:
+            break;
+        case CPMCompressionUnknown:
+        default:
 #ifdef HAVE_ARCHIVE_READ_SUPPORT_FILTER_ALL
-    archive_read_support_filter_all (a);
+            archive_read_support_filter_all(a);
 #else
-    archive_read_support_compression_all (a);
+            archive_read_support_compression_all(a);
 #endif
+            break;
+    }
+}
+
+// Appends the decompressed bytes to output, growing it geometrically and
+// trimming it to the exact length at the end. Leaves output as it was on failure.
+static BOOL decompressInto(const void *bytes, size_t length, CPMCompression compression, NSMutableData *output) {
+    struct archive *a = archive_read_new();
+    struct archive_entry *ae;
+    supportCompression(a, compression);
     archive_read_support_format_raw(a);
-    r = archive_read_open_memory(a, (void *)data.bytes, data.length);
-    
-    NSMutableData *buffer = [[NSMutableData alloc] initWithLength:4096];
-    
-    if (r != ARCHIVE_OK) {
-        /* ERROR */
-        return @"";
+    archive_read_support_format_empty(a);
+
+    int r = archive_read_open_memory(a, (void *)bytes, length);
+    if (r == ARCHIVE_OK)
+        r = archive_read_next_header(a, &ae);
+
+    if (r == ARCHIVE_EOF) {
+        // nothing in it
+        archive_read_free(a);
+        return YES;
     }
-    r = archive_read_next_header(a, &ae);
+
     if (r != ARCHIVE_OK) {
-        /* ERROR */
-        return @"";
+        archive_read_free(a);
+        return NO;
     }
-    
-    ssize_t bytesWritten = 0;
-    NSMutableData *output = [[NSMutableData alloc] init];
+
+    NSUInteger start = output.length;
+    NSUInteger used = start;
     for (;;) {
-        // read the next few mb of data
-        size = archive_read_data(a, (void *)buffer.mutableBytes, 4096);
+        if (output.length - used < CPMDecompressReadSize) {
+            output.length = MAX(output.length * 2, used + CPMDecompressReadSize);
+        }
+
+        ssize_t size = archive_read_data(a, (char *)output.mutableBytes + used, output.length - used);
         if (size < 0) {
-            /* ERROR */
+            output.length = start;
+            archive_read_free(a);
+            return NO;
         }
         if (size == 0)
             break;
-        
-        bytesWritten += size;
-        [output appendData:buffer];
-        [buffer resetBytesInRange:NSMakeRange(0, buffer.length)];
+
+        used += size;
     }
-    
+
+    output.length = used;
     archive_read_free(a);
-    
-    return [[NSString alloc] initWithData:output encoding:NSASCIIStringEncoding];
+
+    return YES;
+}
+
+static NSData *decompressMembersInParallel(NSData *data, CPMCompression compression) {
+    NSUInteger workers = [NSProcessInfo processInfo].activeProcessorCount;
+    if (data.length < CPMDecompressParallelThreshold || workers < 2)
+        return nil;
+
+    size_t offsets[CPMDecompressMaximumMembers];
+    size_t count = CPMCompressionMembers(data.bytes, data.length, compression, offsets, CPMDecompressMaximumMembers);
+    count = MIN(count, CPMDecompressMaximumMembers);
+    if (count < 2)
+        return nil;
+
+    // consecutive members in about one evenly sized piece per worker
+    size_t starts[CPMDecompressMaximumMembers + 1];
+    size_t pieces = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (i == 0 || offsets[i] >= data.length * pieces / workers)
+            starts[pieces++] = offsets[i];
+    }
+    starts[pieces] = data.length;
+    if (pieces < 2)
+        return nil;
+
+    NSMutableArray *outputs = [NSMutableArray arrayWithCapacity:pieces];
+    for (size_t i = 0; i < pieces; i++) {
+        [outputs addObject:[NSMutableData data]];
+    }
+
+    __block BOOL failed = NO;
+    dispatch_apply(pieces, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        if (!decompressInto((const char *)data.bytes + starts[i], starts[i + 1] - starts[i], compression, outputs[i]))
+            failed = YES;
+    });
+
+    if (failed)
+        return nil;
+
+    NSUInteger total = 0;
+    for (NSData *output in outputs) {
+        total += output.length;
+    }
+
+    NSMutableData *output = [NSMutableData dataWithCapacity:total];
+    for (NSData *piece in outputs) {
+        [output appendData:piece];
+    }
+
+    return output;
+}
+
+NSString *decompress(NSData *data) {
+    NSData *output = decompressData(data);
+    if (!output)
+        return @"";
+
+    // indexes are UTF-8, though some old ones are Latin-1
+    return [[NSString alloc] initWithData:output encoding:NSUTF8StringEncoding] ?: [[NSString alloc] initWithData:output encoding:NSISOLatin1StringEncoding];
+}
+
+NSData *decompressDataInParallel(NSData *data) {
+    return decompressMembersInParallel(data, CPMCompressionSniff(data.bytes, data.length));
+}
+
+NSData *decompressData(NSData *data) {
+    CPMCompression compression = CPMCompressionSniff(data.bytes, data.length);
+
+    NSData *parallel = decompressMembersInParallel(data, compression);
+    if (parallel)
+        return parallel;
+
+    NSMutableData *output = [NSMutableData data];
+    if (!decompressInto(data.bytes, data.length, compression, output))
+        return nil;
+
+    return output;
 }
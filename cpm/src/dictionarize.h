@@ -8,10 +8,13 @@
 
 #import <Foundation/Foundation.h>
 #import <FMDatabase.h>
+#import "stanza.h"
 
 #ifndef __cpm__dictionarize__
 #define __cpm__dictionarize__
 
+// only the fields which are columns of `table` end up in the dictionary
 NSDictionary *dictionarize(NSString *data, FMDatabase *db, NSString *table);
+NSDictionary *dictionarizeStanza(const CPMStanza *stanza, FMDatabase *db, NSString *table);
 
 #endif /* defined(__cpm__dictionarize__) */
@@ -14,57 +14,69 @@ NSString *keyForDB(FMDatabase *db, NSString *table) {
     return [NSString stringWithFormat:@"%@%@", db, table];
 }
 
-NSDictionary *dictionarize(NSString *data, FMDatabase *db, NSString *table) {
-    if (!keyCache) {
-        keyCache = [[NSMutableDictionary alloc] init];
-    }
-    NSMutableArray *validKeys = [NSMutableArray array];
+// bitmask of the stanza fields which are columns of the table
+static uint64_t columnMaskForTable(FMDatabase *db, NSString *table) {
     NSString *cacheKey = keyForDB(db, table);
-    if ([keyCache.allKeys containsObject:cacheKey]) {
-        validKeys = keyCache[cacheKey];
-    } else {
-        FMResultSet *results = [db executeQuery:[NSString stringWithFormat:@"PRAGMA table_info(%@)", table]];
-        while (results.next) {
-            [validKeys addObject:[results stringForColumn:@"name"].copy];
+    @synchronized (keyCache) {
+        NSNumber *cached = keyCache[cacheKey];
+        if (cached) {
+            return cached.unsignedLongLongValue;
         }
-        [results close];
-        
-        keyCache[cacheKey] = validKeys;
     }
     
-    NSArray *components = [data componentsSeparatedByString:@"\n"];
+    uint64_t mask = 0;
+    FMResultSet *results = [db executeQuery:[NSString stringWithFormat:@"PRAGMA table_info(%@)", table]];
+    while (results.next) {
+        const char *name = [results UTF8StringForColumnName:@"name"];
+        CPMStanzaField field = CPMStanzaFieldForName(name, strlen(name));
+        if (field != CPMStanzaFieldUnknown) {
+            mask |= 1ULL << field;
+        }
+    }
+    [results close];
+    
+    @synchronized (keyCache) {
+        keyCache[cacheKey] = @(mask);
+    }
+    
+    return mask;
+}
+
+NSDictionary *dictionarizeStanza(const CPMStanza *stanza, FMDatabase *db, NSString *table) {
+    static NSString *columns[CPMStanzaFieldCount];
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        keyCache = [[NSMutableDictionary alloc] init];
+        for (int i = 0; i < CPMStanzaFieldCount; i++) {
+            columns[i] = @(CPMStanzaFieldColumn(i));
+        }
+    });
+    
+    uint64_t mask = columnMaskForTable(db, table);
     NSMutableDictionary *values = [NSMutableDictionary dictionary];
     
-    NSString *lastKey = nil;
-    for (NSString *segment in components) {
-        NSRange keyRange = [segment rangeOfString:@":"];
-        if (keyRange.location == NSNotFound) {
-            // append it to the last one
-            if (!lastKey)
-                continue;
-            
-            NSString *lastValue = values[lastKey];
-            if (!lastValue.length) {
-                values[lastKey] = segment;
-            } else {
-                values[lastKey] = [lastValue stringByAppendingFormat:@"\n%@", segment];
-            }
-            
+    for (int i = 0; i < CPMStanzaFieldCount; i++) {
+        const CPMStanzaValue *value = &stanza->values[i];
+        if (!value->bytes || !(mask & (1ULL << i)))
             continue;
-        }
         
-        NSString *key = [segment substringToIndex:keyRange.location].lowercaseString;
-        key = [key stringByReplacingOccurrencesOfString:@"-" withString:@"_"];
-        if (![validKeys containsObject:key]) {
-            continue;
+        NSString *string = [[NSString alloc] initWithBytes:value->bytes length:value->length encoding:NSUTF8StringEncoding];
+        if (!string) {
+            string = [[NSString alloc] initWithBytes:value->bytes length:value->length encoding:NSISOLatin1StringEncoding];
         }
         
-        NSString *value = [segment substringFromIndex:keyRange.location + keyRange.length];
-        value = [value stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
-        
-        values[key] = value;
-        lastKey = key;
+        values[columns[i]] = string;
     }
     
     return values;
 }
+
+NSDictionary *dictionarize(NSString *data, FMDatabase *db, NSString *table) {
+    const char *bytes = data.UTF8String;
+    if (!bytes)
+        return @{};
+    
+    CPMStanza stanza;
+    CPMStanzaParse(bytes, strlen(bytes), &stanza);
+    return dictionarizeStanza(&stanza, db, table);
+}
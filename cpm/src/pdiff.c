@@ -0,0 +1,175 @@
+//
+//  pdiff.c
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#include "pdiff.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    size_t start;      // first line addressed, 1-based (0 for "append at top")
+    size_t end;        // last line addressed
+    char op;           // 'a', 'c' or 'd'
+    const char *text;  // lines to insert, including their newlines
+    size_t textLength;
+} CPMEdCommand;
+
+// Reads "N" or "N,M" followed by a command letter. Returns 0 on success.
+static int CPMEdParseAddress(const char *line, size_t length, CPMEdCommand *command) {
+    size_t i = 0, values[2] = { 0, 0 };
+    int count = 0;
+
+    while (count < 2) {
+        if (i >= length || line[i] < '0' || line[i] > '9')
+            return -1;
+
+        while (i < length && line[i] >= '0' && line[i] <= '9') {
+            values[count] = values[count] * 10 + (line[i++] - '0');
+        }
+        count++;
+
+        if (i < length && line[i] == ',') {
+            i++;
+            continue;
+        }
+        break;
+    }
+
+    if (i + 1 != length || (line[i] != 'a' && line[i] != 'c' && line[i] != 'd'))
+        return -1;
+
+    command->op = line[i];
+    command->start = values[0];
+    command->end = count == 2 ? values[1] : values[0];
+
+    if (command->end < command->start || (command->op != 'a' && command->start == 0))
+        return -1;
+
+    return 0;
+}
+
+int CPMApplyEdScript(const char *original, size_t originalLength,
+                     const char *script, size_t scriptLength,
+                     char **output, size_t *outputLength) {
+    // line offsets of the original: line n (1-based) spans [lines[n - 1], lines[n])
+    size_t lineCount = 0, lineCapacity = 1024;
+    size_t *lines = malloc(lineCapacity * sizeof(size_t));
+    lines[0] = 0;
+    for (const char *p = original, *end = original + originalLength; p < end;) {
+        const char *newline = memchr(p, '\n', end - p);
+        p = newline ? newline + 1 : end;
+
+        if (lineCount + 2 > lineCapacity) {
+            lineCapacity *= 2;
+            lines = realloc(lines, lineCapacity * sizeof(size_t));
+        }
+        lines[++lineCount] = p - original;
+    }
+
+    // diff --ed emits its commands from the bottom of the file up
+    size_t commandCount = 0, commandCapacity = 64;
+    CPMEdCommand *commands = malloc(commandCapacity * sizeof(CPMEdCommand));
+    size_t textTotal = 0;
+    int result = 0;
+
+    const char *p = script, *end = script + scriptLength;
+    while (p < end && result == 0) {
+        const char *newline = memchr(p, '\n', end - p);
+        const char *eol = newline ?: end;
+        size_t length = eol - p;
+        p = newline ? newline + 1 : end;
+
+        if (length == 0)
+            continue;
+
+        CPMEdCommand command = { 0 };
+        if (CPMEdParseAddress(eol - length, length, &command) != 0) {
+            result = -1;
+            break;
+        }
+
+        if (command.op != 'd') {
+            // text runs until a line holding a single "."
+            command.text = p;
+            for (;;) {
+                if (p >= end) {
+                    result = -1;
+                    break;
+                }
+
+                const char *textNewline = memchr(p, '\n', end - p);
+                const char *textEnd = textNewline ?: end;
+                if (textEnd - p == 1 && *p == '.') {
+                    command.textLength = p - command.text;
+                    p = textNewline ? textNewline + 1 : end;
+                    break;
+                }
+                p = textNewline ? textNewline + 1 : end;
+            }
+        }
+
+        if (result != 0)
+            break;
+
+        if (command.end > lineCount) {
+            result = -1;
+            break;
+        }
+
+        if (commandCount == commandCapacity) {
+            commandCapacity *= 2;
+            commands = realloc(commands, commandCapacity * sizeof(CPMEdCommand));
+        }
+        commands[commandCount++] = command;
+        textTotal += command.textLength;
+    }
+
+    if (result == 0) {
+        char *buffer = malloc(originalLength + textTotal + 1);
+        size_t written = 0;
+        size_t cursor = 1; // next original line to copy
+
+        // walk the commands top-down, copying the untouched lines in between
+        for (size_t i = commandCount; i-- > 0;) {
+            const CPMEdCommand *command = &commands[i];
+            size_t copyThrough = command->op == 'a' ? command->start : command->start - 1;
+
+            // commands overlap or aren't in bottom-up order
+            if (copyThrough + 1 < cursor) {
+                result = -1;
+                break;
+            }
+
+            size_t from = lines[cursor - 1], to = lines[copyThrough];
+            memcpy(buffer + written, original + from, to - from);
+            written += to - from;
+
+            if (command->textLength) {
+                memcpy(buffer + written, command->text, command->textLength);
+                written += command->textLength;
+            }
+
+            cursor = command->op == 'a' ? command->start + 1 : command->end + 1;
+        }
+
+        if (result == 0) {
+            size_t from = lines[cursor - 1];
+            memcpy(buffer + written, original + from, originalLength - from);
+            written += originalLength - from;
+
+            *output = buffer;
+            *outputLength = written;
+        } else {
+            free(buffer);
+        }
+    }
+
+    free(commands);
+    free(lines);
+
+    return result;
+}
@@ -0,0 +1,25 @@
+//
+//  pdiff.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#ifndef __cpm__pdiff__
+#define __cpm__pdiff__
+
+#include <stddef.h>
+
+// Applies one ed script as produced by `diff --ed`, which is the format of the
+// patches listed in a Debian Packages.diff/Index, to `original`.
+// https://wiki.debian.org/DebianRepository/Format#indices_acquisition_via_IndexFiles_.28aka_APT_pdiffs.29
+//
+// Returns 0 and a malloc'd buffer in *output on success, -1 if the script is
+// malformed or doesn't fit the original (the caller should fall back to
+// downloading the whole index).
+int CPMApplyEdScript(const char *original, size_t originalLength,
+                     const char *script, size_t scriptLength,
+                     char **output, size_t *outputLength);
+
+#endif /* defined(__cpm__pdiff__) */
@@ -0,0 +1,180 @@
+//
+//  relationship.c
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#include "relationship.h"
+#include "version.h"
+#include <string.h>
+
+static inline int isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static const char *skipSpace(const char *p, const char *end) {
+    while (p < end && isSpace(*p))
+        p++;
+    return p;
+}
+
+// "[a b]" matches if the architecture is listed, "[!a !b]" if it isn't
+static int architectureMatches(const char *p, const char *end, const char *architecture) {
+    size_t archLength = strlen(architecture);
+    int negated = 0, listed = 0;
+
+    while ((p = skipSpace(p, end)) < end) {
+        const char *word = p;
+        while (p < end && !isSpace(*p))
+            p++;
+
+        if (*word == '!') {
+            negated = 1;
+            word++;
+        }
+
+        size_t length = p - word;
+        if ((length == archLength && !memcmp(word, architecture, length)) || (length == 3 && !memcmp(word, "any", 3)))
+            listed = 1;
+    }
+
+    return negated ? !listed : listed;
+}
+
+// Parses one alternative from [p, end). Returns 0 if it is empty or does not
+// apply to the architecture.
+static int parseAlternative(const char *p, const char *end, const char *architecture, CPMRelation *relation) {
+    p = skipSpace(p, end);
+
+    relation->name = p;
+    while (p < end && !isSpace(*p) && *p != '(' && *p != '[' && *p != '<' && *p != ':')
+        p++;
+    relation->nameLength = p - relation->name;
+    relation->op = CPMRelationAny;
+    relation->version = NULL;
+    relation->versionLength = 0;
+
+    if (!relation->nameLength)
+        return 0;
+
+    // multiarch qualifier
+    if (p < end && *p == ':') {
+        while (p < end && !isSpace(*p) && *p != '(' && *p != '[' && *p != '<')
+            p++;
+    }
+
+    while ((p = skipSpace(p, end)) < end) {
+        char open = *p;
+        char close = open == '(' ? ')' : open == '[' ? ']' : open == '<' ? '>' : 0;
+        if (!close)
+            break;
+
+        const char *start = p + 1;
+        const char *stop = memchr(start, close, end - start);
+        if (!stop)
+            stop = end;
+        p = stop < end ? stop + 1 : end;
+
+        if (open == '[') {
+            if (architecture && !architectureMatches(start, stop, architecture))
+                return 0;
+        } else if (open == '(') {
+            const char *q = skipSpace(start, stop);
+            if (q + 1 < stop && q[0] == '<' && q[1] == '<') {
+                relation->op = CPMRelationEarlier;
+                q += 2;
+            } else if (q + 1 < stop && q[0] == '<' && q[1] == '=') {
+                relation->op = CPMRelationEarlierEqual;
+                q += 2;
+            } else if (q + 1 < stop && q[0] == '>' && q[1] == '>') {
+                relation->op = CPMRelationLater;
+                q += 2;
+            } else if (q + 1 < stop && q[0] == '>' && q[1] == '=') {
+                relation->op = CPMRelationLaterEqual;
+                q += 2;
+            } else if (q < stop && *q == '<') {
+                relation->op = CPMRelationEarlierEqual;
+                q++;
+            } else if (q < stop && *q == '>') {
+                relation->op = CPMRelationLaterEqual;
+                q++;
+            } else if (q < stop && *q == '=') {
+                relation->op = CPMRelationEqual;
+                q++;
+            }
+
+            q = skipSpace(q, stop);
+            const char *versionEnd = stop;
+            while (versionEnd > q && isSpace(versionEnd[-1]))
+                versionEnd--;
+
+            relation->version = q;
+            relation->versionLength = versionEnd - q;
+            if (!relation->versionLength)
+                relation->op = CPMRelationAny;
+        }
+        // build profiles ("<...>") don't concern binary packages
+    }
+
+    return 1;
+}
+
+size_t CPMRelationParse(const char *bytes, size_t length, const char *architecture, CPMRelation *relations, size_t capacity) {
+    const char *end = bytes + length;
+    const char *p = bytes;
+    size_t count = 0;
+    unsigned clause = 0;
+
+    while (p < end) {
+        const char *clauseEnd = memchr(p, ',', end - p);
+        if (!clauseEnd)
+            clauseEnd = end;
+
+        int found = 0;
+        while (p < clauseEnd) {
+            const char *alternativeEnd = memchr(p, '|', clauseEnd - p);
+            if (!alternativeEnd)
+                alternativeEnd = clauseEnd;
+
+            CPMRelation relation;
+            if (parseAlternative(p, alternativeEnd, architecture, &relation)) {
+                relation.clause = clause;
+                if (count < capacity)
+                    relations[count] = relation;
+                count++;
+                found = 1;
+            }
+
+            p = alternativeEnd < clauseEnd ? alternativeEnd + 1 : clauseEnd;
+        }
+
+        if (found)
+            clause++;
+        p = clauseEnd < end ? clauseEnd + 1 : end;
+    }
+
+    return count;
+}
+
+int CPMRelationSatisfiedBy(const CPMRelation *relation, const char *version, size_t length) {
+    if (relation->op == CPMRelationAny)
+        return 1;
+
+    int result = CPMVersionCompare(version, length, relation->version, relation->versionLength);
+    switch (relation->op) {
+        case CPMRelationEarlier:
+            return result < 0;
+        case CPMRelationEarlierEqual:
+            return result <= 0;
+        case CPMRelationEqual:
+            return result == 0;
+        case CPMRelationLaterEqual:
+            return result >= 0;
+        case CPMRelationLater:
+            return result > 0;
+        default:
+            return 1;
+    }
+}
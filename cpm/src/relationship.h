@@ -0,0 +1,50 @@
+//
+//  relationship.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#ifndef __cpm__relationship__
+#define __cpm__relationship__
+
+#include <stddef.h>
+
+// Parser for relationship fields such as Depends, Conflicts and Provides:
+//   a (>= 1.0) | b, c [iphoneos-arm]
+// Like the stanza parser nothing is copied; names and versions point into the
+// parsed field.
+// https://www.debian.org/doc/debian-policy/ch-relationships.html
+
+typedef enum {
+    CPMRelationAny = 0,      // no version restriction
+    CPMRelationEarlier,      // <<
+    CPMRelationEarlierEqual, // <= (and the obsolete <)
+    CPMRelationEqual,        // =
+    CPMRelationLaterEqual,   // >= (and the obsolete >)
+    CPMRelationLater         // >>
+} CPMRelationOperator;
+
+typedef struct {
+    const char *name;
+    size_t nameLength;
+    CPMRelationOperator op;
+    const char *version;
+    size_t versionLength;
+    // relations with the same clause are alternatives of each other ("a | b");
+    // every clause has to be satisfied
+    unsigned clause;
+} CPMRelation;
+
+// Writes at most `capacity` relations and returns how many the field holds,
+// so a second call with a larger buffer gets them all. When `architecture` is
+// given, alternatives restricted to other architectures are left out, as are
+// clauses that lose every alternative. Multiarch qualifiers (":any") and
+// build profiles ("<!nocheck>") are ignored.
+size_t CPMRelationParse(const char *bytes, size_t length, const char *architecture, CPMRelation *relations, size_t capacity);
+
+// Whether a package at `version` satisfies the relation's version restriction.
+int CPMRelationSatisfiedBy(const CPMRelation *relation, const char *version, size_t length);
+
+#endif /* defined(__cpm__relationship__) */
@@ -0,0 +1,349 @@
+//
+//  snapshot.c
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#include "snapshot.h"
+#include "strpool.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char CPMSnapshotMagic[8] = { 'C', 'P', 'M', 'S', 'N', 'A', 'P', '\0' };
+
+struct CPMSnapshotWriter {
+    uint32_t fieldCount;
+    uint32_t identifierField;
+    uint32_t sectionField;
+
+    CPMStringPool strings;
+
+    // string ids, fieldCount per row
+    uint32_t *ids;
+    uint32_t count;
+    uint32_t capacity;
+};
+
+typedef struct {
+    const char *key;
+    const char *identifier;
+    uint32_t row;
+} CPMSnapshotSortEntry;
+
+static int compareEntries(const void *a, const void *b) {
+    const CPMSnapshotSortEntry *left = a, *right = b;
+    int result = strcmp(left->key, right->key);
+    return result ? result : strcmp(left->identifier, right->identifier);
+}
+
+static uint32_t checksumHeader(const CPMSnapshotHeader *header) {
+    return CPMStringHash((const char *)header, offsetof(CPMSnapshotHeader, checksum));
+}
+
+static size_t align8(size_t value) {
+    return (value + 7) & ~(size_t)7;
+}
+
+CPMSnapshotWriter *CPMSnapshotWriterCreate(uint32_t fieldCount, uint32_t identifierField, uint32_t sectionField) {
+    CPMSnapshotWriter *writer = calloc(1, sizeof(CPMSnapshotWriter));
+    writer->fieldCount = fieldCount;
+    writer->identifierField = identifierField;
+    writer->sectionField = sectionField;
+    CPMStringPoolInit(&writer->strings);
+
+    return writer;
+}
+
+void CPMSnapshotWriterFree(CPMSnapshotWriter *writer) {
+    if (!writer)
+        return;
+
+    CPMStringPoolFree(&writer->strings);
+    free(writer->ids);
+    free(writer);
+}
+
+void CPMSnapshotWriterAddRow(CPMSnapshotWriter *writer, const char *const *values, const size_t *lengths) {
+    if (writer->count == writer->capacity) {
+        writer->capacity = writer->capacity ? writer->capacity * 2 : 1024;
+        writer->ids = realloc(writer->ids, (size_t)writer->capacity * writer->fieldCount * sizeof(uint32_t));
+    }
+
+    uint32_t *row = writer->ids + (size_t)writer->count * writer->fieldCount;
+    for (uint32_t f = 0; f < writer->fieldCount; f++) {
+        size_t length = values[f] ? lengths[f] : 0;
+        row[f] = CPMStringPoolIntern(&writer->strings, values[f], length, CPMStringHash(values[f], length));
+    }
+
+    writer->count++;
+}
+
+int CPMSnapshotWriterWrite(CPMSnapshotWriter *writer, const char *path, uint64_t tag) {
+    CPMStringPool *pool = &writer->strings;
+    uint32_t count = writer->count;
+
+    // records hold byte offsets, not pool ids
+    size_t cells = (size_t)count * writer->fieldCount;
+    uint32_t *records = malloc(cells * sizeof(uint32_t) + 1);
+    for (size_t i = 0; i < cells; i++) {
+        records[i] = pool->offsets[writer->ids[i]];
+    }
+
+    CPMSnapshotSortEntry *entries = malloc(count * sizeof(CPMSnapshotSortEntry) + 1);
+    uint32_t *identifiers = malloc(count * sizeof(uint32_t) + 1);
+    for (uint32_t row = 0; row < count; row++) {
+        const char *identifier = CPMStringPoolString(pool, writer->ids[(size_t)row * writer->fieldCount + writer->identifierField]);
+        entries[row] = (CPMSnapshotSortEntry){ identifier, identifier, row };
+    }
+    qsort(entries, count, sizeof(CPMSnapshotSortEntry), compareEntries);
+    for (uint32_t i = 0; i < count; i++) {
+        identifiers[i] = entries[i].row;
+    }
+
+    // the same rows again, by section then identifier, leaving out those without one
+    uint32_t sectioned = 0;
+    for (uint32_t row = 0; row < count; row++) {
+        uint32_t section = writer->ids[(size_t)row * writer->fieldCount + writer->sectionField];
+        if (!section)
+            continue;
+
+        const char *identifier = CPMStringPoolString(pool, writer->ids[(size_t)row * writer->fieldCount + writer->identifierField]);
+        entries[sectioned++] = (CPMSnapshotSortEntry){ CPMStringPoolString(pool, section), identifier, row };
+    }
+    qsort(entries, sectioned, sizeof(CPMSnapshotSortEntry), compareEntries);
+
+    uint32_t *sectionRows = malloc(sectioned * sizeof(uint32_t) + 1);
+    CPMSnapshotSection *sections = malloc(sectioned * sizeof(CPMSnapshotSection) + 1);
+    uint32_t sectionCount = 0;
+    for (uint32_t i = 0; i < sectioned; i++) {
+        sectionRows[i] = entries[i].row;
+        if (!sectionCount || strcmp(entries[i].key, entries[i - 1].key) != 0) {
+            uint32_t section = writer->ids[(size_t)entries[i].row * writer->fieldCount + writer->sectionField];
+            sections[sectionCount++] = (CPMSnapshotSection){ pool->offsets[section], i, 0 };
+        }
+        sections[sectionCount - 1].count++;
+    }
+    free(entries);
+
+    CPMSnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CPMSnapshotMagic, sizeof(header.magic));
+    header.version = CPMSnapshotVersion;
+    header.fieldCount = writer->fieldCount;
+    header.count = count;
+    header.sectionCount = sectionCount;
+    header.identifierField = writer->identifierField;
+    header.sectionField = writer->sectionField;
+    header.tag = tag;
+
+    header.strings = align8(sizeof(header));
+    header.stringsLength = pool->length;
+    header.records = align8(header.strings + header.stringsLength);
+    header.identifiers = align8(header.records + cells * sizeof(uint32_t));
+    header.sections = align8(header.identifiers + count * sizeof(uint32_t));
+    header.sectionRows = align8(header.sections + sectionCount * sizeof(CPMSnapshotSection));
+    header.length = header.sectionRows + sectioned * sizeof(uint32_t);
+    header.checksum = checksumHeader(&header);
+
+    struct {
+        uint64_t offset;
+        const void *bytes;
+        size_t length;
+    } parts[] = {
+        { 0, &header, sizeof(header) },
+        { header.strings, pool->bytes, pool->length },
+        { header.records, records, cells * sizeof(uint32_t) },
+        { header.identifiers, identifiers, count * sizeof(uint32_t) },
+        { header.sections, sections, sectionCount * sizeof(CPMSnapshotSection) },
+        { header.sectionRows, sectionRows, sectioned * sizeof(uint32_t) },
+    };
+
+    size_t pathLength = strlen(path);
+    char *partialPath = malloc(pathLength + sizeof(".partial"));
+    memcpy(partialPath, path, pathLength);
+    memcpy(partialPath + pathLength, ".partial", sizeof(".partial"));
+
+    int result = -1;
+    FILE *file = fopen(partialPath, "wb");
+    if (file) {
+        static const char padding[8] = { 0 };
+        uint64_t written = 0;
+        result = 0;
+
+        for (size_t i = 0; i < sizeof(parts) / sizeof(*parts) && result == 0; i++) {
+            if (parts[i].offset > written && fwrite(padding, 1, parts[i].offset - written, file) != parts[i].offset - written)
+                result = -1;
+            else if (parts[i].length && fwrite(parts[i].bytes, 1, parts[i].length, file) != parts[i].length)
+                result = -1;
+            written = parts[i].offset + parts[i].length;
+        }
+
+        if (fclose(file) != 0)
+            result = -1;
+        if (result == 0)
+            result = rename(partialPath, path);
+        if (result != 0) {
+            int error = errno;
+            unlink(partialPath);
+            errno = error;
+        }
+    }
+
+    free(partialPath);
+    free(records);
+    free(identifiers);
+    free(sections);
+    free(sectionRows);
+
+    return result;
+}
+
+int CPMSnapshotOpen(CPMSnapshot *snapshot, const char *path, uint32_t fieldCount, uint64_t tag) {
+    memset(snapshot, 0, sizeof(*snapshot));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    if ((size_t)info.st_size < sizeof(CPMSnapshotHeader)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    void *base = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return -1;
+
+    snapshot->base = base;
+    snapshot->length = (size_t)info.st_size;
+    const CPMSnapshotHeader *header = base;
+
+    // every part has to lie inside the file, in order, and the strings have to end in a NUL
+    uint64_t cells = (uint64_t)header->count * header->fieldCount;
+    int valid = memcmp(header->magic, CPMSnapshotMagic, sizeof(header->magic)) == 0 &&
+        header->checksum == checksumHeader(header) &&
+        header->version == CPMSnapshotVersion &&
+        header->fieldCount == fieldCount &&
+        header->identifierField < fieldCount &&
+        header->tag == tag &&
+        header->length == snapshot->length &&
+        header->stringsLength > 0 &&
+        header->strings >= sizeof(CPMSnapshotHeader) &&
+        header->records >= header->strings + header->stringsLength &&
+        header->identifiers >= header->records + cells * sizeof(uint32_t) &&
+        header->sections >= header->identifiers + (uint64_t)header->count * sizeof(uint32_t) &&
+        header->sectionRows >= header->sections + (uint64_t)header->sectionCount * sizeof(CPMSnapshotSection) &&
+        header->sectionRows <= header->length &&
+        (header->records | header->identifiers | header->sections | header->sectionRows) % sizeof(uint32_t) == 0;
+
+    if (valid)
+        valid = snapshot->base[header->strings + header->stringsLength - 1] == '\0';
+
+    if (!valid) {
+        CPMSnapshotClose(snapshot);
+        errno = EINVAL;
+        return -1;
+    }
+
+    snapshot->header = header;
+    snapshot->strings = snapshot->base + header->strings;
+    snapshot->records = (const uint32_t *)(snapshot->base + header->records);
+    snapshot->identifiers = (const uint32_t *)(snapshot->base + header->identifiers);
+    snapshot->sections = (const CPMSnapshotSection *)(snapshot->base + header->sections);
+    snapshot->sectionRows = (const uint32_t *)(snapshot->base + header->sectionRows);
+
+    return 0;
+}
+
+void CPMSnapshotClose(CPMSnapshot *snapshot) {
+    if (snapshot->base)
+        munmap((void *)snapshot->base, snapshot->length);
+    memset(snapshot, 0, sizeof(*snapshot));
+}
+
+// strcmp against a key that isn't NUL terminated
+static int compareKey(const char *string, const char *key, size_t length) {
+    int result = strncmp(string, key, length);
+    if (result)
+        return result;
+
+    return string[length] ? 1 : 0;
+}
+
+uint32_t CPMSnapshotFind(const CPMSnapshot *snapshot, const char *identifier, size_t length) {
+    const CPMSnapshotHeader *header = snapshot->header;
+    if (!header)
+        return UINT32_MAX;
+
+    uint32_t low = 0, high = header->count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        uint32_t row = snapshot->identifiers[middle];
+        if (row >= header->count)
+            return UINT32_MAX;
+
+        int result = compareKey(CPMSnapshotValue(snapshot, row, header->identifierField), identifier, length);
+        if (result == 0)
+            return row;
+        if (result < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return UINT32_MAX;
+}
+
+uint32_t CPMSnapshotFindSection(const CPMSnapshot *snapshot, const char *name, size_t length) {
+    const CPMSnapshotHeader *header = snapshot->header;
+    if (!header)
+        return UINT32_MAX;
+
+    uint32_t low = 0, high = header->sectionCount;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        int result = compareKey(CPMSnapshotString(snapshot, snapshot->sections[middle].name), name, length);
+        if (result == 0)
+            return middle;
+        if (result < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return UINT32_MAX;
+}
+
+const uint32_t *CPMSnapshotSectionRows(const CPMSnapshot *snapshot, uint32_t section, uint32_t *count) {
+    const CPMSnapshotHeader *header = snapshot->header;
+    if (!header || section >= header->sectionCount) {
+        *count = 0;
+        return NULL;
+    }
+
+    const CPMSnapshotSection *entry = &snapshot->sections[section];
+    uint64_t rows = (header->length - header->sectionRows) / sizeof(uint32_t);
+    if ((uint64_t)entry->first + entry->count > rows) {
+        *count = 0;
+        return NULL;
+    }
+
+    *count = entry->count;
+    return snapshot->sectionRows + entry->first;
+}
@@ -0,0 +1,115 @@
+//
+//  snapshot.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#ifndef __cpm__snapshot__
+#define __cpm__snapshot__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Read-only image of a packages table, laid out so it can be mapped and used
+// in place:
+//
+//   header      CPMSnapshotHeader, with a checksum over itself
+//   strings     every distinct value once, NUL terminated
+//   records     count * fieldCount string offsets, one fixed-width row per package
+//   identifiers row numbers sorted by the identifier field
+//   sections    CPMSnapshotSection entries sorted by name
+//   sectionRows row numbers grouped by section, sorted by identifier within one
+//
+// The file is native endian, and only ever read on the machine that wrote it.
+// Opening a snapshot costs a handful of bounds checks, not a pass over the
+// file; every offset is range checked again when it is read, so a damaged file
+// yields empty strings rather than a crash.
+
+#define CPMSnapshotVersion 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t fieldCount;
+    uint32_t count;
+    uint32_t sectionCount;
+    uint32_t identifierField;
+    uint32_t sectionField;
+
+    // what the writer said the rows are, so a stale snapshot can be told apart
+    uint64_t tag;
+
+    uint64_t length;
+    uint64_t strings;
+    uint64_t stringsLength;
+    uint64_t records;
+    uint64_t identifiers;
+    uint64_t sections;
+    uint64_t sectionRows;
+
+    // FNV-1a over everything above
+    uint32_t checksum;
+    uint32_t reserved;
+} CPMSnapshotHeader;
+
+typedef struct {
+    uint32_t name;
+    uint32_t first;
+    uint32_t count;
+} CPMSnapshotSection;
+
+typedef struct CPMSnapshotWriter CPMSnapshotWriter;
+
+// Rows are keyed by the value of identifierField and grouped by the value of
+// sectionField. Rows without a section are left out of the section index.
+CPMSnapshotWriter *CPMSnapshotWriterCreate(uint32_t fieldCount, uint32_t identifierField, uint32_t sectionField);
+void CPMSnapshotWriterFree(CPMSnapshotWriter *writer);
+
+// `values` and `lengths` hold fieldCount entries; a NULL value is empty.
+void CPMSnapshotWriterAddRow(CPMSnapshotWriter *writer, const char *const *values, const size_t *lengths);
+
+// Writes next to `path` and renames into place, so a reader never sees half a
+// snapshot. Returns 0, or -1 with errno set.
+int CPMSnapshotWriterWrite(CPMSnapshotWriter *writer, const char *path, uint64_t tag);
+
+typedef struct {
+    const char *base;
+    size_t length;
+
+    const CPMSnapshotHeader *header;
+    const char *strings;
+    const uint32_t *records;
+    const uint32_t *identifiers;
+    const CPMSnapshotSection *sections;
+    const uint32_t *sectionRows;
+} CPMSnapshot;
+
+// Maps a snapshot. Returns 0, or -1 with errno set; EINVAL means the file is
+// damaged, of another version or field count, or was written with another tag.
+int CPMSnapshotOpen(CPMSnapshot *snapshot, const char *path, uint32_t fieldCount, uint64_t tag);
+void CPMSnapshotClose(CPMSnapshot *snapshot);
+
+static inline uint32_t CPMSnapshotCount(const CPMSnapshot *snapshot) {
+    return snapshot->header ? snapshot->header->count : 0;
+}
+
+static inline const char *CPMSnapshotString(const CPMSnapshot *snapshot, uint32_t offset) {
+    return offset < snapshot->header->stringsLength ? snapshot->strings + offset : "";
+}
+
+static inline const char *CPMSnapshotValue(const CPMSnapshot *snapshot, uint32_t row, uint32_t field) {
+    return CPMSnapshotString(snapshot, snapshot->records[(size_t)row * snapshot->header->fieldCount + field]);
+}
+
+// Row of the package with that identifier, or UINT32_MAX.
+uint32_t CPMSnapshotFind(const CPMSnapshot *snapshot, const char *identifier, size_t length);
+
+// Index of the section with that name, or UINT32_MAX.
+uint32_t CPMSnapshotFindSection(const CPMSnapshot *snapshot, const char *name, size_t length);
+
+// Rows of one section, sorted by identifier.
+const uint32_t *CPMSnapshotSectionRows(const CPMSnapshot *snapshot, uint32_t section, uint32_t *count);
+
+#endif /* defined(__cpm__snapshot__) */
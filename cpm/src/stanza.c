@@ -0,0 +1,169 @@
+//
+//  stanza.c
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#include "stanza.h"
+#include <string.h>
+
+#define CPMStanzaHashSize 64
+
+static const char *const CPMStanzaColumns[CPMStanzaFieldCount] = {
+    [CPMStanzaFieldPackage] = "package",
+    [CPMStanzaFieldSize] = "size",
+    [CPMStanzaFieldVersion] = "version",
+    [CPMStanzaFieldFilename] = "filename",
+    [CPMStanzaFieldArchitecture] = "architecture",
+    [CPMStanzaFieldMaintainer] = "maintainer",
+    [CPMStanzaFieldInstalledSize] = "installed_size",
+    [CPMStanzaFieldDepends] = "depends",
+    [CPMStanzaFieldMD5Sum] = "md5sum",
+    [CPMStanzaFieldSHA1] = "sha1",
+    [CPMStanzaFieldSHA256] = "sha256",
+    [CPMStanzaFieldSection] = "section",
+    [CPMStanzaFieldPriority] = "priority",
+    [CPMStanzaFieldHomepage] = "homepage",
+    [CPMStanzaFieldDescription] = "description",
+    [CPMStanzaFieldAuthor] = "author",
+    [CPMStanzaFieldDepiction] = "depiction",
+    [CPMStanzaFieldSponsor] = "sponsor",
+    [CPMStanzaFieldIcon] = "icon",
+    [CPMStanzaFieldName] = "name",
+    [CPMStanzaFieldPreDepends] = "pre_depends",
+    [CPMStanzaFieldRecommends] = "recommends",
+    [CPMStanzaFieldSuggests] = "suggests",
+    [CPMStanzaFieldEnhances] = "enhances",
+    [CPMStanzaFieldBreaks] = "breaks",
+    [CPMStanzaFieldConflicts] = "conflicts",
+    [CPMStanzaFieldProvides] = "provides",
+    [CPMStanzaFieldReplaces] = "replaces",
+    [CPMStanzaFieldArchitectures] = "architectures",
+    [CPMStanzaFieldCodename] = "codename",
+    [CPMStanzaFieldComponents] = "components",
+    [CPMStanzaFieldLabel] = "label",
+    [CPMStanzaFieldSuite] = "suite",
+    [CPMStanzaFieldOrigin] = "origin",
+    [CPMStanzaFieldStatus] = "status",
+};
+
+// Perfect hash over the column names above: the first, middle and last
+// characters plus the length never collide for any two known fields, and none
+// of those positions is a '-' or '_' in a known name. Adding a field means
+// picking new multipliers so that still holds.
+static const int8_t CPMStanzaHashTable[CPMStanzaHashSize] = {
+    CPMStanzaFieldUnknown, CPMStanzaFieldMD5Sum, CPMStanzaFieldEnhances, CPMStanzaFieldHomepage,
+    CPMStanzaFieldComponents, CPMStanzaFieldUnknown, CPMStanzaFieldName, CPMStanzaFieldUnknown,
+    CPMStanzaFieldUnknown, CPMStanzaFieldUnknown, CPMStanzaFieldCodename, CPMStanzaFieldUnknown,
+    CPMStanzaFieldUnknown, CPMStanzaFieldSHA1, CPMStanzaFieldPackage, CPMStanzaFieldUnknown,
+    CPMStanzaFieldUnknown, CPMStanzaFieldAuthor, CPMStanzaFieldPreDepends, CPMStanzaFieldFilename,
+    CPMStanzaFieldUnknown, CPMStanzaFieldSHA256, CPMStanzaFieldLabel, CPMStanzaFieldArchitecture,
+    CPMStanzaFieldReplaces, CPMStanzaFieldUnknown, CPMStanzaFieldUnknown, CPMStanzaFieldUnknown,
+    CPMStanzaFieldRecommends, CPMStanzaFieldUnknown, CPMStanzaFieldDepends, CPMStanzaFieldVersion,
+    CPMStanzaFieldBreaks, CPMStanzaFieldDepiction, CPMStanzaFieldStatus, CPMStanzaFieldUnknown,
+    CPMStanzaFieldUnknown, CPMStanzaFieldSuite, CPMStanzaFieldSize, CPMStanzaFieldDescription,
+    CPMStanzaFieldUnknown, CPMStanzaFieldSponsor, CPMStanzaFieldOrigin, CPMStanzaFieldSection,
+    CPMStanzaFieldUnknown, CPMStanzaFieldArchitectures, CPMStanzaFieldUnknown, CPMStanzaFieldSuggests,
+    CPMStanzaFieldUnknown, CPMStanzaFieldPriority, CPMStanzaFieldMaintainer, CPMStanzaFieldUnknown,
+    CPMStanzaFieldUnknown, CPMStanzaFieldUnknown, CPMStanzaFieldConflicts, CPMStanzaFieldInstalledSize,
+    CPMStanzaFieldIcon, CPMStanzaFieldUnknown, CPMStanzaFieldProvides, CPMStanzaFieldUnknown,
+    CPMStanzaFieldUnknown, CPMStanzaFieldUnknown, CPMStanzaFieldUnknown, CPMStanzaFieldUnknown,
+};
+
+static inline unsigned char CPMStanzaLower(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? c | 0x20 : c;
+}
+
+static inline unsigned int CPMStanzaHash(const char *name, size_t length) {
+    return (CPMStanzaLower(name[0]) * 3 +
+            CPMStanzaLower(name[length - 1]) * 31 +
+            (unsigned int)length * 36 +
+            CPMStanzaLower(name[length / 2]) * 21) & (CPMStanzaHashSize - 1);
+}
+
+static inline int CPMStanzaIsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+CPMStanzaField CPMStanzaFieldForName(const char *name, size_t length) {
+    if (length == 0)
+        return CPMStanzaFieldUnknown;
+
+    CPMStanzaField field = CPMStanzaHashTable[CPMStanzaHash(name, length)];
+    if (field == CPMStanzaFieldUnknown)
+        return CPMStanzaFieldUnknown;
+
+    const char *column = CPMStanzaColumns[field];
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = CPMStanzaLower(name[i]);
+        if (c == '-')
+            c = '_';
+        if (c != (unsigned char)column[i])
+            return CPMStanzaFieldUnknown;
+    }
+
+    return column[length] == '\0' ? field : CPMStanzaFieldUnknown;
+}
+
+const char *CPMStanzaFieldColumn(CPMStanzaField field) {
+    if (field < 0 || field >= CPMStanzaFieldCount)
+        return NULL;
+    return CPMStanzaColumns[field];
+}
+
+size_t CPMStanzaParse(const char *bytes, size_t length, CPMStanza *stanza) {
+    memset(stanza, 0, sizeof(*stanza));
+
+    const char *p = bytes;
+    const char *end = bytes + length;
+    CPMStanzaValue *current = NULL;
+    size_t found = 0;
+
+    while (p < end) {
+        const char *eol = memchr(p, '\n', end - p);
+        if (!eol)
+            eol = end;
+
+        if (*p == ' ' || *p == '\t') {
+            // continuation of the previous field
+            if (current)
+                current->length = eol - current->bytes;
+        } else {
+            current = NULL;
+
+            const char *colon = eol > p ? memchr(p, ':', eol - p) : NULL;
+            if (colon) {
+                CPMStanzaField field = CPMStanzaFieldForName(p, colon - p);
+                if (field != CPMStanzaFieldUnknown) {
+                    current = &stanza->values[field];
+                    if (!current->bytes)
+                        found++;
+
+                    current->bytes = colon + 1;
+                    current->length = eol - current->bytes;
+                }
+            }
+        }
+
+        p = eol + 1;
+    }
+
+    for (int i = 0; i < CPMStanzaFieldCount; i++) {
+        CPMStanzaValue *value = &stanza->values[i];
+        if (!value->bytes)
+            continue;
+
+        while (value->length && CPMStanzaIsSpace(value->bytes[0])) {
+            value->bytes++;
+            value->length--;
+        }
+
+        while (value->length && CPMStanzaIsSpace(value->bytes[value->length - 1])) {
+            value->length--;
+        }
+    }
+
+    return found;
+}
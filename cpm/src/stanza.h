@@ -0,0 +1,90 @@
+//
+//  stanza.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#ifndef __cpm__stanza__
+#define __cpm__stanza__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Byte-level parser for Debian control-file paragraphs (Packages, Release and
+// dpkg status entries). Nothing is copied: every value is a view into the
+// buffer that was parsed and is only valid for as long as that buffer is.
+// https://www.debian.org/doc/debian-policy/ch-controlfields.html
+
+typedef enum {
+    CPMStanzaFieldUnknown = -1,
+
+    // columns of the packages table, in schema order
+    CPMStanzaFieldPackage,
+    CPMStanzaFieldSize,
+    CPMStanzaFieldVersion,
+    CPMStanzaFieldFilename,
+    CPMStanzaFieldArchitecture,
+    CPMStanzaFieldMaintainer,
+    CPMStanzaFieldInstalledSize,
+    CPMStanzaFieldDepends,
+    CPMStanzaFieldMD5Sum,
+    CPMStanzaFieldSHA1,
+    CPMStanzaFieldSHA256,
+    CPMStanzaFieldSection,
+    CPMStanzaFieldPriority,
+    CPMStanzaFieldHomepage,
+    CPMStanzaFieldDescription,
+    CPMStanzaFieldAuthor,
+    CPMStanzaFieldDepiction,
+    CPMStanzaFieldSponsor,
+    CPMStanzaFieldIcon,
+    CPMStanzaFieldName,
+
+    // relationships, also columns of the packages table
+    CPMStanzaFieldPreDepends,
+    CPMStanzaFieldRecommends,
+    CPMStanzaFieldSuggests,
+    CPMStanzaFieldEnhances,
+    CPMStanzaFieldBreaks,
+    CPMStanzaFieldConflicts,
+    CPMStanzaFieldProvides,
+    CPMStanzaFieldReplaces,
+
+    // Release only
+    CPMStanzaFieldArchitectures,
+    CPMStanzaFieldCodename,
+    CPMStanzaFieldComponents,
+    CPMStanzaFieldLabel,
+    CPMStanzaFieldSuite,
+    CPMStanzaFieldOrigin,
+
+    // dpkg status database only
+    CPMStanzaFieldStatus,
+
+    CPMStanzaFieldCount
+} CPMStanzaField;
+
+typedef struct {
+    const char *bytes;
+    size_t length;
+} CPMStanzaValue;
+
+typedef struct {
+    CPMStanzaValue values[CPMStanzaFieldCount];
+} CPMStanza;
+
+// Maps a field name as it appears in a control file ("Installed-Size") to its
+// slot. Matching is case insensitive and treats '-' and '_' as equal.
+CPMStanzaField CPMStanzaFieldForName(const char *name, size_t length);
+
+// Database column name for a field ("installed_size").
+const char *CPMStanzaFieldColumn(CPMStanzaField field);
+
+// Parses one paragraph into `stanza`, returning how many known fields were set.
+// Continuation lines are kept as part of the value, exactly as they appear in
+// the paragraph; leading and trailing whitespace is trimmed.
+size_t CPMStanzaParse(const char *bytes, size_t length, CPMStanza *stanza);
+
+#endif /* defined(__cpm__stanza__) */
@@ -0,0 +1,108 @@
+//
+//  strpool.c
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#include "strpool.h"
+#include <stdlib.h>
+#include <string.h>
+
+void CPMStringPoolInit(CPMStringPool *pool) {
+    pool->capacity = 64 * 1024;
+    pool->bytes = malloc(pool->capacity);
+    pool->bytes[0] = '\0';
+    pool->length = 1;
+
+    pool->offsetsCapacity = 1024;
+    pool->offsets = malloc(pool->offsetsCapacity * sizeof(uint32_t));
+    pool->offsets[0] = 0;
+    pool->count = 1;
+
+    pool->size = 4096;
+    pool->slots = calloc(pool->size, sizeof(uint32_t));
+}
+
+void CPMStringPoolFree(CPMStringPool *pool) {
+    free(pool->bytes);
+    free(pool->offsets);
+    free(pool->slots);
+    memset(pool, 0, sizeof(*pool));
+}
+
+void CPMStringPoolSeal(CPMStringPool *pool) {
+    free(pool->slots);
+    pool->slots = NULL;
+    pool->size = 0;
+}
+
+static size_t findSlot(const CPMStringPool *pool, const char *bytes, size_t length, uint32_t hash) {
+    size_t mask = pool->size - 1;
+    size_t slot = hash & mask;
+    while (pool->slots[slot]) {
+        const char *existing = CPMStringPoolString(pool, pool->slots[slot] - 1);
+        if (!memcmp(existing, bytes, length) && existing[length] == '\0')
+            break;
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+uint32_t CPMStringPoolFind(const CPMStringPool *pool, const char *bytes, size_t length, uint32_t hash) {
+    if (!length)
+        return 0;
+    if (!pool->slots)
+        return UINT32_MAX;
+
+    size_t slot = findSlot(pool, bytes, length, hash);
+    return pool->slots[slot] ? pool->slots[slot] - 1 : UINT32_MAX;
+}
+
+uint32_t CPMStringPoolIntern(CPMStringPool *pool, const char *bytes, size_t length, uint32_t hash) {
+    if (!length)
+        return 0;
+
+    size_t slot = findSlot(pool, bytes, length, hash);
+    if (pool->slots[slot])
+        return pool->slots[slot] - 1;
+
+    if (pool->length + length + 1 > pool->capacity) {
+        while (pool->length + length + 1 > pool->capacity)
+            pool->capacity *= 2;
+        pool->bytes = realloc(pool->bytes, pool->capacity);
+    }
+
+    if (pool->count == pool->offsetsCapacity) {
+        pool->offsetsCapacity *= 2;
+        pool->offsets = realloc(pool->offsets, pool->offsetsCapacity * sizeof(uint32_t));
+    }
+
+    uint32_t id = pool->count++;
+    pool->offsets[id] = (uint32_t)pool->length;
+    memcpy(pool->bytes + pool->length, bytes, length);
+    pool->bytes[pool->length + length] = '\0';
+    pool->length += length + 1;
+    pool->slots[slot] = id + 1;
+
+    // keep the table at most half full
+    if (pool->count * 2 > pool->size) {
+        size_t size = pool->size * 2;
+        uint32_t *slots = calloc(size, sizeof(uint32_t));
+        for (uint32_t existing = 1; existing < pool->count; existing++) {
+            const char *string = CPMStringPoolString(pool, existing);
+            size_t s = CPMStringHash(string, strlen(string)) & (size - 1);
+            while (slots[s])
+                s = (s + 1) & (size - 1);
+            slots[s] = existing + 1;
+        }
+
+        free(pool->slots);
+        pool->slots = slots;
+        pool->size = size;
+    }
+
+    return id;
+}
@@ -0,0 +1,62 @@
+//
+//  strpool.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#ifndef __cpm__strpool__
+#define __cpm__strpool__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Interns strings into one growing buffer and hands out small dense ids for
+// them, so equal strings are stored once and compare by id. Id 0 is always
+// the empty string.
+
+typedef struct {
+    char *bytes;
+    size_t length;
+    size_t capacity;
+
+    // id -> offset into bytes
+    uint32_t *offsets;
+    uint32_t count;
+    uint32_t offsetsCapacity;
+
+    // open-addressing table of id + 1; NULL once CPMStringPoolSeal is called
+    uint32_t *slots;
+    size_t size;
+} CPMStringPool;
+
+void CPMStringPoolInit(CPMStringPool *pool);
+void CPMStringPoolFree(CPMStringPool *pool);
+
+// Returns the id of the string, adding it first if needed.
+uint32_t CPMStringPoolIntern(CPMStringPool *pool, const char *bytes, size_t length, uint32_t hash);
+
+// Returns the id of the string, or UINT32_MAX if it was never interned.
+uint32_t CPMStringPoolFind(const CPMStringPool *pool, const char *bytes, size_t length, uint32_t hash);
+
+// Drops the lookup table once nothing else will be interned. The strings
+// and ids stay valid.
+void CPMStringPoolSeal(CPMStringPool *pool);
+
+static inline const char *CPMStringPoolString(const CPMStringPool *pool, uint32_t id) {
+    return pool->bytes + pool->offsets[id];
+}
+
+// FNV-1a
+static inline uint32_t CPMStringHash(const char *bytes, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)bytes[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+#endif /* defined(__cpm__strpool__) */
@@ -0,0 +1,131 @@
+//
+//  version.c
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#include "version.h"
+#include <string.h>
+
+typedef struct {
+    unsigned long epoch;
+    const char *upstream;
+    const char *upstreamEnd;
+    const char *revision;
+    const char *revisionEnd;
+} CPMVersionParts;
+
+static inline int isDigit(int c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline int isAlpha(int c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static void splitVersion(const char *bytes, size_t length, CPMVersionParts *parts) {
+    const char *end = bytes + length;
+
+    // surrounding whitespace is not part of the version
+    while (bytes < end && (*bytes == ' ' || *bytes == '\t'))
+        bytes++;
+    while (end > bytes && (end[-1] == ' ' || end[-1] == '\t'))
+        end--;
+
+    parts->epoch = 0;
+    const char *colon = memchr(bytes, ':', end - bytes);
+    if (colon) {
+        for (const char *p = bytes; p < colon; p++) {
+            if (isDigit(*p))
+                parts->epoch = parts->epoch * 10 + (*p - '0');
+        }
+        bytes = colon + 1;
+    }
+
+    // the revision starts after the last hyphen, if any
+    const char *hyphen = NULL;
+    for (const char *p = end; p > bytes; p--) {
+        if (p[-1] == '-') {
+            hyphen = p - 1;
+            break;
+        }
+    }
+
+    parts->upstream = bytes;
+    parts->upstreamEnd = hyphen ? hyphen : end;
+    parts->revision = hyphen ? hyphen + 1 : end;
+    parts->revisionEnd = end;
+}
+
+// letters sort before everything else, and ~ sorts before even the end of the part
+static inline int order(int c) {
+    if (isDigit(c))
+        return 0;
+    if (isAlpha(c))
+        return c;
+    if (c == '~')
+        return -1;
+    if (c)
+        return c + 256;
+    return 0;
+}
+
+// dpkg's verrevcmp() over [a, aend) and [b, bend)
+static int compareParts(const char *a, const char *aend, const char *b, const char *bend) {
+#define AT(p, e) ((p) < (e) ? (unsigned char)*(p) : 0)
+    while (a < aend || b < bend) {
+        int firstDiff = 0;
+
+        while ((a < aend && !isDigit(*a)) || (b < bend && !isDigit(*b))) {
+            int ac = order(AT(a, aend));
+            int bc = order(AT(b, bend));
+            if (ac != bc)
+                return ac - bc;
+            a++;
+            b++;
+        }
+
+        while (a < aend && *a == '0')
+            a++;
+        while (b < bend && *b == '0')
+            b++;
+
+        while (a < aend && b < bend && isDigit(*a) && isDigit(*b)) {
+            if (!firstDiff)
+                firstDiff = *a - *b;
+            a++;
+            b++;
+        }
+
+        if (a < aend && isDigit(*a))
+            return 1;
+        if (b < bend && isDigit(*b))
+            return -1;
+        if (firstDiff)
+            return firstDiff;
+    }
+#undef AT
+
+    return 0;
+}
+
+int CPMVersionCompare(const char *a, size_t alength, const char *b, size_t blength) {
+    CPMVersionParts va, vb;
+    splitVersion(a, alength, &va);
+    splitVersion(b, blength, &vb);
+
+    if (va.epoch != vb.epoch)
+        return va.epoch > vb.epoch ? 1 : -1;
+
+    int result = compareParts(va.upstream, va.upstreamEnd, vb.upstream, vb.upstreamEnd);
+    if (result)
+        return result;
+
+    return compareParts(va.revision, va.revisionEnd, vb.revision, vb.revisionEnd);
+}
+
+int CPMVersionCompareStrings(const char *a, const char *b) {
+    return CPMVersionCompare(a, strlen(a), b, strlen(b));
+}
@@ -0,0 +1,25 @@
+//
+//  version.h
+//  cpm
+//
+//  Created by Chariz Team on 10/18/26.
+//  Copyright (c) 2026 Chariz Team. All rights reserved.
+//
+
+#ifndef __cpm__version__
+#define __cpm__version__
+
+#include <stddef.h>
+
+// Debian version ordering, exactly as dpkg --compare-versions does it:
+// [epoch:]upstream_version[-debian_revision]
+// https://www.debian.org/doc/debian-policy/ch-controlfields.html#s-f-Version
+
+// Returns a negative number, zero or a positive number when a sorts before,
+// the same as or after b. Neither string has to be NUL-terminated.
+int CPMVersionCompare(const char *a, size_t alength, const char *b, size_t blength);
+
+// Same for NUL-terminated strings.
+int CPMVersionCompareStrings(const char *a, const char *b);
+
+#endif /* defined(__cpm__version__) */